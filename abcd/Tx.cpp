@@ -50,6 +50,7 @@
 #include <wallet/wallet.hpp>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 namespace abcd {
 
@@ -153,12 +154,14 @@ static tABC_CC  ABC_TxSetAddressRecycle(tABC_WalletID self, const char *szAddres
 static tABC_CC  ABC_TxCheckForInternalEquivalent(const char *szFilename, bool *pbEquivalent, tABC_Error *pError);
 static tABC_CC  ABC_TxGetTxTypeAndBasename(const char *szFilename, tTxType *pType, char **pszBasename, tABC_Error *pError);
 static tABC_CC  ABC_TxLoadTransactionInfo(tABC_WalletID self, const char *szFilename, tABC_TxInfo **ppTransaction, tABC_Error *pError);
-static tABC_CC  ABC_TxLoadTxAndAppendToArray(tABC_WalletID self, int64_t startTime, int64_t endTime, const char *szFilename, tABC_TxInfo ***paTransactions, unsigned int *pCount, tABC_Error *pError);
+static tABC_CC  ABC_TxMakeTransactionInfo(tABC_Tx *pTx, tABC_TxInfo **ppTransaction, tABC_Error *pError);
+static tABC_CC  ABC_TxDecodeTxAndAppendToArray(tABC_WalletID self, int64_t startTime, int64_t endTime, json_t *pJSON_Root, tABC_TxInfo ***paTransactions, unsigned int *pCount, tABC_Error *pError);
 static tABC_CC  ABC_TxGetAddressOwed(tABC_TxAddress *pAddr, int64_t *pSatoshiBalance, tABC_Error *pError);
 static tABC_CC  ABC_TxBuildFromLabel(tABC_WalletID self, char **pszLabel, tABC_Error *pError);
 static void     ABC_TxFreeRequest(tABC_RequestInfo *pRequest);
 static tABC_CC  ABC_TxCreateTxFilename(tABC_WalletID self, char **pszFilename, const char *szTxID, bool bInternal, tABC_Error *pError);
 static tABC_CC  ABC_TxLoadTransaction(tABC_WalletID self, const char *szFilename, tABC_Tx **ppTx, tABC_Error *pError);
+static tABC_CC  ABC_TxDecodeTransaction(tABC_WalletID self, json_t *pJSON_Root, tABC_Tx **ppTx, tABC_Error *pError);
 static tABC_CC  ABC_TxDecodeTxState(json_t *pJSON_Obj, tTxStateInfo **ppInfo, tABC_Error *pError);
 static tABC_CC  ABC_TxDecodeTxDetails(json_t *pJSON_Obj, tABC_TxDetails **ppDetails, tABC_Error *pError);
 static void     ABC_TxFreeTx(tABC_Tx *pTx);
@@ -169,6 +172,7 @@ static tABC_CC  ABC_TxEncodeTxDetails(json_t *pJSON_Obj, tABC_TxDetails *pDetail
 static int      ABC_TxInfoPtrCompare (const void * a, const void * b);
 static tABC_CC  ABC_TxLoadAddress(tABC_WalletID self, const char *szAddressID, tABC_TxAddress **ppAddress, tABC_Error *pError);
 static tABC_CC  ABC_TxLoadAddressFile(tABC_WalletID self, const char *szFilename, tABC_TxAddress **ppAddress, tABC_Error *pError);
+static tABC_CC  ABC_TxDecodeAddress(json_t *pJSON_Root, tABC_TxAddress **ppAddress, tABC_Error *pError);
 static tABC_CC  ABC_TxDecodeAddressStateInfo(json_t *pJSON_Obj, tTxAddressStateInfo **ppState, tABC_Error *pError);
 static tABC_CC  ABC_TxSaveAddress(tABC_WalletID self, const tABC_TxAddress *pAddress, tABC_Error *pError);
 static tABC_CC  ABC_TxEncodeAddressStateInfo(json_t *pJSON_Obj, tTxAddressStateInfo *pInfo, tABC_Error *pError);
@@ -179,7 +183,7 @@ static void     ABC_TxFreeAddressStateInfo(tTxAddressStateInfo *pInfo);
 static void     ABC_TxFreeAddresses(tABC_TxAddress **aAddresses, unsigned int count);
 static tABC_CC  ABC_TxGetAddresses(tABC_WalletID self, tABC_TxAddress ***paAddresses, unsigned int *pCount, tABC_Error *pError);
 static int      ABC_TxAddrPtrCompare(const void * a, const void * b);
-static tABC_CC  ABC_TxLoadAddressAndAppendToArray(tABC_WalletID self, const char *szFilename, tABC_TxAddress ***paAddresses, unsigned int *pCount, tABC_Error *pError);
+static tABC_CC  ABC_TxDecodeAddressAndAppendToArray(json_t *pJSON_Root, tABC_TxAddress ***paAddresses, unsigned int *pCount, tABC_Error *pError);
 //static void     ABC_TxPrintAddresses(tABC_TxAddress **aAddresses, unsigned int count);
 static tABC_CC  ABC_TxAddressAddTx(tABC_TxAddress *pAddress, tABC_Tx *pTx, tABC_Error *pError);
 static tABC_CC  ABC_TxTransactionExists(tABC_WalletID self, const char *szID, tABC_Tx **pTx, tABC_Error *pError);
@@ -1627,6 +1631,10 @@ tABC_CC ABC_TxGetTransactions(tABC_WalletID self,
     tABC_TxInfo **aTransactions = NULL;
     unsigned int count = 0;
     bool bExists = false;
+    tABC_U08Buf MK = ABC_BUF_NULL; // Do not free
+    std::vector<std::string> filenames;
+    std::vector<const char *> aszFilenames;
+    std::vector<json_t *> aJSON;
 
     *paTransactions = NULL;
     *pCount = 0;
@@ -1670,21 +1678,35 @@ tABC_CC ABC_TxGetTransactions(tABC_WalletID self,
                     // if this doesn't not have an internal equivalent (or is an internal itself)
                     if (bHasInternalEquivalent == false)
                     {
-                        // add this transaction to the array
-
-                        ABC_CHECK_RET(ABC_TxLoadTxAndAppendToArray(self,
-                                                                   startTime,
-                                                                   endTime,
-                                                                   szFilename,
-                                                                   &aTransactions,
-                                                                   &count,
-                                                                   pError));
+                        filenames.push_back(szFilename);
                     }
                 }
             }
         }
     }
 
+    // decrypt the transactions all at once, then add them to the array
+    if (!filenames.empty())
+    {
+        ABC_CHECK_RET(ABC_WalletGetMK(self, &MK, pError));
+        for (const auto &filename: filenames)
+            aszFilenames.push_back(filename.c_str());
+        aJSON.resize(filenames.size());
+        ABC_CHECK_RET(ABC_CryptoDecryptJSONFiles(aszFilenames.data(),
+            aszFilenames.size(), MK, aJSON.data(), 0, pError));
+
+        for (auto pJSON_Root: aJSON)
+        {
+            ABC_CHECK_RET(ABC_TxDecodeTxAndAppendToArray(self,
+                                                         startTime,
+                                                         endTime,
+                                                         pJSON_Root,
+                                                         &aTransactions,
+                                                         &count,
+                                                         pError));
+        }
+    }
+
     // if we have more than one, then let's sort them
     if (count > 1)
     {
@@ -1703,6 +1725,8 @@ exit:
     ABC_FREE_STR(szFilename);
     ABC_FileIOFreeFileList(pFileList);
     ABC_TxFreeTransactions(aTransactions, count);
+    for (auto pJSON_Root: aJSON)
+        if (pJSON_Root) json_decref(pJSON_Root);
 
     return cc;
 }
@@ -1959,6 +1983,37 @@ tABC_CC ABC_TxLoadTransactionInfo(tABC_WalletID self,
 
     // load the transaction
     ABC_CHECK_RET(ABC_TxLoadTransaction(self, szFilename, &pTx, pError));
+    ABC_CHECK_RET(ABC_TxMakeTransactionInfo(pTx, &pTransaction, pError));
+
+    // assign final result
+    *ppTransaction = pTransaction;
+    pTransaction = NULL;
+
+exit:
+    ABC_TxFreeTx(pTx);
+    ABC_TxFreeTransaction(pTransaction);
+
+    return cc;
+}
+
+/**
+ * Moves the transaction info out of a loaded transaction.
+ *
+ * @param pTx               Transaction to steal from (caller still frees it)
+ * @param ppTransaction     Location to store allocated transaction
+ *                          (caller must free)
+ */
+static
+tABC_CC ABC_TxMakeTransactionInfo(tABC_Tx *pTx,
+                                  tABC_TxInfo **ppTransaction,
+                                  tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+
+    tABC_TxInfo *pTransaction = NULL;
+
+    *ppTransaction = NULL;
+
     ABC_CHECK_NULL(pTx->pDetails);
     ABC_CHECK_NULL(pTx->pStateInfo);
 
@@ -1981,32 +2036,32 @@ tABC_CC ABC_TxLoadTransactionInfo(tABC_WalletID self,
     pTransaction = NULL;
 
 exit:
-    ABC_TxFreeTx(pTx);
     ABC_TxFreeTransaction(pTransaction);
 
     return cc;
 }
 
 /**
- * Loads the given transaction info and adds it to the end of the array
+ * Decodes the given transaction info and adds it to the end of the array
  *
- * @param szFilename        Filename of transaction
+ * @param pJSON_Root        Decrypted transaction file
  * @param paTransactions    Pointer to array into which the transaction will be added
  * @param pCount            Pointer to store number of transactions (will be updated)
  * @param pError            A pointer to the location to store the error if there is one
  */
 static
-tABC_CC ABC_TxLoadTxAndAppendToArray(tABC_WalletID self,
-                                     int64_t startTime,
-                                     int64_t endTime,
-                                     const char *szFilename,
-                                     tABC_TxInfo ***paTransactions,
-                                     unsigned int *pCount,
-                                     tABC_Error *pError)
+tABC_CC ABC_TxDecodeTxAndAppendToArray(tABC_WalletID self,
+                                       int64_t startTime,
+                                       int64_t endTime,
+                                       json_t *pJSON_Root,
+                                       tABC_TxInfo ***paTransactions,
+                                       unsigned int *pCount,
+                                       tABC_Error *pError)
 {
     tABC_CC cc = ABC_CC_Ok;
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
 
+    tABC_Tx *pTx = NULL;
     tABC_TxInfo *pTransaction = NULL;
     tABC_TxInfo **aTransactions = NULL;
     unsigned int count = 0;
@@ -2015,8 +2070,9 @@ tABC_CC ABC_TxLoadTxAndAppendToArray(tABC_WalletID self,
     count = *pCount;
     aTransactions = *paTransactions;
 
-    // load it into the info transaction structure
-    ABC_CHECK_RET(ABC_TxLoadTransactionInfo(self, szFilename, &pTransaction, pError));
+    // decode it into the info transaction structure
+    ABC_CHECK_RET(ABC_TxDecodeTransaction(self, pJSON_Root, &pTx, pError));
+    ABC_CHECK_RET(ABC_TxMakeTransactionInfo(pTx, &pTransaction, pError));
 
     if ((endTime == ABC_GET_TX_ALL_TIMES) ||
         (pTransaction->timeCreation >= startTime &&
@@ -2045,6 +2101,7 @@ tABC_CC ABC_TxLoadTxAndAppendToArray(tABC_WalletID self,
     }
 
 exit:
+    ABC_TxFreeTx(pTx);
     ABC_TxFreeTransaction(pTransaction);
 
     return cc;
@@ -2582,9 +2639,7 @@ tABC_CC ABC_TxLoadTransaction(tABC_WalletID self,
 
     tABC_U08Buf MK = ABC_BUF_NULL; // Do not free
     json_t *pJSON_Root = NULL;
-    tABC_Tx *pTx = NULL;
     bool bExists = false;
-    json_t *jsonVal = NULL;
 
     *ppTx = NULL;
 
@@ -2598,8 +2653,32 @@ tABC_CC ABC_TxLoadTransaction(tABC_WalletID self,
 
     // load the json object (load file, decrypt it, create json object
     ABC_CHECK_RET(ABC_CryptoDecryptJSONFileObject(szFilename, MK, &pJSON_Root, pError));
+    ABC_CHECK_RET(ABC_TxDecodeTransaction(self, pJSON_Root, ppTx, pError));
+
+exit:
+    if (pJSON_Root) json_decref(pJSON_Root);
+
+    return cc;
+}
 
-    // start decoding
+/**
+ * Decodes a transaction from its decrypted json object
+ *
+ * @param ppTx  Pointer to location to hold allocated transaction
+ *              (it is the callers responsiblity to free this transaction)
+ */
+static
+tABC_CC ABC_TxDecodeTransaction(tABC_WalletID self,
+                                json_t *pJSON_Root,
+                                tABC_Tx **ppTx,
+                                tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+
+    tABC_Tx *pTx = NULL;
+    json_t *jsonVal = NULL;
+
+    *ppTx = NULL;
 
     ABC_NEW(pTx, tABC_Tx);
 
@@ -2626,7 +2705,6 @@ tABC_CC ABC_TxLoadTransaction(tABC_WalletID self,
     pTx = NULL;
 
 exit:
-    if (pJSON_Root) json_decref(pJSON_Root);
     ABC_TxFreeTx(pTx);
 
     return cc;
@@ -3110,9 +3188,7 @@ tABC_CC ABC_TxLoadAddressFile(tABC_WalletID self,
 
     tABC_U08Buf MK = ABC_BUF_NULL; // Do not free
     json_t *pJSON_Root = NULL;
-    tABC_TxAddress *pAddress = NULL;
     bool bExists = false;
-    json_t *jsonVal = NULL;
 
     *ppAddress = NULL;
 
@@ -3126,8 +3202,31 @@ tABC_CC ABC_TxLoadAddressFile(tABC_WalletID self,
 
     // load the json object (load file, decrypt it, create json object
     ABC_CHECK_RET(ABC_CryptoDecryptJSONFileObject(szFilename, MK, &pJSON_Root, pError));
+    ABC_CHECK_RET(ABC_TxDecodeAddress(pJSON_Root, ppAddress, pError));
+
+exit:
+    if (pJSON_Root) json_decref(pJSON_Root);
+
+    return cc;
+}
 
-    // start decoding
+/**
+ * Decodes an address from its decrypted json object
+ *
+ * @param ppAddress  Pointer to location to hold allocated address
+ *                   (it is the callers responsiblity to free this address)
+ */
+static
+tABC_CC ABC_TxDecodeAddress(json_t *pJSON_Root,
+                            tABC_TxAddress **ppAddress,
+                            tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+
+    tABC_TxAddress *pAddress = NULL;
+    json_t *jsonVal = NULL;
+
+    *ppAddress = NULL;
 
     ABC_NEW(pAddress, tABC_TxAddress);
 
@@ -3154,7 +3253,6 @@ tABC_CC ABC_TxLoadAddressFile(tABC_WalletID self,
     pAddress = NULL;
 
 exit:
-    if (pJSON_Root) json_decref(pJSON_Root);
     ABC_TxFreeAddress(pAddress);
 
     return cc;
@@ -3538,6 +3636,10 @@ tABC_CC ABC_TxGetAddresses(tABC_WalletID self,
     tABC_TxAddress **aAddresses = NULL;
     unsigned int count = 0;
     bool bExists = false;
+    tABC_U08Buf MK = ABC_BUF_NULL; // Do not free
+    std::vector<std::string> filenames;
+    std::vector<const char *> aszFilenames;
+    std::vector<json_t *> aJSON;
 
     *paAddresses = NULL;
     *pCount = 0;
@@ -3562,12 +3664,27 @@ tABC_CC ABC_TxGetAddresses(tABC_WalletID self,
                 // create the filename for this address
                 sprintf(szFilename, "%s/%s", szAddrDir, pFileList->apFiles[i]->szName);
 
-                // add this address to the array
-                ABC_CHECK_RET(ABC_TxLoadAddressAndAppendToArray(self, szFilename, &aAddresses, &count, pError));
+                filenames.push_back(szFilename);
             }
         }
     }
 
+    // decrypt the addresses all at once, then add them to the array
+    if (!filenames.empty())
+    {
+        ABC_CHECK_RET(ABC_WalletGetMK(self, &MK, pError));
+        for (const auto &filename: filenames)
+            aszFilenames.push_back(filename.c_str());
+        aJSON.resize(filenames.size());
+        ABC_CHECK_RET(ABC_CryptoDecryptJSONFiles(aszFilenames.data(),
+            aszFilenames.size(), MK, aJSON.data(), 0, pError));
+
+        for (auto pJSON_Root: aJSON)
+        {
+            ABC_CHECK_RET(ABC_TxDecodeAddressAndAppendToArray(pJSON_Root, &aAddresses, &count, pError));
+        }
+    }
+
     // if we have more than one, then let's sort them
     if (count > 1)
     {
@@ -3586,6 +3703,8 @@ exit:
     ABC_FREE_STR(szFilename);
     ABC_FileIOFreeFileList(pFileList);
     ABC_TxFreeAddresses(aAddresses, count);
+    for (auto pJSON_Root: aJSON)
+        if (pJSON_Root) json_decref(pJSON_Root);
 
     return cc;
 }
@@ -3622,19 +3741,18 @@ int ABC_TxAddrPtrCompare(const void * a, const void * b)
 }
 
 /**
- * Loads the given address and adds it to the end of the array
+ * Decodes the given address and adds it to the end of the array
  *
- * @param szFilename        Filename of address
+ * @param pJSON_Root        Decrypted address file
  * @param paAddress         Pointer to array into which the address will be added
  * @param pCount            Pointer to store number of address (will be updated)
  * @param pError            A pointer to the location to store the error if there is one
  */
 static
-tABC_CC ABC_TxLoadAddressAndAppendToArray(tABC_WalletID self,
-                                          const char *szFilename,
-                                          tABC_TxAddress ***paAddresses,
-                                          unsigned int *pCount,
-                                          tABC_Error *pError)
+tABC_CC ABC_TxDecodeAddressAndAppendToArray(json_t *pJSON_Root,
+                                            tABC_TxAddress ***paAddresses,
+                                            unsigned int *pCount,
+                                            tABC_Error *pError)
 {
     tABC_CC cc = ABC_CC_Ok;
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
@@ -3647,8 +3765,8 @@ tABC_CC ABC_TxLoadAddressAndAppendToArray(tABC_WalletID self,
     count = *pCount;
     aAddresses = *paAddresses;
 
-    // load the address
-    ABC_CHECK_RET(ABC_TxLoadAddressFile(self, szFilename, &pAddress, pError));
+    // decode the address
+    ABC_CHECK_RET(ABC_TxDecodeAddress(pJSON_Root, &pAddress, pError));
 
     // create space for new entry
     if (aAddresses == NULL)
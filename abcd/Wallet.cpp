@@ -96,6 +96,10 @@ static tABC_CC ABC_WalletCreateRootDir(tABC_Error *pError);
 static tABC_CC ABC_WalletGetRootDirName(char **pszRootDir, tABC_Error *pError);
 static tABC_CC ABC_WalletGetSyncDirName(char **pszDir, const char *szWalletUUID, tABC_Error *pError);
 static tABC_CC ABC_WalletCacheData(tABC_WalletID self, tWalletData **ppData, tABC_Error *pError);
+static tABC_CC ABC_WalletLoadName(tWalletData *pData, tABC_Error *pError);
+static tABC_CC ABC_WalletLoadCurrency(tWalletData *pData, tABC_Error *pError);
+static tABC_CC ABC_WalletLoadAccounts(tWalletData *pData, tABC_Error *pError);
+static tABC_CC ABC_WalletSyncChanges(tABC_WalletID self, const SyncChanges &changes, tABC_Error *pError);
 static tABC_CC ABC_WalletAddToCache(tWalletData *pData, tABC_Error *pError);
 static tABC_CC ABC_WalletGetFromCacheByUUID(const char *szUUID, tWalletData **ppData, tABC_Error *pError);
 static void    ABC_WalletFreeData(tWalletData *pData);
@@ -269,6 +273,61 @@ exit:
     return cc;
 }
 
+/**
+ * Brings a cached wallet up to date after a sync,
+ * reloading just the files the sync changed.
+ * If a reload fails, the wallet drops out of the cache instead,
+ * since the sync itself worked and the next read reloads everything.
+ */
+static
+tABC_CC ABC_WalletSyncChanges(tABC_WalletID self, const SyncChanges &changes, tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    AutoCoreLock lock(gCoreMutex);
+
+    tWalletData *pData = NULL;
+
+    // If the wallet isn't cached, the next read loads everything anyhow:
+    ABC_CHECK_RET(ABC_WalletGetFromCacheByUUID(self.szUUID, &pData, pError));
+    if (!pData)
+        goto exit;
+
+    for (const auto &change: changes)
+    {
+        tABC_CC reload = ABC_CC_Ok;
+        tABC_Error error;
+
+        if (change.path == WALLET_NAME_FILENAME)
+        {
+            reload = ABC_WalletLoadName(pData, &error);
+        }
+        else if (change.path == WALLET_CURRENCY_FILENAME)
+        {
+            reload = ABC_WalletLoadCurrency(pData, &error);
+        }
+        else if (change.path == WALLET_ACCOUNTS_FILENAME)
+        {
+            reload = ABC_WalletLoadAccounts(pData, &error);
+        }
+        else if (!change.path.compare(0, strlen(WALLET_TX_DIR "/"), WALLET_TX_DIR "/"))
+        {
+            pData->balanceDirty = true;
+        }
+
+        // The loaders free the old field first, so a failure can leave
+        // the cached wallet half-updated. Throw it out and stop here:
+        if (ABC_CC_Ok != reload)
+        {
+            ABC_DebugLog("Cannot reload %s: %s", change.path.c_str(), error.szDescription);
+            ABC_CHECK_RET(ABC_WalletRemoveFromCache(self.szUUID, pError));
+            goto exit;
+        }
+    }
+
+exit:
+    return cc;
+}
+
 /**
  * Sync the wallet's data
  */
@@ -280,9 +339,11 @@ tABC_CC ABC_WalletSyncData(tABC_WalletID self, int *pDirty, tABC_Error *pError)
     tABC_GeneralInfo *pInfo = NULL;
     char *szDirectory       = NULL;
     char *szSyncDirectory   = NULL;
+    char *szRepoKey         = NULL;
     tWalletData *pData      = NULL;
     bool bExists            = false;
     bool bNew               = false;
+    SyncChanges changes;
 
     // Fetch general info
     ABC_CHECK_RET(ABC_GeneralGetInfo(&pInfo, pError));
@@ -304,17 +365,29 @@ tABC_CC ABC_WalletSyncData(tABC_WalletID self, int *pDirty, tABC_Error *pError)
     }
 
     // load the wallet data into the cache
-    ABC_CHECK_RET(ABC_WalletCacheData(self, &pData, pError));
-    ABC_CHECK_ASSERT(NULL != pData->szWalletAcctKey, ABC_CC_Error, "Expected to find RepoAcctKey in key cache");
+    {
+        // Other wallets may be syncing on other threads,
+        // and their syncs can clear the cache, so copy the key out:
+        AutoCoreLock lock(gCoreMutex);
+        ABC_CHECK_RET(ABC_WalletCacheData(self, &pData, pError));
+        ABC_CHECK_ASSERT(NULL != pData->szWalletAcctKey, ABC_CC_Error, "Expected to find RepoAcctKey in key cache");
+        ABC_STRDUP(szRepoKey, pData->szWalletAcctKey);
+    }
 
     // Sync
-    ABC_CHECK_RET(ABC_SyncRepo(pData->szWalletSyncDir, pData->szWalletAcctKey, pDirty, pError));
-    if (*pDirty || bNew)
+    ABC_CHECK_RET(ABC_SyncRepo(szSyncDirectory, szRepoKey, pDirty, &changes, pError));
+    if (bNew)
     {
+        // Anything cached predates the wallet's files:
         *pDirty = 1;
-        ABC_WalletClearCache();
+        ABC_CHECK_RET(ABC_WalletRemoveFromCache(self.szUUID, pError));
+    }
+    else if (*pDirty)
+    {
+        ABC_CHECK_RET(ABC_WalletSyncChanges(self, changes, pError));
     }
 exit:
+    ABC_FREE_STR(szRepoKey);
     ABC_FREE_STR(szSyncDirectory);
     ABC_FREE_STR(szDirectory);
     ABC_GeneralFreeInfo(pInfo);
@@ -580,6 +653,87 @@ exit:
     return cc;
 }
 
+/**
+ * Loads the wallet name from the sync directory into the cached data,
+ * or clears it if the file does not exist.
+ */
+static
+tABC_CC ABC_WalletLoadName(tWalletData *pData, tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    bool bExists = false;
+
+    ABC_FREE_STR(pData->szName);
+
+    auto filename = std::string(pData->szWalletSyncDir) + "/" + WALLET_NAME_FILENAME;
+    ABC_CHECK_RET(ABC_FileIOFileExists(filename.c_str(), &bExists, pError));
+    if (true == bExists)
+    {
+        AutoU08Buf Data;
+        ABC_CHECK_RET(ABC_CryptoDecryptJSONFile(filename.c_str(), pData->MK, &Data, pError));
+        ABC_CHECK_RET(ABC_UtilGetStringValueFromJSONString((char *)ABC_BUF_PTR(Data), JSON_WALLET_NAME_FIELD, &(pData->szName), pError));
+    }
+    else
+    {
+        ABC_STRDUP(pData->szName, "");
+    }
+
+exit:
+    return cc;
+}
+
+/**
+ * Loads the wallet currency from the sync directory into the cached data,
+ * or clears it if the file does not exist.
+ */
+static
+tABC_CC ABC_WalletLoadCurrency(tWalletData *pData, tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    bool bExists = false;
+
+    pData->currencyNum = -1;
+
+    auto filename = std::string(pData->szWalletSyncDir) + "/" + WALLET_CURRENCY_FILENAME;
+    ABC_CHECK_RET(ABC_FileIOFileExists(filename.c_str(), &bExists, pError));
+    if (true == bExists)
+    {
+        AutoU08Buf Data;
+        ABC_CHECK_RET(ABC_CryptoDecryptJSONFile(filename.c_str(), pData->MK, &Data, pError));
+        ABC_CHECK_RET(ABC_UtilGetIntValueFromJSONString((char *)ABC_BUF_PTR(Data), JSON_WALLET_CURRENCY_NUM_FIELD, (int *) &(pData->currencyNum), pError));
+    }
+
+exit:
+    return cc;
+}
+
+/**
+ * Loads the wallet's account list from the sync directory into the
+ * cached data, or clears it if the file does not exist.
+ */
+static
+tABC_CC ABC_WalletLoadAccounts(tWalletData *pData, tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    bool bExists = false;
+
+    ABC_UtilFreeStringArray(pData->aszAccounts, pData->numAccounts);
+    pData->aszAccounts = NULL;
+    pData->numAccounts = 0;
+
+    auto filename = std::string(pData->szWalletSyncDir) + "/" + WALLET_ACCOUNTS_FILENAME;
+    ABC_CHECK_RET(ABC_FileIOFileExists(filename.c_str(), &bExists, pError));
+    if (true == bExists)
+    {
+        AutoU08Buf Data;
+        ABC_CHECK_RET(ABC_CryptoDecryptJSONFile(filename.c_str(), pData->MK, &Data, pError));
+        ABC_CHECK_RET(ABC_UtilGetArrayValuesFromJSONString((char *)ABC_BUF_PTR(Data), JSON_WALLET_ACCOUNTS_FIELD, &(pData->aszAccounts), &(pData->numAccounts), pError));
+    }
+
+exit:
+    return cc;
+}
+
 /**
  * Adds the wallet data to the cache
  * If the wallet is not currently in the cache it is added
@@ -591,7 +745,6 @@ tABC_CC ABC_WalletCacheData(tABC_WalletID self, tWalletData **ppData, tABC_Error
     AutoCoreLock lock(gCoreMutex);
 
     tWalletData *pData = NULL;
-    char *szFilename = NULL;
     AutoAccountWalletInfo info;
     memset(&info, 0, sizeof(tABC_AccountWalletInfo));
 
@@ -632,66 +785,11 @@ tABC_CC ABC_WalletCacheData(tABC_WalletID self, tWalletData **ppData, tABC_Error
         // Encode the sync key into our struct:
         ABC_STRDUP(pData->szWalletAcctKey, base16Encode(info.SyncKey).c_str());
 
-        // make sure this wallet exists, if it doesn't leave fields empty
-        bool bExists = false;
-        ABC_CHECK_RET(ABC_FileIOFileExists(pData->szWalletSyncDir, &bExists, pError));
-        if (!bExists)
-        {
-            ABC_STRDUP(pData->szName, "");
-            pData->currencyNum = -1;
-            pData->numAccounts = 0;
-            pData->aszAccounts = NULL;
-        }
-        else
-        {
-            // get the name
-            ABC_STR_NEW(szFilename, ABC_FILEIO_MAX_PATH_LENGTH);
-            sprintf(szFilename, "%s/%s", pData->szWalletSyncDir, WALLET_NAME_FILENAME);
-            bExists = false;
-            ABC_CHECK_RET(ABC_FileIOFileExists(szFilename, &bExists, pError));
-            if (true == bExists)
-            {
-                AutoU08Buf Data;
-                ABC_CHECK_RET(ABC_CryptoDecryptJSONFile(szFilename, pData->MK, &Data, pError));
-                ABC_CHECK_RET(ABC_UtilGetStringValueFromJSONString((char *)ABC_BUF_PTR(Data), JSON_WALLET_NAME_FIELD, &(pData->szName), pError));
-            }
-            else
-            {
-                ABC_STRDUP(pData->szName, "");
-            }
-
-            // get the currency num
-            sprintf(szFilename, "%s/%s", pData->szWalletSyncDir, WALLET_CURRENCY_FILENAME);
-            bExists = false;
-            ABC_CHECK_RET(ABC_FileIOFileExists(szFilename, &bExists, pError));
-            if (true == bExists)
-            {
-                AutoU08Buf Data;
-                ABC_CHECK_RET(ABC_CryptoDecryptJSONFile(szFilename, pData->MK, &Data, pError));
-                ABC_CHECK_RET(ABC_UtilGetIntValueFromJSONString((char *)ABC_BUF_PTR(Data), JSON_WALLET_CURRENCY_NUM_FIELD, (int *) &(pData->currencyNum), pError));
-            }
-            else
-            {
-                pData->currencyNum = -1;
-            }
+        // Load the files from the sync directory, if there are any:
+        ABC_CHECK_RET(ABC_WalletLoadName(pData, pError));
+        ABC_CHECK_RET(ABC_WalletLoadCurrency(pData, pError));
+        ABC_CHECK_RET(ABC_WalletLoadAccounts(pData, pError));
 
-            // get the accounts
-            sprintf(szFilename, "%s/%s", pData->szWalletSyncDir, WALLET_ACCOUNTS_FILENAME);
-            bExists = false;
-            ABC_CHECK_RET(ABC_FileIOFileExists(szFilename, &bExists, pError));
-            if (true == bExists)
-            {
-                AutoU08Buf Data;
-                ABC_CHECK_RET(ABC_CryptoDecryptJSONFile(szFilename, pData->MK, &Data, pError));
-                ABC_CHECK_RET(ABC_UtilGetArrayValuesFromJSONString((char *)ABC_BUF_PTR(Data), JSON_WALLET_ACCOUNTS_FIELD, &(pData->aszAccounts), &(pData->numAccounts), pError));
-            }
-            else
-            {
-                pData->numAccounts = 0;
-                pData->aszAccounts = NULL;
-            }
-
-        }
         pData->balance = 0;
         pData->balanceDirty = true;
 
@@ -711,7 +809,6 @@ exit:
         ABC_WalletFreeData(pData);
         ABC_CLEAR_FREE(pData, sizeof(tWalletData));
     }
-    ABC_FREE_STR(szFilename);
 
     return cc;
 }
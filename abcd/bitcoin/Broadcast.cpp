@@ -12,6 +12,13 @@
 #include "../json/JsonObject.hpp"
 #include "../util/URL.hpp"
 #include <curl/curl.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 namespace abcd {
 
@@ -62,6 +69,8 @@ chainPostTx(DataSlice tx)
         return ABC_ERROR(ABC_CC_Error, "Curl failed to set data\n");
     if (curl_easy_setopt(curlHandle, CURLOPT_WRITEFUNCTION, curlWriteData))
         return ABC_ERROR(ABC_CC_Error, "Curl failed to set callback\n");
+    if (curl_easy_setopt(curlHandle, CURLOPT_TIMEOUT, (long)ABC_URL_BACKGROUND_TIMEOUT))
+        return ABC_ERROR(ABC_CC_Error, "Curl failed to set timeout\n");
     if (curl_easy_perform(curlHandle))
         return ABC_ERROR(ABC_CC_Error, "Curl failed to perform\n");
 
@@ -97,6 +106,8 @@ blockhainPostTx(DataSlice tx)
         return ABC_ERROR(ABC_CC_Error, "Curl failed to set data\n");
     if (curl_easy_setopt(curlHandle, CURLOPT_WRITEFUNCTION, curlWriteData))
         return ABC_ERROR(ABC_CC_Error, "Curl failed to set callback\n");
+    if (curl_easy_setopt(curlHandle, CURLOPT_TIMEOUT, (long)ABC_URL_BACKGROUND_TIMEOUT))
+        return ABC_ERROR(ABC_CC_Error, "Curl failed to set timeout\n");
     if (curl_easy_perform(curlHandle))
         return ABC_ERROR(ABC_CC_Error, "Curl failed to perform\n");
 
@@ -112,21 +123,118 @@ blockhainPostTx(DataSlice tx)
     return Status();
 }
 
+/**
+ * A place to send transactions.
+ */
+struct BroadcastEndpoint
+{
+    const char *name;
+    Status (*post)(DataSlice tx);
+};
+
+/**
+ * The shared state for one transaction's broadcasts.
+ * Whichever thread finishes last frees it.
+ */
+struct BroadcastState
+{
+    DataChunk tx;
+
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t pending;
+    bool success;
+    Status error;
+};
+
+static std::mutex gStatsMutex;
+static std::map<std::string, BroadcastStats> gStats;
+
+/**
+ * Posts to one endpoint, recording how long it took.
+ */
+static void
+broadcastTo(const BroadcastEndpoint &endpoint,
+    std::shared_ptr<BroadcastState> state, bool preferred)
+{
+    auto start = std::chrono::steady_clock::now();
+    Status s = endpoint.post(state->tx);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    ABC_DebugLog("Broadcast to %s %s in %d ms\n", endpoint.name,
+        s ? "succeeded" : "failed", (int)ms);
+    {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        auto &stats = gStats[endpoint.name];
+        ++stats.attempts;
+        if (s)
+            ++stats.successes;
+        stats.lastMs = ms;
+        stats.totalMs += ms;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        --state->pending;
+        // Report the preferred endpoint's error, or else the first one:
+        if (s)
+            state->success = true;
+        else if (preferred || state->error)
+            state->error = s;
+        state->done.notify_all();
+    }
+    ABC_URLBackgroundDone();
+}
+
 Status
 broadcastTx(DataSlice rawTx)
 {
-    Status out = chainPostTx(rawTx);
+    std::vector<BroadcastEndpoint> endpoints;
+    endpoints.push_back(BroadcastEndpoint{"chain", chainPostTx});
 
     // Only try Blockchain when not on testnet:
     if (!isTestnet())
+        endpoints.push_back(BroadcastEndpoint{"blockchain", blockhainPostTx});
+
+    auto state = std::make_shared<BroadcastState>();
+    state->tx = DataChunk(rawTx.begin(), rawTx.end());
+    state->pending = endpoints.size();
+    state->success = false;
+
+    // Post everywhere at once. The threads hold their own references
+    // to the state, so the slow ones can finish after we return.
+    // ABC_URLTerminate waits for any stragglers:
+    for (size_t i = 0; i < endpoints.size(); ++i)
     {
-        if (out)
-            blockhainPostTx(rawTx);
-        else
-            out = blockhainPostTx(rawTx);
+        bool preferred = !i;
+        ABC_URLBackgroundStart();
+        try
+        {
+            std::thread(broadcastTo, endpoints[i], state, preferred).detach();
+        }
+        catch (const std::system_error &)
+        {
+            broadcastTo(endpoints[i], state, preferred);
+        }
     }
 
-    return out;
+    // Return as soon as anyone succeeds, or everyone fails:
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]()
+    {
+        return state->success || !state->pending;
+    });
+    if (state->success)
+        return Status();
+    return state->error;
+}
+
+std::map<std::string, BroadcastStats>
+broadcastStats()
+{
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    return gStats;
 }
 
 } // namespace abcd
@@ -10,15 +10,36 @@
 
 #include "../util/Data.hpp"
 #include "../util/Status.hpp"
+#include <map>
+#include <string>
 
 namespace abcd {
 
 /**
  * Sends a transaction out to the Bitcoin network.
+ * This posts to every endpoint at once, and returns as soon as one
+ * of them accepts the transaction. The others finish in the background.
  */
 Status
 broadcastTx(DataSlice rawTx);
 
+/**
+ * Timing information for a broadcast endpoint.
+ */
+struct BroadcastStats
+{
+    unsigned attempts = 0;
+    unsigned successes = 0;
+    long lastMs = 0;
+    long totalMs = 0;
+};
+
+/**
+ * Returns the timing for each endpoint, indexed by name.
+ */
+std::map<std::string, BroadcastStats>
+broadcastStats();
+
 } // namespace abcd
 
 #endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "CoinSelection.hpp"
+#include <algorithm>
+
+namespace abcd {
+
+/**
+ * An available output, remembering where it came from.
+ */
+struct Coin
+{
+    uint64_t value;
+    size_t index;
+};
+
+/**
+ * Searches for an input set that needs no change output.
+ * The coins must be sorted largest-first, which lets the search
+ * find good matches early and prune most of the tree.
+ *
+ * An input set is a hit if its total lies between the target plus fee
+ * and the target plus fee plus the cost of a change output.
+ * Anything left over in that window goes to the miners.
+ *
+ * Pruning assumes that each extra input adds more value than fee.
+ * The fee schedule is a step function, so this is not strictly true,
+ * but every hit is checked against the exact fee for its input count.
+ */
+static bool
+selectChangeless(CoinSelection &result, const std::vector<Coin> &coins,
+    const CoinSelectionParams &params)
+{
+    const size_t n = coins.size();
+
+    // remaining[i] is the sum of coins[i..n):
+    std::vector<uint64_t> remaining(n + 1, 0);
+    for (size_t i = n; 0 < i; --i)
+        remaining[i - 1] = remaining[i] + coins[i - 1].value;
+
+    const auto deadline = std::chrono::steady_clock::now() + params.budget;
+    std::vector<bool> selected(n, false);
+    std::vector<bool> best;
+    uint64_t bestSpent = UINT64_MAX;
+    uint64_t bestFee = 0;
+    uint64_t sum = 0;
+    size_t count = 0;
+    size_t depth = 0;
+
+    for (size_t tries = 0; tries < params.maxTries; ++tries)
+    {
+        if (!(tries % 1024) && deadline < std::chrono::steady_clock::now())
+            break;
+
+        const uint64_t fee = params.fee(count, false);
+        const uint64_t need = params.target + fee;
+        const uint64_t changeCost =
+            params.fee(count, true) - fee + params.minChange;
+
+        bool backtrack = false;
+        if (sum + remaining[depth] < need)
+        {
+            // Even taking everything left won't be enough:
+            backtrack = true;
+        }
+        else if (need + changeCost < sum)
+        {
+            // Overshot the window, so we would need change:
+            backtrack = true;
+        }
+        else if (need <= sum)
+        {
+            // A hit:
+            if (sum < bestSpent)
+            {
+                best = selected;
+                bestSpent = sum;
+                bestFee = fee;
+            }
+            backtrack = true;
+        }
+        else if (bestSpent <= params.target + fee || n <= depth)
+        {
+            // Can't beat the best, or nothing left to add:
+            backtrack = true;
+        }
+
+        if (backtrack)
+        {
+            // Unwind to the last included coin and exclude it instead:
+            while (0 < depth && !selected[depth - 1])
+                --depth;
+            if (!depth)
+                break;
+            --depth;
+            selected[depth] = false;
+            sum -= coins[depth].value;
+            --count;
+            ++depth;
+        }
+        else
+        {
+            // Try including the next coin:
+            selected[depth] = true;
+            sum += coins[depth].value;
+            ++count;
+            ++depth;
+        }
+    }
+
+    if (best.empty())
+        return false;
+
+    result.inputs.clear();
+    for (size_t i = 0; i < n; ++i)
+        if (best[i])
+            result.inputs.push_back(coins[i].index);
+    result.total = bestSpent;
+    result.fee = bestFee;
+    result.change = 0;
+    return true;
+}
+
+/**
+ * Fills in the fee and change for a set of coins,
+ * dropping the change if it would be too small to bother with.
+ * @return false if the coins cannot pay for the target and fee.
+ */
+static bool
+settle(CoinSelection &result, const CoinSelectionParams &params)
+{
+    const size_t count = result.inputs.size();
+    const uint64_t withChange = params.target + params.fee(count, true);
+    if (withChange + params.minChange <= result.total)
+    {
+        result.fee = withChange - params.target;
+        result.change = result.total - withChange;
+        return true;
+    }
+
+    const uint64_t without = params.target + params.fee(count, false);
+    if (without <= result.total)
+    {
+        result.fee = without - params.target;
+        result.change = 0;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Picks the cheaper of two solutions with change:
+ * the smallest single coin that covers everything,
+ * or the fewest coins taken largest-first.
+ * Ties go to the single coin, since that leaves the big coins intact.
+ */
+static bool
+selectWithChange(CoinSelection &result, const std::vector<Coin> &coins,
+    const CoinSelectionParams &params)
+{
+    bool found = false;
+
+    // Largest-first accumulation:
+    CoinSelection many;
+    many.total = 0;
+    for (const auto &coin: coins)
+    {
+        many.inputs.push_back(coin.index);
+        many.total += coin.value;
+        if (settle(many, params))
+        {
+            result = many;
+            found = true;
+            break;
+        }
+    }
+
+    // The smallest single coin that does the job:
+    for (auto i = coins.rbegin(); i != coins.rend(); ++i)
+    {
+        CoinSelection one;
+        one.inputs.push_back(i->index);
+        one.total = i->value;
+        if (settle(one, params))
+        {
+            if (!found || one.spent() <= result.spent())
+                result = one;
+            found = true;
+            break;
+        }
+    }
+
+    return found;
+}
+
+Status
+coinSelect(CoinSelection &result, const std::vector<uint64_t> &values,
+    const CoinSelectionParams &params)
+{
+    std::vector<Coin> coins;
+    coins.reserve(values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+        if (values[i])
+            coins.push_back(Coin{values[i], i});
+    std::sort(coins.begin(), coins.end(),
+        [](const Coin &a, const Coin &b){ return a.value > b.value; });
+
+    CoinSelection out;
+    if (!selectChangeless(out, coins, params) &&
+        !selectWithChange(out, coins, params))
+        return ABC_ERROR(ABC_CC_InsufficientFunds, "Insufficent funds.");
+
+    result = std::move(out);
+    return Status();
+}
+
+} // namespace abcd
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Fee-aware coin selection.
+ */
+
+#ifndef ABCD_BITCOIN_COIN_SELECTION_HPP
+#define ABCD_BITCOIN_COIN_SELECTION_HPP
+
+#include "../util/Status.hpp"
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace abcd {
+
+/**
+ * Computes the miner fee for a transaction spending the given number
+ * of inputs, either with or without a change output.
+ * The fee must never go down as the number of inputs goes up.
+ */
+typedef std::function<uint64_t (size_t inputs, bool change)> CoinFeeFunction;
+
+/**
+ * Describes what the selected inputs need to pay for.
+ */
+struct CoinSelectionParams
+{
+    /** The amount going to the non-change outputs. */
+    uint64_t target;
+    /** The fee for a candidate input set. */
+    CoinFeeFunction fee;
+    /** Change smaller than this goes to the miners instead. */
+    uint64_t minChange;
+    /** The longest the changeless search may run. */
+    std::chrono::microseconds budget;
+    /** The most candidate sets the changeless search may visit. */
+    size_t maxTries;
+};
+
+/**
+ * A set of inputs that pays for a transaction.
+ */
+struct CoinSelection
+{
+    /** Indices into the list of values given to `coinSelect`. */
+    std::vector<size_t> inputs;
+    /** Sum of the selected input values. */
+    uint64_t total;
+    /** Fee for this input set. */
+    uint64_t fee;
+    /** Change to send back to the wallet, or 0 for none. */
+    uint64_t change;
+
+    /**
+     * Everything that leaves the wallet: the target, the fee,
+     * and any excess given to the miners in place of change.
+     * For a fixed target, the smallest value wastes the least.
+     */
+    uint64_t spent() const { return total - change; }
+};
+
+/**
+ * Chooses which outputs to spend.
+ * First, this runs a depth-first branch-and-bound search for a changeless
+ * solution with the lowest waste. If none turns up within the
+ * budget, this falls back on the cheapest solution with change.
+ * @param values the values of the available outputs.
+ */
+Status
+coinSelect(CoinSelection &result, const std::vector<uint64_t> &values,
+    const CoinSelectionParams &params);
+
+} // namespace abcd
+
+#endif
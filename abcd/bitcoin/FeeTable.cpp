@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "FeeTable.hpp"
+#include <algorithm>
+
+namespace abcd {
+
+/**
+ * The largest bucket array worth building.
+ */
+constexpr size_t maxBuckets = 1 << 16;
+
+static uint64_t
+gcd(uint64_t a, uint64_t b)
+{
+    while (b)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * Finds the fee the slow way, exactly as the table is meant to be read.
+ */
+static uint64_t
+scanFee(const tABC_GeneralInfo *pInfo, uint64_t txSize)
+{
+    for (unsigned i = 0; i < pInfo->countMinersFees; ++i)
+        if (txSize <= pInfo->aMinersFees[i]->sizeTransaction)
+            return pInfo->aMinersFees[i]->amountSatoshi;
+    return 0;
+}
+
+FeeTable::FeeTable(const tABC_GeneralInfo *pInfo):
+    step_(0)
+{
+    uint64_t largest = 0;
+    for (unsigned i = 0; i < pInfo->countMinersFees; ++i)
+    {
+        uint64_t size = pInfo->aMinersFees[i]->sizeTransaction;
+        largest = std::max(largest, size);
+        step_ = gcd(step_, size);
+    }
+    if (!step_)
+        step_ = 1;
+
+    // Sizes that fall in the same bucket compare the same way against
+    // every entry, so one scan per bucket covers them all:
+    if (largest / step_ < maxBuckets)
+    {
+        buckets_.resize(largest / step_ + 1);
+        for (size_t i = 0; i < buckets_.size(); ++i)
+            buckets_[i] = scanFee(pInfo, i * step_);
+        return;
+    }
+
+    // Otherwise, fall back on a binary search:
+    for (unsigned i = 0; i < pInfo->countMinersFees; ++i)
+    {
+        uint64_t size = pInfo->aMinersFees[i]->sizeTransaction;
+        sorted_.emplace_back(size, scanFee(pInfo, size));
+    }
+    std::sort(sorted_.begin(), sorted_.end());
+}
+
+uint64_t
+FeeTable::sizeFee(size_t txSize) const
+{
+    if (buckets_.size())
+    {
+        uint64_t bucket = (txSize + step_ - 1) / step_;
+        return bucket < buckets_.size() ? buckets_[bucket] : 0;
+    }
+
+    auto i = std::lower_bound(sorted_.begin(), sorted_.end(),
+        std::make_pair(uint64_t(txSize), uint64_t(0)));
+    return i != sorted_.end() ? i->second : 0;
+}
+
+uint64_t
+FeeTable::minerFee(size_t txSize, uint64_t amountSatoshi) const
+{
+    uint64_t sizeFee = this->sizeFee(txSize);
+    if (!sizeFee)
+        return 0;
+
+    // The amount-based fee is 0.1% of total funds sent:
+    uint64_t amountFee = amountSatoshi / 1000;
+
+    // Clamp the amount fee between 10% and 100% of the size-based fee:
+    uint64_t minFee = sizeFee / 10;
+    amountFee = std::max(amountFee, minFee);
+    amountFee = std::min(amountFee, sizeFee);
+
+    // Make the result an integer multiple of the minimum fee:
+    if (!minFee)
+        return amountFee;
+    return amountFee - amountFee % minFee;
+}
+
+} // namespace abcd
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Fast miner-fee quotes from the server's fee schedule.
+ */
+
+#ifndef ABCD_BITCOIN_FEE_TABLE_HPP
+#define ABCD_BITCOIN_FEE_TABLE_HPP
+
+#include "../General.hpp"
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+namespace abcd {
+
+/**
+ * Answers miner-fee questions in constant time.
+ * The general info lists fees by maximum transaction size,
+ * and the first entry that fits a transaction sets its fee.
+ * This class precomputes that search for every possible size.
+ */
+class FeeTable
+{
+public:
+    FeeTable(const tABC_GeneralInfo *pInfo);
+
+    /**
+     * The fee schedule's entry for a transaction of this size,
+     * or 0 if the transaction is larger than the table allows.
+     */
+    uint64_t
+    sizeFee(size_t txSize) const;
+
+    /**
+     * The miner fee for a transaction, which scales with the amount sent,
+     * from 10% of the size-based fee up to the full size-based fee.
+     */
+    uint64_t
+    minerFee(size_t txSize, uint64_t amountSatoshi) const;
+
+private:
+    /** Every table entry's size is a multiple of this. */
+    uint64_t step_;
+    /** The fee for sizes in (step * (i - 1), step * i]. */
+    std::vector<uint64_t> buckets_;
+
+    /**
+     * Sorted (size, fee) pairs, for tables that are too sparse to bucket.
+     * Each fee is already the first match in the original table order.
+     */
+    std::vector<std::pair<uint64_t, uint64_t>> sorted_;
+};
+
+} // namespace abcd
+
+#endif
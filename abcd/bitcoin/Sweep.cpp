@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Sweep.hpp"
+#include "TxSize.hpp"
+
+namespace abcd {
+
+size_t
+sweepTxSize(const std::vector<bool> &compressed)
+{
+    size_t size = txOverheadSize(compressed.size(), 1) + p2pkhOutputSize;
+    for (auto c: compressed)
+        size += p2pkhInputSize(c);
+    return size;
+}
+
+uint64_t
+sweepOutput(uint64_t funds, uint64_t fee)
+{
+    if (funds < fee + SWEEP_MIN_OUTPUT)
+        return 0;
+    return funds - fee;
+}
+
+SweepProgress::SweepProgress(const std::vector<std::string> &addresses)
+{
+    for (const auto &address: addresses)
+        keys_[address] = false;
+}
+
+bool
+SweepProgress::receive(const std::string &address, const std::string &point,
+    uint64_t value)
+{
+    if (!resolve(address))
+        return false;
+
+    if (!spent_.count(point) && unspent_.emplace(point, value).second)
+        funds_ += value;
+    return true;
+}
+
+bool
+SweepProgress::spend(const std::string &address, const std::string &point)
+{
+    if (!resolve(address))
+        return false;
+
+    if (spent_.insert(point).second)
+    {
+        auto i = unspent_.find(point);
+        if (unspent_.end() != i)
+        {
+            funds_ -= i->second;
+            unspent_.erase(i);
+        }
+    }
+    return true;
+}
+
+void
+SweepProgress::resolveAll()
+{
+    for (auto &key: keys_)
+        key.second = true;
+    resolved_ = keys_.size();
+}
+
+bool
+SweepProgress::resolve(const std::string &address)
+{
+    auto i = keys_.find(address);
+    if (keys_.end() == i)
+        return false;
+
+    if (!i->second)
+    {
+        i->second = true;
+        ++resolved_;
+    }
+    return true;
+}
+
+} // namespace abcd
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Bookkeeping for sweeping private keys into a wallet.
+ */
+
+#ifndef ABCD_BITCOIN_SWEEP_HPP
+#define ABCD_BITCOIN_SWEEP_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace abcd {
+
+// Don't bother sweeping if the result would be dust:
+#define SWEEP_MIN_OUTPUT 5430
+
+/**
+ * The size of a signed sweep transaction,
+ * which spends every input to a single pay-to-pubkey-hash output.
+ * @param compressed the format of the key behind each input,
+ * one entry per input.
+ */
+size_t
+sweepTxSize(const std::vector<bool> &compressed);
+
+/**
+ * The amount a sweep delivers once its miner fee is paid,
+ * or 0 if that would come out below SWEEP_MIN_OUTPUT.
+ */
+uint64_t
+sweepOutput(uint64_t funds, uint64_t fee);
+
+/**
+ * Follows a multi-key sweep as the watcher reports transactions,
+ * without going back to the database.
+ *
+ * A key counts as resolved once any transaction touches its address,
+ * or once the watcher has fetched every history, even an empty one.
+ * Outpoints are opaque strings, so spends may arrive before the outputs
+ * they spend.
+ */
+class SweepProgress
+{
+public:
+    SweepProgress() {}
+    SweepProgress(const std::vector<std::string> &addresses);
+
+    /**
+     * Records a transaction output paying one of the swept addresses.
+     * @return false if the address is not part of this sweep.
+     */
+    bool
+    receive(const std::string &address, const std::string &point,
+        uint64_t value);
+
+    /**
+     * Records a transaction input spending from one of the swept addresses.
+     * @return false if the address is not part of this sweep.
+     */
+    bool
+    spend(const std::string &address, const std::string &point);
+
+    /**
+     * Marks every key as resolved, once the watcher has caught up.
+     */
+    void
+    resolveAll();
+
+    unsigned resolved() const { return resolved_; }
+    unsigned total() const { return keys_.size(); }
+    uint64_t funds() const { return funds_; }
+
+private:
+    /** Swept addresses, and whether each one has resolved. */
+    std::unordered_map<std::string, bool> keys_;
+    /** Unspent outputs seen so far, and their values. */
+    std::unordered_map<std::string, uint64_t> unspent_;
+    /** Outputs known to be spent. */
+    std::set<std::string> spent_;
+
+    unsigned resolved_ = 0;
+    uint64_t funds_ = 0;
+
+    bool
+    resolve(const std::string &address);
+};
+
+} // namespace abcd
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "TxSize.hpp"
+
+namespace abcd {
+
+/**
+ * A DER signature is at most 72 bytes,
+ * plus the hash type byte that goes with it.
+ */
+constexpr size_t maxSignatureSize = 72 + 1;
+
+size_t
+varIntSize(uint64_t value)
+{
+    if (value < 0xfd)
+        return 1;
+    if (value <= 0xffff)
+        return 3;
+    if (value <= 0xffffffff)
+        return 5;
+    return 9;
+}
+
+size_t
+txOverheadSize(size_t inputs, size_t outputs)
+{
+    return 4 + varIntSize(inputs) + varIntSize(outputs) + 4;
+}
+
+size_t
+p2pkhInputSize(bool compressed)
+{
+    // Push the signature, then push the public key:
+    size_t script = 1 + maxSignatureSize + 1 + (compressed ? 33 : 65);
+
+    // Outpoint, script, sequence:
+    return 32 + 4 + varIntSize(script) + script + 4;
+}
+
+size_t
+p2pkhTxSize(size_t inputs, size_t outputs, size_t outputBytes,
+    bool compressed)
+{
+    return txOverheadSize(inputs, outputs) +
+        inputs * p2pkhInputSize(compressed) + outputBytes;
+}
+
+} // namespace abcd
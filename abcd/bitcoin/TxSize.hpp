@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Predicts the size of a transaction before it is signed.
+ */
+
+#ifndef ABCD_BITCOIN_TX_SIZE_HPP
+#define ABCD_BITCOIN_TX_SIZE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace abcd {
+
+/**
+ * The size of a pay-to-pubkey-hash output:
+ * an 8-byte value, a 1-byte script length, and a 25-byte script.
+ */
+constexpr size_t p2pkhOutputSize = 8 + 1 + 25;
+
+/**
+ * The size of a pay-to-script-hash output:
+ * an 8-byte value, a 1-byte script length, and a 23-byte script.
+ */
+constexpr size_t p2shOutputSize = 8 + 1 + 23;
+
+/**
+ * The size of a variable-length integer in the wire format.
+ */
+size_t
+varIntSize(uint64_t value);
+
+/**
+ * The size of a transaction without its inputs and outputs:
+ * the version, the two list lengths, and the lock time.
+ */
+size_t
+txOverheadSize(size_t inputs, size_t outputs);
+
+/**
+ * The size of a signed pay-to-pubkey-hash input.
+ * This assumes the longest possible DER signature,
+ * so it may be a byte or two too large, but is never too small.
+ */
+size_t
+p2pkhInputSize(bool compressed=true);
+
+/**
+ * The size of a signed transaction spending pay-to-pubkey-hash inputs.
+ * @param outputBytes the combined size of all the outputs.
+ */
+size_t
+p2pkhTxSize(size_t inputs, size_t outputs, size_t outputBytes,
+    bool compressed=true);
+
+} // namespace abcd
+
+#endif
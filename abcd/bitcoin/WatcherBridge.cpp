@@ -31,13 +31,18 @@
 
 #include "WatcherBridge.hpp"
 #include "Broadcast.hpp"
+#include "FeeTable.hpp"
 #include "picker.hpp"
+#include "Sweep.hpp"
 #include "Testnet.hpp"
+#include "Text.hpp"
+#include "TxSize.hpp"
 #include "../General.hpp"
 #include "../util/Util.hpp"
 #include <bitcoin/watcher.hpp> // Includes the rest of the stack
 #include <algorithm>
 #include <list>
+#include <mutex>
 #include <unordered_map>
 
 namespace abcd {
@@ -57,10 +62,13 @@ namespace abcd {
 
 struct PendingSweep
 {
-    bc::payment_address address;
-    abcd::wif_key key;
+    abcd::key_table keys;
     bool done;
 
+    // Progress so far:
+    abcd::SweepProgress progress;
+
+    tABC_Sweep_Progress_Callback fProgress;
     tABC_Sweep_Done_Callback fCallback;
     void *pData;
 };
@@ -71,6 +79,11 @@ struct WatcherInfo
     std::set<std::string> addresses;
     std::list<PendingSweep> sweeping;
 
+    // Spendable outputs, cached until the next wallet activity:
+    std::mutex utxoMutex;
+    bool utxosValid = false;
+    bc::output_info_list utxos;
+
     // Callback:
     tABC_BitCoin_Event_Callback fAsyncCallback;
     void *pData;
@@ -83,21 +96,27 @@ static std::map<WalletUUID, WatcherInfo*> watchers_;
 // The last obelisk server we connected to:
 static unsigned gLastObelisk = 0;
 
+static tABC_CC     ABC_BridgeSweepStart(tABC_WalletID self, PendingSweep& sweep, tABC_Error *pError);
 static tABC_CC     ABC_BridgeDoSweep(WatcherInfo *watcherInfo, PendingSweep& sweep, tABC_Error *pError);
+static void        ABC_BridgeSweepProgress(WatcherInfo *watcherInfo, const libbitcoin::transaction_type& tx);
 static void        ABC_BridgeQuietCallback(WatcherInfo *watcherInfo);
 static void        ABC_BridgeTxCallback(WatcherInfo *watcherInfo, const libbitcoin::transaction_type& tx, tABC_BitCoin_Event_Callback fAsyncBitCoinEventCallback, void *pData);
 static tABC_CC     ABC_BridgeExtractOutputs(abcd::watcher *watcher, abcd::unsigned_transaction_type *utx, std::string malleableId, tABC_UnsignedTx *pUtx, tABC_Error *pError);
+static tABC_CC     ABC_BridgeTxMakeWithInfo(tABC_TxSendInfo *pSendInfo, char **addresses, int addressCount, char *changeAddress, tABC_GeneralInfo *ppInfo, tABC_UnsignedTx *pUtx, tABC_Error *pError);
+static tABC_CC     ABC_BridgeTxMakeWithInfo(tABC_TxSendInfo *pSendInfo, char **addresses, int addressCount, char *changeAddress, tABC_GeneralInfo *ppInfo, const abcd::FeeTable &fees, tABC_UnsignedTx *pUtx, tABC_Error *pError);
 static tABC_CC     ABC_BridgeTxErrorHandler(abcd::unsigned_transaction_type *utx, tABC_Error *pError);
 static void        ABC_BridgeAppendOutput(bc::transaction_output_list& outputs, uint64_t amount, const bc::payment_address &addr);
 static bc::script_type ABC_BridgeCreateScriptHash(const bc::short_hash &script_hash);
 static bc::script_type ABC_BridgeCreatePubKeyHash(const bc::short_hash &pubkey_hash);
 static uint64_t    ABC_BridgeCalcAbFees(uint64_t amount, tABC_GeneralInfo *pInfo);
-static uint64_t    ABC_BridgeCalcMinerFees(size_t tx_size, tABC_GeneralInfo *pInfo, uint64_t amountSatoshi);
+static std::function<uint64_t (size_t)> ABC_BridgeMinerFees(const abcd::FeeTable &fees, uint64_t amountSatoshi);
 static std::string ABC_BridgeWatcherFile(const char *szWalletUUID);
 static tABC_CC     ABC_BridgeWatcherLoad(WatcherInfo *watcherInfo, tABC_Error *pError);
 static void        ABC_BridgeWatcherSerializeAsync(WatcherInfo *watcherInfo);
 static void        *ABC_BridgeWatcherSerialize(void *pData);
 static std::string ABC_BridgeNonMalleableTxId(bc::transaction_type tx);
+static bc::output_info_list ABC_BridgeGetUtxos(WatcherInfo *watcherInfo);
+static void        ABC_BridgeUtxosDirty(WatcherInfo *watcherInfo);
 
 tABC_CC ABC_BridgeSweepKey(tABC_WalletID self,
                            tABC_U08Buf key,
@@ -110,13 +129,8 @@ tABC_CC ABC_BridgeSweepKey(tABC_WalletID self,
     bc::ec_secret ec_key;
     bc::ec_point ec_addr;
     bc::payment_address address;
-    WatcherInfo *watcherInfo = NULL;
     PendingSweep sweep;
 
-    auto row = watchers_.find(self.szUUID);
-    ABC_CHECK_ASSERT(row != watchers_.end(), ABC_CC_Error, "Unable find watcher");
-    watcherInfo = row->second;
-
     // Decode key and address:
     ABC_CHECK_ASSERT(ABC_BUF_SIZE(key) == ec_key.size(),
         ABC_CC_Error, "Bad key size");
@@ -125,13 +139,79 @@ tABC_CC ABC_BridgeSweepKey(tABC_WalletID self,
     address.set(pubkeyVersion(), bc::bitcoin_short_hash(ec_addr));
 
     // Start the sweep:
-    sweep.address = address;
-    sweep.key = abcd::wif_key{ec_key, compressed};
-    sweep.done = false;
+    sweep.keys[address] = abcd::wif_key{ec_key, compressed};
+    sweep.fProgress = NULL;
+    sweep.fCallback = fCallback;
+    sweep.pData = pData;
+    ABC_CHECK_RET(ABC_BridgeSweepStart(self, sweep, pError));
+
+exit:
+    return cc;
+}
+
+tABC_CC ABC_BridgeSweepKeys(tABC_WalletID self,
+                            const char **aszKeys,
+                            unsigned int keyCount,
+                            tABC_Sweep_Progress_Callback fProgress,
+                            tABC_Sweep_Done_Callback fCallback,
+                            void *pData,
+                            tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    PendingSweep sweep;
+
+    // Decode all the keys before touching the watcher:
+    for (unsigned i = 0; i < keyCount; ++i)
+    {
+        AutoU08Buf key;
+        AutoString szAddress;
+        bool bCompressed;
+        bc::ec_secret ec_key;
+        bc::payment_address address;
+
+        ABC_CHECK_RET(ABC_BridgeDecodeWIF(aszKeys[i],
+            &key, &bCompressed, &szAddress.get(), pError));
+        std::copy(key.p, key.end, ec_key.data());
+        address.set_encoded(szAddress.get());
+        sweep.keys[address] = abcd::wif_key{ec_key, bCompressed};
+    }
+    ABC_CHECK_ASSERT(sweep.keys.size(), ABC_CC_Error, "No keys to sweep");
+
+    sweep.fProgress = fProgress;
     sweep.fCallback = fCallback;
     sweep.pData = pData;
+    ABC_CHECK_RET(ABC_BridgeSweepStart(self, sweep, pError));
+
+exit:
+    return cc;
+}
+
+/**
+ * Queues a sweep and starts watching all its addresses at once.
+ * The sweep happens once the watcher goes quiet.
+ */
+static
+tABC_CC ABC_BridgeSweepStart(tABC_WalletID self,
+                             PendingSweep& sweep,
+                             tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    WatcherInfo *watcherInfo = NULL;
+
+    auto row = watchers_.find(self.szUUID);
+    ABC_CHECK_ASSERT(row != watchers_.end(), ABC_CC_Error, "Unable find watcher");
+    watcherInfo = row->second;
+
+    sweep.done = false;
+    {
+        std::vector<std::string> addresses;
+        for (const auto& key: sweep.keys)
+            addresses.push_back(key.first.encoded());
+        sweep.progress = abcd::SweepProgress(addresses);
+    }
     watcherInfo->sweeping.push_back(sweep);
-    watcherInfo->watcher->watch_address(address);
+    for (const auto& key: sweep.keys)
+        watcherInfo->watcher->watch_address(key.first);
 
 exit:
     return cc;
@@ -194,6 +274,7 @@ tABC_CC ABC_BridgeWatcherLoop(const char *szWalletUUID,
     heightCallback = [watcherInfo, fAsyncCallback, pData](const size_t height)
     {
         tABC_Error error;
+        ABC_BridgeUtxosDirty(watcherInfo);
         ABC_TxBlockHeightUpdate(height, fAsyncCallback, pData, &error);
         ABC_BridgeWatcherSerializeAsync(watcherInfo);
     };
@@ -395,9 +476,51 @@ tABC_CC ABC_BridgeTxMake(tABC_TxSendInfo *pSendInfo,
 {
     tABC_CC cc = ABC_CC_Ok;
     tABC_GeneralInfo *ppInfo = NULL;
+
+    // Update general info before send
+    ABC_CHECK_RET(ABC_GeneralUpdateInfo(pError));
+    // Fetch Info to calculate fees
+    ABC_CHECK_RET(ABC_GeneralGetInfo(&ppInfo, pError));
+    ABC_CHECK_RET(ABC_BridgeTxMakeWithInfo(pSendInfo,
+        addresses, addressCount, changeAddress, ppInfo, pUtx, pError));
+
+exit:
+    ABC_GeneralFreeInfo(ppInfo);
+    return cc;
+}
+
+/**
+ * Builds an unsigned transaction using general info the caller has
+ * already fetched, so repeated previews don't reload it each time.
+ */
+tABC_CC ABC_BridgeTxMakeWithInfo(tABC_TxSendInfo *pSendInfo,
+                                 char **addresses, int addressCount,
+                                 char *changeAddress,
+                                 tABC_GeneralInfo *ppInfo,
+                                 tABC_UnsignedTx *pUtx,
+                                 tABC_Error *pError)
+{
+    return ABC_BridgeTxMakeWithInfo(pSendInfo,
+        addresses, addressCount, changeAddress,
+        ppInfo, abcd::FeeTable(ppInfo), pUtx, pError);
+}
+
+/**
+ * Builds an unsigned transaction using a fee table the caller has
+ * already built from the general info, for callers that make many previews.
+ */
+tABC_CC ABC_BridgeTxMakeWithInfo(tABC_TxSendInfo *pSendInfo,
+                                 char **addresses, int addressCount,
+                                 char *changeAddress,
+                                 tABC_GeneralInfo *ppInfo,
+                                 const abcd::FeeTable &fees,
+                                 tABC_UnsignedTx *pUtx,
+                                 tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
     bc::payment_address change, ab, dest;
     abcd::fee_schedule schedule;
-    abcd::unsigned_transaction_type *utx;
+    abcd::unsigned_transaction_type *utx = NULL;
     bc::transaction_output_list outputs;
     uint64_t totalAmountSatoshi = 0, abFees = 0, minerFees = 0;
     std::vector<bc::payment_address> addresses_;
@@ -412,10 +535,6 @@ tABC_CC ABC_BridgeTxMake(tABC_TxSendInfo *pSendInfo,
     ABC_CHECK_ASSERT(utx != NULL,
         ABC_CC_NULLPtr, "Unable alloc unsigned_transaction_type");
 
-    // Update general info before send
-    ABC_CHECK_RET(ABC_GeneralUpdateInfo(pError));
-    // Fetch Info to calculate fees
-    ABC_CHECK_RET(ABC_GeneralGetInfo(&ppInfo, pError));
     // Create payment_addresses
     ABC_CHECK_ASSERT(addressCount > 0,
         ABC_CC_Error, "No addresses supplied");
@@ -433,7 +552,8 @@ tABC_CC ABC_BridgeTxMake(tABC_TxSendInfo *pSendInfo,
     ABC_CHECK_ASSERT(true == ab.set_encoded(ppInfo->pAirBitzFee->szAddresss),
         ABC_CC_Error, "Bad ABV address");
 
-    schedule.satoshi_per_kb = ppInfo->countMinersFees;
+    schedule.size_fee =
+        ABC_BridgeMinerFees(fees, pSendInfo->pDetails->amountSatoshi);
     totalAmountSatoshi = pSendInfo->pDetails->amountSatoshi;
 
     if (!pSendInfo->bTransfer)
@@ -454,13 +574,15 @@ tABC_CC ABC_BridgeTxMake(tABC_TxSendInfo *pSendInfo,
     // Output to  Destination Address
     ABC_BridgeAppendOutput(outputs, pSendInfo->pDetails->amountSatoshi, dest);
 
-    minerFees = ABC_BridgeCalcMinerFees(bc::satoshi_raw_size(utx->tx), ppInfo, pSendInfo->pDetails->amountSatoshi);
-    if (minerFees > 0)
+    // The coin selector prices the miner fees for each set of inputs:
+    if (!abcd::make_tx(ABC_BridgeGetUtxos(row->second), change,
+                       schedule, outputs, *utx))
     {
-        // If there are miner fees, increase totalSatoshi
-        pSendInfo->pDetails->amountFeesMinersSatoshi = minerFees;
-        totalAmountSatoshi += minerFees;
+        ABC_CHECK_RET(ABC_BridgeTxErrorHandler(utx, pError));
     }
+    minerFees = utx->fees;
+    totalAmountSatoshi += minerFees;
+
     // Set the fees in the send details
     pSendInfo->pDetails->amountFeesAirbitzSatoshi = abFees;
     pSendInfo->pDetails->amountFeesMinersSatoshi = minerFees;
@@ -468,15 +590,11 @@ tABC_CC ABC_BridgeTxMake(tABC_TxSendInfo *pSendInfo,
                     change.encoded().c_str(),
                     pSendInfo->pDetails->amountSatoshi,
                     totalAmountSatoshi);
-    if (!abcd::make_tx(*(row->second->watcher), addresses_, change,
-                            totalAmountSatoshi, schedule, outputs, *utx))
-    {
-        ABC_CHECK_RET(ABC_BridgeTxErrorHandler(utx, pError));
-    }
 
     pUtx->data = (void *) utx;
+    utx = NULL;
 exit:
-    ABC_GeneralFreeInfo(ppInfo);
+    delete utx;
     return cc;
 }
 
@@ -519,6 +637,7 @@ tABC_CC ABC_BridgeTxSignSend(tABC_TxSendInfo *pSendInfo,
 
     // This will mark the outputs as spent
     watcherInfo->watcher->send_tx(utx->tx);
+    ABC_BridgeUtxosDirty(watcherInfo);
 
     txid = ABC_BridgeNonMalleableTxId(utx->tx);
     ABC_STRDUP(pUtx->szTxId, txid.c_str());
@@ -559,19 +678,20 @@ tABC_CC ABC_BridgeMaxSpendable(tABC_WalletID self,
     ABC_STRDUP(SendInfo.szDestAddress, szDestAddress);
 
     // Snag the latest general info
+    ABC_CHECK_RET(ABC_GeneralUpdateInfo(pError));
     ABC_CHECK_RET(ABC_GeneralGetInfo(&ppInfo, pError));
     // Fetch all the payment addresses for this wallet
     ABC_CHECK_RET(
         ABC_TxGetPubAddresses(self, &addresses.data, &addresses.size, pError));
     if (addresses.size > 0)
     {
-        // This is needed to pass to the ABC_BridgeTxMake
+        // This is needed to pass to the ABC_BridgeTxMakeWithInfo
         // It should never be used
         changeAddr = addresses.data[0];
 
         // Calculate total of utxos for these addresses
         ABC_DebugLog("Get UTOXs for %d\n", addresses.size);
-        auto utxos = row->second->watcher->get_utxos(true);
+        auto utxos = ABC_BridgeGetUtxos(row->second);
         for (const auto& utxo: utxos)
         {
             total += utxo.value;
@@ -579,27 +699,49 @@ tABC_CC ABC_BridgeMaxSpendable(tABC_WalletID self,
         if (!bTransfer)
         {
             // Subtract ab tx fee
-            total -= ABC_BridgeCalcAbFees(total, ppInfo);
+            total -= std::min(total, ABC_BridgeCalcAbFees(total, ppInfo));
         }
-        // Subtract minimum tx fee
-        total -= ABC_BridgeCalcMinerFees(0, ppInfo, total);
+        // Every probe below shares one fee table:
+        abcd::FeeTable fees(ppInfo);
+
+        // Subtract the fee for spending everything:
+        total -= std::min(total, fees.minerFee(
+            abcd::p2pkhTxSize(utxos.size(), 2, 2 * abcd::p2pkhOutputSize),
+            total));
 
         SendInfo.pDetails = &Details;
         SendInfo.bTransfer = bTransfer;
-        Details.amountSatoshi = total;
 
-        // Ewwwwww, fix this to have minimal iterations
-        txResp = ABC_BridgeTxMake(&SendInfo,
-                                  addresses.data, addresses.size,
-                                  changeAddr, &utx, pError);
-        while (txResp == ABC_CC_InsufficientFunds && Details.amountSatoshi > 0)
+        // The estimate is usually right, but the fees depend on which
+        // inputs get picked, so binary search for the real maximum.
+        // The utxo cache keeps each of these previews cheap.
+        uint64_t good = 0;
+        uint64_t bad = total + 1;
+        bool first = true;
+        while (good + 1 < bad)
         {
-            Details.amountSatoshi -= 1;
-            txResp = ABC_BridgeTxMake(&SendInfo,
-                                      addresses.data, addresses.size,
-                                      changeAddr, &utx, pError);
+            // A probe that runs short is expected, so keep its error
+            // out of the caller's until something really fails:
+            tABC_Error probeError = tABC_Error();
+            Details.amountSatoshi = first ? total : good + (bad - good) / 2;
+            first = false;
+            utx.data = NULL;
+            txResp = ABC_BridgeTxMakeWithInfo(&SendInfo,
+                                              addresses.data, addresses.size,
+                                              changeAddr, ppInfo, fees, &utx, &probeError);
+            delete (abcd::unsigned_transaction_type *) utx.data;
+            if (txResp == ABC_CC_Ok)
+                good = Details.amountSatoshi;
+            else if (txResp == ABC_CC_InsufficientFunds)
+                bad = Details.amountSatoshi;
+            else
+            {
+                if (pError)
+                    *pError = probeError;
+                ABC_CHECK_RET(txResp);
+            }
         }
-        *pMaxSatoshi = AB_MAX(Details.amountSatoshi, 0);
+        *pMaxSatoshi = good;
     }
     else
     {
@@ -831,6 +973,10 @@ exit:
     return cc;
 }
 
+/**
+ * Sends the funds held by all of a sweep's keys to the wallet
+ * in a single transaction.
+ */
 static
 tABC_CC ABC_BridgeDoSweep(WatcherInfo *watcherInfo,
                           PendingSweep& sweep,
@@ -839,21 +985,41 @@ tABC_CC ABC_BridgeDoSweep(WatcherInfo *watcherInfo,
     tABC_CC cc = ABC_CC_Ok;
     char *szID = NULL;
     char *szAddress = NULL;
+    tABC_GeneralInfo *pInfo = NULL;
     bc::payment_address to_address;
     uint64_t funds = 0;
+    uint64_t fee = 0;
+    std::vector<bool> compressed;
+    bool history = false;
     abcd::unsigned_transaction utx;
     bc::transaction_output_type output;
-    abcd::key_table keys;
     std::string malTxId, txId;
+    tABC_TxDetails details;
 
-    // Find utxos for this address:
-    auto utxos = watcherInfo->watcher->get_utxos(sweep.address);
+    // Spend every utxo belonging to these keys:
+    utx.tx.version = 1;
+    utx.tx.locktime = 0;
+    for (const auto& key: sweep.keys)
+    {
+        auto utxos = watcherInfo->watcher->get_utxos(key.first);
+        for (auto &utxo: utxos)
+        {
+            bc::transaction_input_type input;
+            input.sequence = 0xffffffff;
+            input.previous_output = utxo.point;
+            funds += utxo.value;
+            compressed.push_back(key.second.compressed);
+            utx.tx.inputs.push_back(input);
+        }
+        if (watcherInfo->watcher->db().has_history(key.first))
+            history = true;
+    }
 
     // Bail out if there are no funds to sweep:
-    if (!utxos.size())
+    if (!utx.tx.inputs.size())
     {
         // Tell the GUI if there were funds in the past:
-        if (watcherInfo->watcher->db().has_history(sweep.address))
+        if (history)
         {
             if (sweep.fCallback)
             {
@@ -875,13 +1041,18 @@ tABC_CC ABC_BridgeDoSweep(WatcherInfo *watcherInfo,
         return ABC_CC_Ok;
     }
 
+    // Price the transaction from its final size:
+    ABC_CHECK_RET(ABC_GeneralGetInfo(&pInfo, pError));
+    fee = abcd::FeeTable(pInfo).minerFee(abcd::sweepTxSize(compressed), funds);
+    ABC_CHECK_ASSERT(abcd::sweepOutput(funds, fee),
+        ABC_CC_InsufficientFunds, "Not enough funds");
+
     // There are some utxos, so send them to ourselves:
-    tABC_TxDetails details;
     memset(&details, 0, sizeof(tABC_TxDetails));
     details.amountSatoshi = 0;
     details.amountCurrency = 0;
     details.amountFeesAirbitzSatoshi = 0;
-    details.amountFeesMinersSatoshi = 0;
+    details.amountFeesMinersSatoshi = fee;
     details.szName = const_cast<char*>("");
     details.szCategory = const_cast<char*>("");
     details.szNotes = const_cast<char*>("");
@@ -895,26 +1066,14 @@ tABC_CC ABC_BridgeDoSweep(WatcherInfo *watcherInfo,
     to_address.set_encoded(szAddress);
 
     // Build a transaction:
-    utx.tx.version = 1;
-    utx.tx.locktime = 0;
-    for (auto &utxo : utxos)
-    {
-        bc::transaction_input_type input;
-        input.sequence = 0xffffffff;
-        input.previous_output = utxo.point;
-        funds += utxo.value;
-        utx.tx.inputs.push_back(input);
-    }
-    ABC_CHECK_ASSERT(10500 <= funds, ABC_CC_InsufficientFunds, "Not enough funds");
-    funds -= 10000;
+    funds -= fee;
     output.value = funds;
     output.script = abcd::build_pubkey_hash_script(to_address.hash());
     utx.tx.outputs.push_back(output);
 
     // Now sign that:
-    keys[sweep.address] = sweep.key;
     ABC_CHECK_SYS(abcd::gather_challenges(utx, *watcherInfo->watcher), "gather_challenges");
-    ABC_CHECK_SYS(abcd::sign_tx(utx, keys), "sign_tx");
+    ABC_CHECK_SYS(abcd::sign_tx(utx, sweep.keys), "sign_tx");
 
     // Send:
     {
@@ -948,14 +1107,61 @@ tABC_CC ABC_BridgeDoSweep(WatcherInfo *watcherInfo,
     }
     sweep.done = true;
     watcherInfo->watcher->send_tx(utx.tx);
+    ABC_BridgeUtxosDirty(watcherInfo);
 
 exit:
     ABC_FREE_STR(szID);
     ABC_FREE_STR(szAddress);
+    ABC_GeneralFreeInfo(pInfo);
 
     return cc;
 }
 
+/**
+ * Tells the sweep callers how many of their keys have resolved,
+ * using just the transaction the watcher reported.
+ */
+static
+void ABC_BridgeSweepProgress(WatcherInfo *watcherInfo,
+                             const libbitcoin::transaction_type& tx)
+{
+    bc::hash_digest txHash = bc::hash_transaction(tx);
+
+    for (auto& sweep: watcherInfo->sweeping)
+    {
+        if (sweep.done || !sweep.fProgress)
+            continue;
+
+        unsigned resolved = sweep.progress.resolved();
+        uint64_t funds = sweep.progress.funds();
+        for (const auto& input: tx.inputs)
+        {
+            bc::payment_address addr;
+            if (!bc::extract(addr, input.script))
+                continue;
+            sweep.progress.spend(addr.encoded(),
+                bc::encode_hex(input.previous_output.hash) + ":" +
+                std::to_string(input.previous_output.index));
+        }
+        for (uint32_t i = 0; i < tx.outputs.size(); ++i)
+        {
+            bc::payment_address addr;
+            if (!bc::extract(addr, tx.outputs[i].script))
+                continue;
+            sweep.progress.receive(addr.encoded(),
+                bc::encode_hex(txHash) + ":" + std::to_string(i),
+                tx.outputs[i].value);
+        }
+
+        if (resolved != sweep.progress.resolved() ||
+            funds != sweep.progress.funds())
+        {
+            sweep.fProgress(sweep.progress.resolved(),
+                sweep.progress.total(), sweep.progress.funds());
+        }
+    }
+}
+
 static
 void ABC_BridgeQuietCallback(WatcherInfo *watcherInfo)
 {
@@ -965,6 +1171,15 @@ void ABC_BridgeQuietCallback(WatcherInfo *watcherInfo)
         tABC_CC cc;
         tABC_Error error;
 
+        // Every history has arrived, so even the empty keys are resolved:
+        if (!sweep.done && sweep.fProgress &&
+            sweep.progress.resolved() < sweep.progress.total())
+        {
+            sweep.progress.resolveAll();
+            sweep.fProgress(sweep.progress.resolved(),
+                sweep.progress.total(), sweep.progress.funds());
+        }
+
         cc = ABC_BridgeDoSweep(watcherInfo, sweep, &error);
         if (cc != ABC_CC_Ok)
         {
@@ -998,6 +1213,8 @@ void ABC_BridgeTxCallback(WatcherInfo *watcherInfo, const libbitcoin::transactio
         cc = ABC_CC_Error;
         goto exit;
     }
+    ABC_BridgeUtxosDirty(watcherInfo);
+    ABC_BridgeSweepProgress(watcherInfo, tx);
 
     txId = ABC_BridgeNonMalleableTxId(tx);
     malTxId = bc::encode_hex(bc::hash_transaction(tx));
@@ -1203,35 +1420,17 @@ uint64_t ABC_BridgeCalcAbFees(uint64_t amount, tABC_GeneralInfo *pInfo)
 #endif
 }
 
+/**
+ * Builds a fee schedule from a fee table, so each quote is a lookup.
+ * The table must outlive the schedule.
+ */
 static
-uint64_t ABC_BridgeCalcMinerFees(size_t tx_size, tABC_GeneralInfo *pInfo, uint64_t amountSatoshi)
+std::function<uint64_t (size_t)> ABC_BridgeMinerFees(const abcd::FeeTable &fees, uint64_t amountSatoshi)
 {
-    // Look up the size-based fees from the table:
-    uint64_t sizeFee = 0;
-    if (pInfo->countMinersFees > 0)
+    return [&fees, amountSatoshi](size_t tx_size)
     {
-        for (unsigned i = 0; i < pInfo->countMinersFees; ++i)
-        {
-            if (tx_size <= pInfo->aMinersFees[i]->sizeTransaction)
-            {
-                sizeFee = pInfo->aMinersFees[i]->amountSatoshi;
-                break;
-            }
-        }
-    }
-    if (!sizeFee)
-        return 0;
-
-    // The amount-based fee is 0.1% of total funds sent:
-    uint64_t amountFee = amountSatoshi / 1000;
-
-    // Clamp the amount fee between 10% and 100% of the size-based fee:
-    uint64_t minFee = sizeFee / 10;
-    amountFee = std::max(amountFee, minFee);
-    amountFee = std::min(amountFee, sizeFee);
-
-    // Make the result an integer multiple of the minimum fee:
-    return amountFee - amountFee % minFee;
+        return fees.minerFee(tx_size, amountSatoshi);
+    };
 }
 
 static
@@ -1321,6 +1520,32 @@ static std::string ABC_BridgeNonMalleableTxId(bc::transaction_type tx)
     return bc::encode_hex(bc::hash_transaction(tx, bc::sighash::all));
 }
 
+/**
+ * Returns the wallet's spendable outputs,
+ * only querying the watcher database if something has changed.
+ */
+static bc::output_info_list
+ABC_BridgeGetUtxos(WatcherInfo *watcherInfo)
+{
+    std::lock_guard<std::mutex> lock(watcherInfo->utxoMutex);
+    if (!watcherInfo->utxosValid)
+    {
+        watcherInfo->utxos = watcherInfo->watcher->get_utxos(true);
+        watcherInfo->utxosValid = true;
+    }
+    return watcherInfo->utxos;
+}
+
+/**
+ * Throws away the cached outputs after wallet activity.
+ */
+static void
+ABC_BridgeUtxosDirty(WatcherInfo *watcherInfo)
+{
+    std::lock_guard<std::mutex> lock(watcherInfo->utxoMutex);
+    watcherInfo->utxosValid = false;
+}
+
 Status
 watcherBridgeRawTx(const char *szWalletUUID, const char *szTxID,
     DataChunk &result)
@@ -54,6 +54,14 @@ tABC_CC ABC_BridgeSweepKey(tABC_WalletID self,
                            void *pData,
                            tABC_Error *pError);
 
+tABC_CC ABC_BridgeSweepKeys(tABC_WalletID self,
+                            const char **aszKeys,
+                            unsigned int keyCount,
+                            tABC_Sweep_Progress_Callback fProgress,
+                            tABC_Sweep_Done_Callback fCallback,
+                            void *pData,
+                            tABC_Error *pError);
+
 tABC_CC ABC_BridgeWatcherStart(tABC_WalletID self,
                                tABC_Error *pError);
 
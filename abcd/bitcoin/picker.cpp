@@ -6,6 +6,10 @@
  */
 
 #include "picker.hpp"
+#include "CoinSelection.hpp"
+#include "TxSize.hpp"
+#include "../util/Parallel.hpp"
+#include <string.h>
 #include <unistd.h>
 #include <iostream>
 #include <bitcoin/bitcoin.hpp>
@@ -21,48 +25,153 @@ constexpr unsigned min_output = 5430;
 static std::map<data_chunk, std::string> address_map;
 static operation create_data_operation(data_chunk& data);
 
+/**
+ * Generous timeouts for the changeless coin search.
+ * These keep a huge wallet from stalling a spend preview.
+ */
+constexpr auto coin_search_budget = std::chrono::milliseconds(50);
+constexpr size_t coin_search_tries = 100000;
+
+/**
+ * The work needed to sign one input.
+ * Jobs only read the transaction, so they can run in any order.
+ */
+struct sign_job
+{
+    size_t index;
+    const ec_secret* secret;
+    /** Derived from the secret if left empty. */
+    ec_point pubkey;
+    bool compressed = true;
+    script_type challenge;
+
+    /** Empty if the input could not be signed. */
+    data_chunk signature;
+};
+
+/**
+ * Below this many inputs per thread, starting threads costs more
+ * than the signatures do.
+ */
+constexpr size_t sign_inputs_per_thread = 4;
+
+/**
+ * Computes the signatures for a batch of inputs, spreading the work
+ * across all cores. Both the signature hash, which copies the whole
+ * transaction, and the elliptic-curve math grow with the input count,
+ * so consolidation transactions benefit the most.
+ */
+static void run_sign_jobs(const transaction_type& tx,
+    std::vector<sign_job>& jobs)
+{
+    // libsecp256k1 sets itself up on first use, so make sure that
+    // happens here rather than racing in the worker threads:
+    if (jobs.size() && !jobs[0].pubkey.size())
+        jobs[0].pubkey = secret_to_public_key(*jobs[0].secret,
+            jobs[0].compressed);
+
+    parallelFor(jobs.size(), [&](size_t i)
+    {
+        auto& job = jobs[i];
+        hash_digest sighash =
+            script_type::generate_signature_hash(tx, job.index,
+                job.challenge, 1);
+        if (sighash == null_hash)
+            return;
+
+        if (!job.pubkey.size())
+            job.pubkey = secret_to_public_key(*job.secret, job.compressed);
+        job.signature = sign(*job.secret, sighash,
+            create_nonce(*job.secret, sighash));
+        job.signature.push_back(0x01);
+    }, 0, sign_inputs_per_thread);
+}
+
+/**
+ * Writes the finished signatures into their inputs.
+ */
+static void save_sign_jobs(transaction_type& tx, std::vector<sign_job>& jobs)
+{
+    for (auto& job: jobs)
+    {
+        if (!job.signature.size())
+            continue;
+
+        script_type scriptsig;
+        scriptsig.push_operation(create_data_operation(job.signature));
+        scriptsig.push_operation(create_data_operation(job.pubkey));
+        tx.inputs[job.index].script = scriptsig;
+    }
+}
+
 BC_API bool make_tx(
-             watcher& watcher,
-             const std::vector<payment_address>& addresses,
+             const output_info_list& unspent,
              const payment_address& changeAddr,
-             int64_t amountSatoshi,
              fee_schedule& sched,
              transaction_output_list& outputs,
              unsigned_transaction_type& utx)
 {
     utx.code = ok;
+    utx.fees = 0;
     utx.tx.version = 1;
     utx.tx.locktime = 0;
+    utx.tx.inputs.clear();
     utx.tx.outputs = outputs;
 
-    // Gather all the unspent outputs in the wallet:
-    auto unspent = watcher.get_utxos(true);
+    uint64_t target = 0;
+    for (auto &output: outputs)
+        target += output.value;
+
+    // Price each candidate input set by its size once signed.
+    // Our wallets only hold compressed pay-to-pubkey-hash outputs:
+    transaction_output_type change;
+    change.value = 0;
+    change.script = build_pubkey_hash_script(changeAddr.hash());
+    const size_t output_bytes = satoshi_raw_size(utx.tx) -
+        txOverheadSize(0, outputs.size());
+
+    CoinSelectionParams params;
+    params.target = target;
+    params.fee = [&](size_t inputs, bool with_change)
+    {
+        if (with_change)
+            return sched.size_fee(p2pkhTxSize(inputs, outputs.size() + 1,
+                output_bytes + p2pkhOutputSize));
+        return sched.size_fee(p2pkhTxSize(inputs, outputs.size(),
+            output_bytes));
+    };
+    params.minChange = min_output;
+    params.budget = coin_search_budget;
+    params.maxTries = coin_search_tries;
 
     // Select a collection of outputs that satisfies our requirements:
-    select_outputs_result utxos = select_outputs(unspent, amountSatoshi);
-    if (utxos.points.size() <= 0)
+    std::vector<uint64_t> values;
+    values.reserve(unspent.size());
+    for (auto &utxo: unspent)
+        values.push_back(utxo.value);
+    CoinSelection selection;
+    if (!coinSelect(selection, values, params))
     {
         utx.code = insufficent_funds;
         return false;
     }
 
     // Build the transaction's input list:
-    for (auto &point : utxos.points)
+    for (auto i: selection.inputs)
     {
         transaction_input_type input;
         input.sequence = 4294967295;
-        input.previous_output = point;
+        input.previous_output = unspent[i].point;
         utx.tx.inputs.push_back(input);
     }
 
     // If change is needed, add that to the output list:
-    if (utxos.change > 0)
+    if (selection.change > 0)
     {
-        transaction_output_type change;
-        change.value = utxos.change;
-        change.script = build_pubkey_hash_script(changeAddr.hash());
+        change.value = selection.change;
         utx.tx.outputs.push_back(change);
     }
+    utx.fees = selection.fee;
 
     // Remove any dust outputs, returning those funds to the miners:
     auto last = std::remove_if(utx.tx.outputs.begin(), utx.tx.outputs.end(),
@@ -79,10 +188,47 @@ BC_API bool make_tx(
     return true;
 }
 
+/**
+ * Hashes a short_hash by its leading bytes, which are already uniform.
+ */
+struct short_hash_hasher
+{
+    size_t operator()(const short_hash& hash) const
+    {
+        size_t out;
+        memcpy(&out, hash.data(), sizeof(out));
+        return out;
+    }
+};
+
+/**
+ * A raw private key and its compressed public key.
+ */
+struct legacy_key
+{
+    ec_secret secret;
+    ec_point pubkey;
+};
+
 BC_API bool sign_tx(unsigned_transaction_type& utx, std::vector<std::string>& keys, watcher& watcher)
 {
     utx.code = ok;
 
+    // Derive each key's address once, up front:
+    std::unordered_map<short_hash, legacy_key, short_hash_hasher> table;
+    table.reserve(keys.size());
+    for (const auto& k: keys)
+    {
+        legacy_key key;
+        key.secret = bc::decode_hash(k);
+        key.pubkey = bc::secret_to_public_key(key.secret, true);
+
+        payment_address a;
+        set_public_key(a, key.pubkey);
+        table[a.hash()] = key;
+    }
+
+    std::vector<sign_job> jobs(utx.tx.inputs.size());
     for (size_t i = 0; i < utx.tx.inputs.size(); ++i)
     {
         // Find the utxo this input refers to:
@@ -100,23 +246,8 @@ BC_API bool sign_tx(unsigned_transaction_type& utx, std::vector<std::string>& ke
         }
 
         // Find the elliptic curve key for this input:
-        bool found = false;
-        bc::ec_secret secret;
-        bc::ec_point pubkey;
-        for (auto k : keys)
-        {
-            secret = bc::decode_hash(k);
-            pubkey = bc::secret_to_public_key(secret, true);
-
-            payment_address a;
-            set_public_key(a, pubkey);
-            if (a.encoded() == pa.encoded())
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
+        auto key = table.find(pa.hash());
+        if (key == table.end())
         {
             utx.code = invalid_key;
             return false;
@@ -124,26 +255,22 @@ BC_API bool sign_tx(unsigned_transaction_type& utx, std::vector<std::string>& ke
 
         // Gererate the previous output's signature:
         // TODO: We already have this; process it and use it
-        script_type sig_script = build_pubkey_hash_script(pa.hash());
+        jobs[i].index = i;
+        jobs[i].secret = &key->second.secret;
+        jobs[i].pubkey = key->second.pubkey;
+        jobs[i].challenge = build_pubkey_hash_script(pa.hash());
+    }
 
-        // Generate the signature for this input:
-        hash_digest sig_hash =
-            script_type::generate_signature_hash(utx.tx, i, sig_script, 1);
-        if (sig_hash == null_hash)
+    run_sign_jobs(utx.tx, jobs);
+    for (auto& job: jobs)
+    {
+        if (!job.signature.size())
         {
             utx.code = invalid_sig;
             return false;
         }
-        data_chunk signature = sign(secret, sig_hash,
-            create_nonce(secret, sig_hash));
-        signature.push_back(0x01);
-
-        // Create out scriptsig:
-        script_type scriptsig;
-        scriptsig.push_operation(create_data_operation(signature));
-        scriptsig.push_operation(create_data_operation(pubkey));
-        utx.tx.inputs[i].script = scriptsig;
     }
+    save_sign_jobs(utx.tx, jobs);
     return true;
 }
 
@@ -195,6 +322,7 @@ bool sign_tx(unsigned_transaction& utx, const key_table& keys)
 {
     bool all_done = true;
 
+    std::vector<sign_job> jobs;
     for (size_t i = 0; i < utx.tx.inputs.size(); ++i)
     {
         auto& input = utx.tx.inputs[i];
@@ -219,30 +347,21 @@ bool sign_tx(unsigned_transaction& utx, const key_table& keys)
             all_done = false;
             continue;
         }
-        auto& secret = key->second.secret;
-        auto pubkey = bc::secret_to_public_key(secret, key->second.compressed);
 
-        // Create the sighash for this input:
-        hash_digest sighash =
-            script_type::generate_signature_hash(utx.tx, i, challenge, 1);
-        if (sighash == null_hash)
-        {
-            all_done = false;
-            continue;
-        }
-
-        // Sign:
-        data_chunk signature = sign(secret, sighash,
-            create_nonce(secret, sighash));
-        signature.push_back(0x01);
-
-        // Save:
-        script_type scriptsig;
-        scriptsig.push_operation(create_data_operation(signature));
-        scriptsig.push_operation(create_data_operation(pubkey));
-        utx.tx.inputs[i].script = scriptsig;
+        sign_job job;
+        job.index = i;
+        job.secret = &key->second.secret;
+        job.compressed = key->second.compressed;
+        job.challenge = challenge;
+        jobs.push_back(std::move(job));
     }
 
+    run_sign_jobs(utx.tx, jobs);
+    for (auto& job: jobs)
+        if (!job.signature.size())
+            all_done = false;
+    save_sign_jobs(utx.tx, jobs);
+
     return all_done;
 }
 
@@ -26,18 +26,28 @@ struct unsigned_transaction_type
 {
     bc::transaction_type tx;
     int code;
+    uint64_t fees;
 };
 
 struct fee_schedule
 {
-    uint64_t satoshi_per_kb;
+    /**
+     * Returns the miner fee for a transaction of the given size.
+     * The size is what the transaction will be once signed.
+     */
+    std::function<uint64_t (size_t tx_size)> size_fee;
 };
 
+/**
+ * Builds a transaction paying the given outputs.
+ * The inputs come from the coin selector, which prices the fee
+ * separately for each candidate set of inputs,
+ * based on the transaction's size after signing.
+ * The chosen fee ends up in `utx.fees`.
+ */
 BC_API bool make_tx(
-             abcd::watcher& watcher,
-             const std::vector<bc::payment_address>& addresses,
+             const bc::output_info_list& unspent,
              const bc::payment_address& changeAddr,
-             int64_t amountSatoshi,
              fee_schedule& sched,
              bc::transaction_output_list& outputs,
              unsigned_transaction_type& utx);
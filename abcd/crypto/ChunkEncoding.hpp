@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Generic power-of-2 encoders, one character at a time.
+ * Base32 uses these directly, and they are the reference
+ * that the faster base16 and base64 codecs must agree with.
+ */
+
+#ifndef ABCD_CRYPTO_CHUNK_ENCODING_HPP
+#define ABCD_CRYPTO_CHUNK_ENCODING_HPP
+
+#include "../util/Data.hpp"
+#include "../util/Status.hpp"
+#include <algorithm>
+
+namespace abcd {
+
+constexpr char base16Alphabet[] = "0123456789abcdef";
+constexpr char base32Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+constexpr char base64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Encodes data in an arbitrary power-of-2 base.
+ * @param Bytes number of bytes per chunk of characters.
+ * @param Chars number of characters per chunk.
+ */
+template<unsigned Bytes, unsigned Chars> std::string
+chunkEncode(DataSlice data, const char *alphabet)
+{
+    std::string out;
+    auto chunks = (data.size() + Bytes - 1) / Bytes; // Rounding up
+    out.reserve(Chars * chunks);
+
+    constexpr unsigned shift = 8 * Bytes / Chars; // Bits per character
+    uint16_t buffer = 0; // Bits waiting to be written out, MSB first
+    int bits = 0; // Number of bits currently in the buffer
+    auto i = data.begin();
+    while (i != data.end() || 0 < bits)
+    {
+        // Reload the buffer if we need more bits:
+        if (i != data.end() && bits < shift)
+        {
+            buffer |= *i++ << (8 - bits);
+            bits += 8;
+        }
+
+        // Write out the most-significant bits in the buffer:
+        out += alphabet[buffer >> (16 - shift)];
+        buffer <<= shift;
+        bits -= shift;
+    }
+
+    // Pad the final string to a multiple of the chunk size:
+    out.append(-out.size() % Chars, '=');
+    return out;
+}
+
+/**
+ * Decodes data from an arbitrary power-of-2 base.
+ * @param Bytes number of bytes per chunk of characters.
+ * @param Chars number of characters per chunk.
+ * @param Decode function for converting characters to their values.
+ * A negative value indicates an invalid character.
+ */
+template<unsigned Bytes, unsigned Chars, int Decode(char c)>
+Status
+chunkDecode(DataChunk &result, const std::string &in)
+{
+    // The string must be a multiple of the chunk size:
+    if (in.size() % Chars)
+        return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+
+    DataChunk out;
+    out.reserve(Bytes * (in.size() / Chars));
+
+    constexpr unsigned shift = 8 * Bytes / Chars; // Bits per character
+    uint16_t buffer = 0; // Bits waiting to be written out, MSB first
+    int bits = 0; // Number of bits currently in the buffer
+    auto i = in.begin();
+    while (i != in.end())
+    {
+        // Read one character from the string:
+        int value = Decode(*i);
+        if (value < 0)
+            break;
+        ++i;
+
+        // Append the bits to the buffer:
+        buffer |= value << (16 - bits - shift);
+        bits += shift;
+
+        // Write out some bits if the buffer has a byte's worth:
+        if (8 <= bits)
+        {
+            out.push_back(buffer >> 8);
+            buffer <<= 8;
+            bits -= 8;
+        }
+    }
+
+    // Any extra characters must be '=':
+    if (!std::all_of(i, in.end(), [](char c){ return '=' == c; }))
+        return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+
+    // There cannot be extra padding:
+    if (Chars <= in.end() - i || shift <= bits)
+        return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+
+    // Any extra bits must be 0 (but rfc4648 decoders can be liberal here):
+//    if (buffer != 0)
+//        return false;
+
+    result = std::move(out);
+    return Status();
+}
+
+inline int
+base16Decode(char c)
+{
+    if ('0' <= c && c <= '9')
+        return c - '0';
+    if ('A' <= c && c <= 'F')
+        return 10 + c - 'A';
+    if ('a' <= c && c <= 'f')
+        return 10 + c - 'a';
+    return -1;
+}
+
+inline int
+base32Decode(char c)
+{
+    if ('A' <= c && c <= 'Z')
+        return c - 'A';
+    if ('2' <= c && c <= '7')
+        return 26 + c - '2';
+    return -1;
+}
+
+inline int
+base64Decode(char c)
+{
+    if ('A' <= c && c <= 'Z')
+        return c - 'A';
+    if ('a' <= c && c <= 'z')
+        return 26 + c - 'a';
+    if ('0' <= c && c <= '9')
+        return 52 + c - '0';
+    if ('+' == c)
+        return 62;
+    if ('/' == c)
+        return 63;
+    return -1;
+}
+
+} // namespace abcd
+
+#endif
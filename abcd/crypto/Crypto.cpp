@@ -33,11 +33,19 @@
 #include "Encoding.hpp"
 #include "Random.hpp"
 #include "../json/JsonFile.hpp"
+#include "../util/Parallel.hpp"
 #include "../util/Util.hpp"
 #include <bitcoin/bitcoin.hpp> // wow! such slow, very compile time
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
 #include <openssl/sha.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 namespace abcd {
 
@@ -58,23 +66,113 @@ tABC_CC ABC_CryptoDecryptAES256Package(const tABC_U08Buf EncData,
                                        tABC_U08Buf       *pData,
                                        tABC_Error        *pError);
 static
-tABC_CC ABC_CryptoEncryptAES256(const tABC_U08Buf Data,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pEncData,
-                                tABC_Error        *pError);
+tABC_CC ABC_CryptoParseJSONObject(const json_t *pJSON_Enc,
+                                  DataChunk &data,
+                                  DataChunk &iv,
+                                  tABC_Error *pError);
 static
-tABC_CC ABC_CryptoDecryptAES256(const tABC_U08Buf EncData,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pData,
-                                tABC_Error        *pError);
+tABC_CC ABC_CryptoDecryptAES256Buffer(const tABC_U08Buf EncData,
+                                      const tABC_U08Buf Key,
+                                      const tABC_U08Buf IV,
+                                      unsigned char     *pBuffer,
+                                      size_t            *pOffset,
+                                      size_t            *pSize,
+                                      tABC_Error        *pError);
+
+/**
+ * Files per worker thread below which a batch decrypt stays serial.
+ * A typical transaction file takes tens of microseconds,
+ * so smaller batches finish before a thread would start.
+ */
+constexpr size_t DECRYPT_FILES_PER_THREAD = 64;
+
+/**
+ * Remembered cryptoFilename results for one key,
+ * with the most recently used names at the front.
+ */
+struct FilenameCache
+{
+    typedef std::list<std::pair<std::string, std::string>> List;
+
+    DataChunk key;
+    List entries;
+    std::unordered_map<std::string, List::iterator> index;
+};
+
+constexpr size_t FILENAME_CACHE_KEYS = 4;
+constexpr size_t FILENAME_CACHE_NAMES = 256;
+
+static std::mutex gFilenameMutex;
+static std::list<FilenameCache> gFilenameCaches; // Most recent key first
+
+/**
+ * Finds the cache for a key, moving it to the front.
+ * The caller must hold gFilenameMutex.
+ */
+static FilenameCache &
+filenameCache(DataSlice key)
+{
+    for (auto i = gFilenameCaches.begin(); i != gFilenameCaches.end(); ++i)
+    {
+        if (i->key.size() == key.size() &&
+            !CRYPTO_memcmp(i->key.data(), key.data(), key.size()))
+        {
+            gFilenameCaches.splice(gFilenameCaches.begin(), gFilenameCaches, i);
+            return gFilenameCaches.front();
+        }
+    }
+
+    if (FILENAME_CACHE_KEYS <= gFilenameCaches.size())
+    {
+        auto &old = gFilenameCaches.back().key;
+        OPENSSL_cleanse(old.data(), old.size());
+        gFilenameCaches.pop_back();
+    }
+    gFilenameCaches.emplace_front();
+    gFilenameCaches.front().key = DataChunk(key.begin(), key.end());
+    return gFilenameCaches.front();
+}
 
 std::string
 cryptoFilename(DataSlice key, const std::string &name)
 {
-    return bc::encode_base58(bc::to_data_chunk(
+    {
+        std::lock_guard<std::mutex> lock(gFilenameMutex);
+        auto &cache = filenameCache(key);
+        auto i = cache.index.find(name);
+        if (cache.index.end() != i)
+        {
+            cache.entries.splice(cache.entries.begin(), cache.entries, i->second);
+            return i->second->second;
+        }
+    }
+
+    // Hash outside the lock, since this is the slow part:
+    auto out = bc::encode_base58(bc::to_data_chunk(
         bc::hmac_sha256_hash(DataSlice(name), key)));
+
+    std::lock_guard<std::mutex> lock(gFilenameMutex);
+    auto &cache = filenameCache(key);
+    if (!cache.index.count(name))
+    {
+        cache.entries.emplace_front(name, out);
+        cache.index[name] = cache.entries.begin();
+        if (FILENAME_CACHE_NAMES < cache.entries.size())
+        {
+            cache.index.erase(cache.entries.back().first);
+            cache.entries.pop_back();
+        }
+    }
+    return out;
+}
+
+void
+cryptoFilenameClear()
+{
+    std::lock_guard<std::mutex> lock(gFilenameMutex);
+    for (auto &cache: gFilenameCaches)
+        OPENSSL_cleanse(cache.key.data(), cache.key.size());
+    gFilenameCaches.clear();
 }
 
 /**
@@ -195,13 +293,35 @@ tABC_CC ABC_CryptoDecryptJSONObject(const json_t      *pJSON_Enc,
 
     DataChunk data;
     DataChunk iv;
-    int type;
-    json_t *jsonVal = NULL;
 
     ABC_CHECK_NULL(pJSON_Enc);
     ABC_CHECK_NULL_BUF(Key);
     ABC_CHECK_NULL(pData);
 
+    ABC_CHECK_RET(ABC_CryptoParseJSONObject(pJSON_Enc, data, iv, pError));
+
+    // decrypted the data
+    ABC_CHECK_RET(ABC_CryptoDecryptAES256Package(toU08Buf(data), Key, toU08Buf(iv), pData, pError));
+
+exit:
+    return cc;
+}
+
+/**
+ * Pulls the IV and the encrypted bytes out of a JSON package.
+ */
+static
+tABC_CC ABC_CryptoParseJSONObject(const json_t *pJSON_Enc,
+                                  DataChunk &data,
+                                  DataChunk &iv,
+                                  tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+
+    int type;
+    json_t *jsonVal = NULL;
+
     jsonVal = json_object_get(pJSON_Enc, JSON_ENC_TYPE_FIELD);
     ABC_CHECK_ASSERT((jsonVal && json_is_number(jsonVal)), ABC_CC_DecryptError, "Error parsing JSON encrypt package - missing type");
     type = (int) json_integer_value(jsonVal);
@@ -217,9 +337,6 @@ tABC_CC ABC_CryptoDecryptJSONObject(const json_t      *pJSON_Enc,
     ABC_CHECK_ASSERT((jsonVal && json_is_string(jsonVal)), ABC_CC_DecryptError, "Error parsing JSON encrypt package - missing data");
     ABC_CHECK_NEW(base64Decode(data, json_string_value(jsonVal)), pError);
 
-    // decrypted the data
-    ABC_CHECK_RET(ABC_CryptoDecryptAES256Package(toU08Buf(data), Key, toU08Buf(iv), pData, pError));
-
 exit:
     return cc;
 }
@@ -278,6 +395,241 @@ exit:
     return cc;
 }
 
+/**
+ * Decrypts one file of a batch, reusing the caller's scratch buffer
+ * for the plaintext so only the JSON objects get allocated per file.
+ */
+static
+tABC_CC ABC_CryptoDecryptJSONFileReusing(const char *szFilename,
+                                         const tABC_U08Buf Key,
+                                         DataChunk &buffer,
+                                         json_t **ppJSON_Data,
+                                         tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+
+    JsonFile package;
+    DataChunk data;
+    DataChunk iv;
+    size_t offset = 0;
+    size_t size = 0;
+    json_error_t error;
+
+    ABC_CHECK_NEW(package.load(szFilename), pError);
+    ABC_CHECK_RET(ABC_CryptoParseJSONObject(package.root(), data, iv, pError));
+
+    // the buffer only ever grows, so a batch settles on one allocation
+    if (buffer.size() < data.size() + AES_256_BLOCK_LENGTH)
+        buffer.resize(data.size() + AES_256_BLOCK_LENGTH);
+    ABC_CHECK_RET(ABC_CryptoDecryptAES256Buffer(toU08Buf(data), Key,
+        toU08Buf(iv), buffer.data(), &offset, &size, pError));
+
+    *ppJSON_Data = json_loadb(reinterpret_cast<char *>(buffer.data() + offset),
+        size, 0, &error);
+    ABC_CHECK_ASSERT(*ppJSON_Data, ABC_CC_JSONError, error.text);
+
+exit:
+    // the decrypted bytes never reach past the ciphertext length
+    if (!buffer.empty())
+        OPENSSL_cleanse(buffer.data(), std::min(buffer.size(), data.size()));
+
+    return cc;
+}
+
+/**
+ * Loads and decrypts a batch of files that all share one key.
+ * Each thread sets up its cipher context and plaintext buffer once
+ * and reuses them for every file it handles.
+ *
+ * @param aJSON_Data    array of count slots to receive the json objects
+ *                      (the user is responsible for json_decref'ing them)
+ * @param threads       worker threads to spread the files over,
+ *                      0 to use every core, or 1 to stay on this thread
+ * @param pError        if any file fails, this holds the error for the
+ *                      first failing file in the list, and every slot
+ *                      comes back NULL
+ */
+tABC_CC ABC_CryptoDecryptJSONFiles(const char * const *aszFilenames,
+                                   size_t count,
+                                   const tABC_U08Buf Key,
+                                   json_t **aJSON_Data,
+                                   unsigned threads,
+                                   tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+
+    std::vector<tABC_Error> errors(count);
+    std::vector<tABC_CC> results(count, ABC_CC_Ok);
+    std::mutex poolMutex;
+    std::vector<DataChunk> pool;
+    size_t failed = 0;
+
+    ABC_CHECK_NULL(aszFilenames);
+    ABC_CHECK_NULL_BUF(Key);
+    ABC_CHECK_NULL(aJSON_Data);
+    std::fill(aJSON_Data, aJSON_Data + count, nullptr);
+
+    parallelFor(count, [&](size_t i)
+    {
+        // Borrow a warm plaintext buffer, if a finished file left one:
+        DataChunk buffer;
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if (!pool.empty())
+            {
+                buffer = std::move(pool.back());
+                pool.pop_back();
+            }
+        }
+
+        results[i] = ABC_CryptoDecryptJSONFileReusing(aszFilenames[i], Key,
+            buffer, &aJSON_Data[i], &errors[i]);
+
+        std::lock_guard<std::mutex> lock(poolMutex);
+        pool.push_back(std::move(buffer));
+    }, threads, DECRYPT_FILES_PER_THREAD);
+
+    // report the first failure in list order, no matter which thread hit it
+    while (failed < count && ABC_CC_Ok == results[failed])
+        ++failed;
+    if (failed < count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (aJSON_Data[i])
+                json_decref(aJSON_Data[i]);
+            aJSON_Data[i] = NULL;
+        }
+        if (pError)
+            *pError = errors[failed];
+        cc = results[failed];
+    }
+
+exit:
+    return cc;
+}
+
+/**
+ * The reusable per-thread cipher state.
+ * Setting up a context and expanding the key costs more than
+ * encrypting a typical small file, so each thread holds on to these
+ * and only swaps the IV when the key stays the same.
+ */
+struct CipherCache
+{
+    EVP_CIPHER_CTX *ctx;
+    unsigned char key[AES_256_KEY_LENGTH];
+    int encrypt;
+    bool ready;
+    unsigned generation;
+};
+
+static pthread_key_t gCipherKey;
+static pthread_once_t gCipherOnce = PTHREAD_ONCE_INIT;
+
+// Bumped on logout, so each thread drops its cached key on next use:
+static std::atomic<unsigned> gCipherGeneration(0);
+
+/**
+ * Wipes the key and key schedule out of a thread's cache.
+ */
+static void
+cipherCacheWipe(CipherCache *cache)
+{
+    OPENSSL_cleanse(cache->key, sizeof(cache->key));
+    EVP_CIPHER_CTX_cleanup(cache->ctx);
+    cache->ready = false;
+}
+
+static void
+cipherCacheFree(void *p)
+{
+    auto cache = static_cast<CipherCache *>(p);
+    if (cache->ctx)
+        EVP_CIPHER_CTX_free(cache->ctx);
+    OPENSSL_cleanse(cache, sizeof(CipherCache));
+    free(cache);
+}
+
+static void
+cipherCacheInit()
+{
+    pthread_key_create(&gCipherKey, cipherCacheFree);
+}
+
+/**
+ * Prepares the calling thread's cipher context for AES-256-CBC.
+ * Short keys and IVs are zero-padded, as they always have been.
+ * @param encrypt 1 to encrypt, 0 to decrypt.
+ * @return nullptr if OpenSSL fails.
+ */
+static EVP_CIPHER_CTX *
+cipherContext(const tABC_U08Buf Key, const tABC_U08Buf IV, int encrypt)
+{
+    pthread_once(&gCipherOnce, cipherCacheInit);
+    auto cache = static_cast<CipherCache *>(pthread_getspecific(gCipherKey));
+    if (!cache)
+    {
+        cache = static_cast<CipherCache *>(calloc(1, sizeof(CipherCache)));
+        if (!cache)
+            return nullptr;
+        cache->ctx = EVP_CIPHER_CTX_new();
+        if (!cache->ctx || pthread_setspecific(gCipherKey, cache))
+        {
+            cipherCacheFree(cache);
+            return nullptr;
+        }
+    }
+
+    unsigned generation = gCipherGeneration;
+    if (cache->generation != generation)
+    {
+        if (cache->ready)
+            cipherCacheWipe(cache);
+        cache->generation = generation;
+    }
+
+    unsigned char aKey[AES_256_KEY_LENGTH] = {0};
+    memcpy(aKey, ABC_BUF_PTR(Key),
+        std::min<size_t>(ABC_BUF_SIZE(Key), AES_256_KEY_LENGTH));
+    unsigned char aIV[AES_256_IV_LENGTH] = {0};
+    memcpy(aIV, ABC_BUF_PTR(IV),
+        std::min<size_t>(ABC_BUF_SIZE(IV), AES_256_IV_LENGTH));
+
+    int ok;
+    if (cache->ready && cache->encrypt == encrypt &&
+        !CRYPTO_memcmp(cache->key, aKey, AES_256_KEY_LENGTH))
+    {
+        // Same key schedule, so only the IV changes:
+        ok = EVP_CipherInit_ex(cache->ctx, NULL, NULL, NULL, aIV, encrypt);
+    }
+    else
+    {
+        ok = EVP_CipherInit_ex(cache->ctx, EVP_aes_256_cbc(), NULL,
+            aKey, aIV, encrypt);
+        memcpy(cache->key, aKey, AES_256_KEY_LENGTH);
+        cache->encrypt = encrypt;
+        cache->ready = ok;
+    }
+    OPENSSL_cleanse(aKey, sizeof(aKey));
+
+    return ok ? cache->ctx : nullptr;
+}
+
+void
+cryptoCipherClear()
+{
+    ++gCipherGeneration;
+
+    // The calling thread doesn't have to wait for its next use:
+    pthread_once(&gCipherOnce, cipherCacheInit);
+    auto cache = static_cast<CipherCache *>(pthread_getspecific(gCipherKey));
+    if (cache && cache->ready)
+        cipherCacheWipe(cache);
+}
+
 /**
  * Creates an encrypted aes256 package that includes data, random header/footer and sha256
  * Package format:
@@ -288,6 +640,9 @@ exit:
  *   1 byte:     f (the number of random footer bytes)
  *   f bytes:    f random header bytes
  *   32 bytes:   32 bytes SHA256 of all data up to this point
+ *
+ * The package is built in the same buffer that ends up holding
+ * the encrypted output, with all the random bytes drawn at once.
  */
 static
 tABC_CC ABC_CryptoEncryptAES256Package(const tABC_U08Buf Data,
@@ -299,94 +654,82 @@ tABC_CC ABC_CryptoEncryptAES256Package(const tABC_U08Buf Data,
     tABC_CC cc = ABC_CC_Ok;
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
 
-    DataChunk headerData;
-    DataChunk footerData;
-    AutoU08Buf UnencryptedData;
+    DataChunk random;
+    const unsigned char *pRandom = NULL;
     unsigned char nRandomHeaderBytes;
     unsigned char nRandomFooterBytes;
-    unsigned long totalSizeUnencrypted = 0;
-    unsigned char *pCurUnencryptedData = NULL;
-    unsigned char nSizeByte = 0;
-    unsigned char sha256Output[SHA256_DIGEST_LENGTH];
+    size_t dataSize;
+    size_t totalSizeUnencrypted = 0;
+    unsigned char *pBuffer = NULL;
+    unsigned char *p = NULL;
+    EVP_CIPHER_CTX *ctx = NULL;
+    int c_len = 0;
+    int f_len = 0;
 
     ABC_CHECK_NULL_BUF(Data);
     ABC_CHECK_NULL_BUF(Key);
     ABC_CHECK_NULL(pEncData);
 
-    // create a random IV
-    ABC_CHECK_NEW(randomData(IV, AES_256_IV_LENGTH), pError);
-
-    // create a random number of header bytes 0-255
-    {
-        DataChunk r;
-        ABC_CHECK_NEW(randomData(r, 1), pError);
-        nRandomHeaderBytes = r[0];
-    }
-    //printf("rand header count: %d\n", nRandomHeaderBytes);
-    ABC_CHECK_NEW(randomData(headerData, nRandomHeaderBytes), pError);
-
-    // create a random number of footer bytes 0-255
-    {
-        DataChunk r;
-        ABC_CHECK_NEW(randomData(r, 1), pError);
-        nRandomFooterBytes = r[0];
-    }
-    //printf("rand footer count: %d\n", nRandomFooterBytes);
-    ABC_CHECK_NEW(randomData(footerData, nRandomFooterBytes), pError);
+    // IV, both counts, and the largest possible header and footer:
+    ABC_CHECK_NEW(randomData(random, AES_256_IV_LENGTH + 2 + 255 + 255), pError);
+    pRandom = random.data();
+    IV.assign(pRandom, pRandom + AES_256_IV_LENGTH);
+    pRandom += AES_256_IV_LENGTH;
+    nRandomHeaderBytes = *pRandom++;
+    nRandomFooterBytes = *pRandom++;
 
     // calculate the size of our unencrypted buffer
-    totalSizeUnencrypted += 1; // header count
-    totalSizeUnencrypted += nRandomHeaderBytes; // header
-    totalSizeUnencrypted += 4; // space to hold data size
-    totalSizeUnencrypted += ABC_BUF_SIZE(Data); // data
-    totalSizeUnencrypted += 1; // footer count
-    totalSizeUnencrypted += nRandomFooterBytes; // footer
-    totalSizeUnencrypted += SHA256_DIGEST_LENGTH; // sha256
-    //printf("total size unencrypted: %lu\n", (unsigned long) totalSizeUnencrypted);
-
-    // allocate the unencrypted buffer
-    ABC_BUF_NEW(UnencryptedData, totalSizeUnencrypted);
-    pCurUnencryptedData = ABC_BUF_PTR(UnencryptedData);
+    dataSize = ABC_BUF_SIZE(Data);
+    totalSizeUnencrypted = 1 + nRandomHeaderBytes + 4 + dataSize +
+        1 + nRandomFooterBytes + SHA256_DIGEST_LENGTH;
+
+    // leave room for the padding block, since we encrypt in place
+    ABC_ARRAY_NEW(pBuffer, totalSizeUnencrypted + AES_256_BLOCK_LENGTH, unsigned char);
+    p = pBuffer;
 
     // add the random header count and bytes
-    memcpy(pCurUnencryptedData, &nRandomHeaderBytes, 1);
-    pCurUnencryptedData += 1;
-    memcpy(pCurUnencryptedData, headerData.data(), headerData.size());
-    pCurUnencryptedData += nRandomHeaderBytes;
+    *p++ = nRandomHeaderBytes;
+    memcpy(p, pRandom, nRandomHeaderBytes);
+    p += nRandomHeaderBytes;
+    pRandom += nRandomHeaderBytes;
 
     // add the size of the data
-    nSizeByte = (ABC_BUF_SIZE(Data) >> 24) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
-    nSizeByte = (ABC_BUF_SIZE(Data) >> 16) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
-    nSizeByte = (ABC_BUF_SIZE(Data) >> 8) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
-    nSizeByte = (ABC_BUF_SIZE(Data) >> 0) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
+    *p++ = (dataSize >> 24) & 0xff;
+    *p++ = (dataSize >> 16) & 0xff;
+    *p++ = (dataSize >> 8) & 0xff;
+    *p++ = (dataSize >> 0) & 0xff;
 
     // add the data
-    memcpy(pCurUnencryptedData, ABC_BUF_PTR(Data), ABC_BUF_SIZE(Data));
-    pCurUnencryptedData += ABC_BUF_SIZE(Data);
+    memcpy(p, ABC_BUF_PTR(Data), dataSize);
+    p += dataSize;
 
     // add the random footer count and bytes
-    memcpy(pCurUnencryptedData, &nRandomFooterBytes, 1);
-    pCurUnencryptedData += 1;
-    memcpy(pCurUnencryptedData, footerData.data(), footerData.size());
-    pCurUnencryptedData += nRandomFooterBytes;
+    *p++ = nRandomFooterBytes;
+    memcpy(p, pRandom, nRandomFooterBytes);
+    p += nRandomFooterBytes;
 
     // add the sha256
-    SHA256(ABC_BUF_PTR(UnencryptedData), totalSizeUnencrypted - SHA256_DIGEST_LENGTH, sha256Output);
-    memcpy(pCurUnencryptedData, sha256Output, SHA256_DIGEST_LENGTH);
-    pCurUnencryptedData += SHA256_DIGEST_LENGTH;
+    SHA256(pBuffer, p - pBuffer, p);
 
-    // encrypted our new unencrypted package
-    ABC_CHECK_RET(ABC_CryptoEncryptAES256(UnencryptedData, Key, toU08Buf(IV), pEncData, pError));
+    // encrypt our new unencrypted package
+    ctx = cipherContext(Key, toU08Buf(IV), 1);
+    ABC_CHECK_ASSERT(ctx, ABC_CC_EncryptError, "Cannot set up AES encryption");
+    ABC_CHECK_ASSERT(EVP_EncryptUpdate(ctx, pBuffer, &c_len, pBuffer, totalSizeUnencrypted) &&
+        EVP_EncryptFinal_ex(ctx, pBuffer + c_len, &f_len),
+        ABC_CC_EncryptError, "AES encryption failed");
+
+    // set final values
+    ABC_BUF_SET_PTR(*pEncData, pBuffer, c_len + f_len);
+    pBuffer = NULL;
 
 exit:
+    OPENSSL_cleanse(random.data(), random.size());
+    if (pBuffer)
+    {
+        OPENSSL_cleanse(pBuffer, totalSizeUnencrypted);
+        free(pBuffer);
+    }
+
     return cc;
 }
 
@@ -402,6 +745,9 @@ exit:
  *   1 byte:     f (the number of random footer bytes)
  *   f bytes:    f random header bytes
  *   32 bytes:   32 bytes SHA256 of all data up to this point
+ *
+ * The data is decrypted into the buffer that gets handed back,
+ * and then slid to the front once the checks pass.
  */
 static
 tABC_CC ABC_CryptoDecryptAES256Package(const tABC_U08Buf EncData,
@@ -413,217 +759,115 @@ tABC_CC ABC_CryptoDecryptAES256Package(const tABC_U08Buf EncData,
     tABC_CC cc = ABC_CC_Ok;
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
 
-    AutoU08Buf Data;
-    unsigned char headerLength;
-    unsigned int minSize;
-    unsigned char *pDataLengthPos;
-    unsigned int dataSecLength;
-    unsigned char footerLength;
-    unsigned int shaCheckLength;
-    unsigned char *pSHALoc;
-    unsigned char sha256Output[SHA256_DIGEST_LENGTH];
-    unsigned char *pFinalDataPos;
+    unsigned char *pBuffer = NULL;
+    size_t bufferSize = 0;
+    size_t offset = 0;
+    size_t size = 0;
 
     ABC_CHECK_NULL_BUF(EncData);
-    ABC_CHECK_NULL_BUF(Key);
-    ABC_CHECK_NULL_BUF(IV);
     ABC_CHECK_NULL(pData);
 
-    // start by decrypting the pacakge
-    if (ABC_CC_Ok != ABC_CryptoDecryptAES256(EncData, Key, IV, &Data, pError))
-    {
-        cc = ABC_CC_DecryptFailure;
-        if (pError)
-        {
-            pError->code = cc;
-        }
-        goto exit;
-    }
-
-    // get the size of the random header section
-    headerLength = *ABC_BUF_PTR(Data);
-
-    // check that we have enough data based upon this info
-    minSize = 1 + headerLength + 4 + 1 + 1 + SHA256_DIGEST_LENGTH; // decrypted package must be at least this big
-    ABC_CHECK_ASSERT(ABC_BUF_SIZE(Data) >= minSize, ABC_CC_DecryptFailure, "Decrypted data is not long enough");
-
-    // get the size of the data section
-    pDataLengthPos = ABC_BUF_PTR(Data) + (1 + headerLength);
-    dataSecLength = ((unsigned int) *pDataLengthPos) << 24;
-    pDataLengthPos++;
-    dataSecLength += ((unsigned int) *pDataLengthPos) << 16;
-    pDataLengthPos++;
-    dataSecLength += ((unsigned int) *pDataLengthPos) << 8;
-    pDataLengthPos++;
-    dataSecLength += ((unsigned int) *pDataLengthPos);
-
-    // check that we have enough data based upon this info
-    minSize = 1 + headerLength + 4 + dataSecLength + 1 + SHA256_DIGEST_LENGTH; // decrypted package must be at least this big
-    ABC_CHECK_ASSERT(ABC_BUF_SIZE(Data) >= minSize, ABC_CC_DecryptFailure, "Decrypted data is not long enough");
-
-    // get the size of the random footer section
-    footerLength = *(ABC_BUF_PTR(Data) + 1 + headerLength + 4 + dataSecLength);
-
-    // check that we have enough data based upon this info
-    minSize = 1 + headerLength + 4 + dataSecLength + 1 + footerLength + SHA256_DIGEST_LENGTH; // decrypted package must be at least this big
-    ABC_CHECK_ASSERT(ABC_BUF_SIZE(Data) >= minSize, ABC_CC_DecryptFailure, "Decrypted data is not long enough");
-
-    // set up for the SHA check
-    shaCheckLength = 1 + headerLength + 4 + dataSecLength + 1 + footerLength; // all but the sha
-    pSHALoc = ABC_BUF_PTR(Data) + shaCheckLength;
+    // because we have padding ON, we must allocate an extra cipher block size of memory
+    bufferSize = ABC_BUF_SIZE(EncData) + AES_256_BLOCK_LENGTH;
+    ABC_ARRAY_NEW(pBuffer, bufferSize, unsigned char);
+    ABC_CHECK_RET(ABC_CryptoDecryptAES256Buffer(EncData, Key, IV,
+        pBuffer, &offset, &size, pError));
 
-    // calc the sha256
-    SHA256(ABC_BUF_PTR(Data), shaCheckLength, sha256Output);
+    // all is good, so slide the data to the front and hand it over
+    memmove(pBuffer, pBuffer + offset, size);
+    OPENSSL_cleanse(pBuffer + size, bufferSize - size);
+    ABC_BUF_SET_PTR(*pData, pBuffer, size);
+    pBuffer = NULL;
 
-    // check the sha256
-    if (0 != memcmp(pSHALoc, sha256Output, SHA256_DIGEST_LENGTH))
+exit:
+    if (pBuffer)
     {
-        // this can be specifically used by the caller to possibly determine whether the key was incorrect
-        ABC_RET_ERROR(ABC_CC_DecryptFailure, "Decrypted data failed checksum (SHA) check");
+        OPENSSL_cleanse(pBuffer, bufferSize);
+        free(pBuffer);
     }
 
-    // all is good, so create the final data
-    pFinalDataPos = ABC_BUF_PTR(Data) + 1 + headerLength + 4;
-    ABC_BUF_NEW(*pData, dataSecLength);
-    memcpy(ABC_BUF_PTR(*pData), pFinalDataPos, dataSecLength);
-
-exit:
     return cc;
 }
 
 /**
- * Encrypts the given data with AES256
+ * Decrypts and checks an aes256 package in a caller-supplied buffer,
+ * which must hold the encrypted size plus one cipher block.
+ * On success, the data sits at pBuffer + *pOffset.
  */
 static
-tABC_CC ABC_CryptoEncryptAES256(const tABC_U08Buf Data,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pEncData,
-                                tABC_Error        *pError)
+tABC_CC ABC_CryptoDecryptAES256Buffer(const tABC_U08Buf EncData,
+                                      const tABC_U08Buf Key,
+                                      const tABC_U08Buf IV,
+                                      unsigned char     *pBuffer,
+                                      size_t            *pOffset,
+                                      size_t            *pSize,
+                                      tABC_Error        *pError)
 {
     tABC_CC cc = ABC_CC_Ok;
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
 
-    unsigned char aKey[AES_256_KEY_LENGTH];
-    unsigned int keyLength = ABC_BUF_SIZE(Key);
-    unsigned char aIV[AES_256_IV_LENGTH];
-    unsigned int IVLength;
-    int c_len;
+    size_t size;
+    EVP_CIPHER_CTX *ctx = NULL;
+    int p_len = 0;
     int f_len = 0;
-    unsigned char *pTmpEncData = NULL;
+    unsigned char headerLength;
+    const unsigned char *pDataLengthPos;
+    size_t dataSecLength;
+    unsigned char footerLength;
+    size_t shaCheckLength;
+    unsigned char sha256Output[SHA256_DIGEST_LENGTH];
 
-    ABC_CHECK_NULL_BUF(Data);
+    ABC_CHECK_NULL_BUF(EncData);
     ABC_CHECK_NULL_BUF(Key);
     ABC_CHECK_NULL_BUF(IV);
-    ABC_CHECK_NULL(pEncData);
-
-    // create the final key
-    memset(aKey, 0, AES_256_KEY_LENGTH);
-    if (keyLength > AES_256_KEY_LENGTH)
-    {
-        keyLength = AES_256_KEY_LENGTH;
-    }
-    memcpy(aKey, ABC_BUF_PTR(Key), keyLength);
-
-    // create the IV
-    memset(aIV, 0, AES_256_IV_LENGTH);
-    IVLength = ABC_BUF_SIZE(IV);
-    if (IVLength > AES_256_IV_LENGTH)
-    {
-        IVLength = AES_256_IV_LENGTH;
-    }
-    memcpy(aIV, ABC_BUF_PTR(IV), IVLength);
-
-    // init our cipher text struct
-    EVP_CIPHER_CTX e_ctx;
-    EVP_CIPHER_CTX_init(&e_ctx);
-    EVP_EncryptInit_ex(&e_ctx, EVP_aes_256_cbc(), NULL, aKey, aIV);
+    ABC_CHECK_NULL(pBuffer);
 
-    // max ciphertext len for a n bytes of plaintext is n + AES_256_BLOCK_LENGTH -1 bytes
-    c_len = ABC_BUF_SIZE(Data) + AES_256_BLOCK_LENGTH;
-    ABC_ARRAY_NEW(pTmpEncData, c_len, unsigned char);
-
-    // allows reusing of 'e' for multiple encryption cycles
-    EVP_EncryptInit_ex(&e_ctx, NULL, NULL, NULL, NULL);
-
-    // update pTmpEncData, c_len is filled with the length of pTmpEncData generated, dataLength is the size of plaintext in bytes
-    EVP_EncryptUpdate(&e_ctx, pTmpEncData, &c_len, ABC_BUF_PTR(Data), ABC_BUF_SIZE(Data));
-
-    // update pTmpEncData with the final remaining bytes
-    EVP_EncryptFinal_ex(&e_ctx, pTmpEncData + c_len, &f_len);
-
-    // set final values
-    ABC_BUF_SET_PTR(*pEncData, pTmpEncData, c_len + f_len);
-
-    EVP_CIPHER_CTX_cleanup(&e_ctx);
+    // start by decrypting the pacakge
+    ctx = cipherContext(Key, IV, 0);
+    ABC_CHECK_ASSERT(ctx &&
+        EVP_DecryptUpdate(ctx, pBuffer, &p_len, ABC_BUF_PTR(EncData), ABC_BUF_SIZE(EncData)) &&
+        EVP_DecryptFinal_ex(ctx, pBuffer + p_len, &f_len),
+        ABC_CC_DecryptFailure, "Decryption failed");
+    size = p_len + f_len;
+    ABC_CHECK_ASSERT(size >= 1, ABC_CC_DecryptFailure, "Decrypted data is not long enough");
 
-exit:
+    // get the size of the random header section
+    headerLength = pBuffer[0];
 
-    return cc;
-}
+    // check that we have enough data based upon this info
+    ABC_CHECK_ASSERT(size >= 1 + headerLength + 4 + 1 + (size_t)SHA256_DIGEST_LENGTH,
+        ABC_CC_DecryptFailure, "Decrypted data is not long enough");
 
-/**
- * Decrypts the given data with AES256
- */
-static
-tABC_CC ABC_CryptoDecryptAES256(const tABC_U08Buf EncData,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pData,
-                                tABC_Error        *pError)
-{
-    tABC_CC cc = ABC_CC_Ok;
-    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+    // get the size of the data section
+    pDataLengthPos = pBuffer + 1 + headerLength;
+    dataSecLength =
+        ((size_t)pDataLengthPos[0] << 24) |
+        ((size_t)pDataLengthPos[1] << 16) |
+        ((size_t)pDataLengthPos[2] << 8) |
+        ((size_t)pDataLengthPos[3]);
 
-    unsigned char *pTmpData = NULL;
-    int p_len, f_len;
-    unsigned int IVLength;
-    unsigned int keyLength;
+    // check that we have enough data based upon this info
+    ABC_CHECK_ASSERT(size >= 1 + headerLength + 4 + dataSecLength + 1 + SHA256_DIGEST_LENGTH,
+        ABC_CC_DecryptFailure, "Decrypted data is not long enough");
 
-    ABC_CHECK_NULL_BUF(EncData);
-    ABC_CHECK_NULL_BUF(Key);
-    ABC_CHECK_NULL_BUF(IV);
-    ABC_CHECK_NULL(pData);
+    // get the size of the random footer section
+    footerLength = pBuffer[1 + headerLength + 4 + dataSecLength];
 
-    // create the final key
-    unsigned char aKey[AES_256_KEY_LENGTH];
-    memset(aKey, 0, AES_256_KEY_LENGTH);
-    keyLength = ABC_BUF_SIZE(Key);
-    if (keyLength > AES_256_KEY_LENGTH)
-    {
-        keyLength = AES_256_KEY_LENGTH;
-    }
-    memcpy(aKey, ABC_BUF_PTR(Key), keyLength);
+    // check that we have enough data based upon this info
+    shaCheckLength = 1 + headerLength + 4 + dataSecLength + 1 + footerLength; // all but the sha
+    ABC_CHECK_ASSERT(size >= shaCheckLength + SHA256_DIGEST_LENGTH,
+        ABC_CC_DecryptFailure, "Decrypted data is not long enough");
 
-    // create the IV
-    unsigned char aIV[AES_256_IV_LENGTH];
-    memset(aIV, 0, AES_256_IV_LENGTH);
-    IVLength = ABC_BUF_SIZE(IV);
-    if (IVLength > AES_256_IV_LENGTH)
+    // check the sha256
+    SHA256(pBuffer, shaCheckLength, sha256Output);
+    if (0 != memcmp(pBuffer + shaCheckLength, sha256Output, SHA256_DIGEST_LENGTH))
     {
-        IVLength = AES_256_IV_LENGTH;
+        // this can be specifically used by the caller to possibly determine whether the key was incorrect
+        ABC_RET_ERROR(ABC_CC_DecryptFailure, "Decrypted data failed checksum (SHA) check");
     }
-    memcpy(aIV, ABC_BUF_PTR(IV), IVLength);
-
-    // init our cipher text struct
-    EVP_CIPHER_CTX d_ctx;
-    EVP_CIPHER_CTX_init(&d_ctx);
-    EVP_DecryptInit_ex(&d_ctx, EVP_aes_256_cbc(), NULL, aKey, aIV);
-
-    /* because we have padding ON, we must allocate an extra cipher block size of memory */
-    p_len = ABC_BUF_SIZE(EncData);
-    f_len = 0;
-    ABC_ARRAY_NEW(pTmpData, p_len + AES_256_BLOCK_LENGTH, unsigned char);
 
-    // decrypt
-    EVP_DecryptInit_ex(&d_ctx, NULL, NULL, NULL, NULL);
-    EVP_DecryptUpdate(&d_ctx, pTmpData, &p_len, ABC_BUF_PTR(EncData), ABC_BUF_SIZE(EncData));
-    EVP_DecryptFinal_ex(&d_ctx, pTmpData + p_len, &f_len);
-
-    EVP_CIPHER_CTX_cleanup(&d_ctx);
-
-    // set final values
-    ABC_BUF_SET_PTR(*pData, pTmpData, p_len + f_len);
+    *pOffset = 1 + headerLength + 4;
+    *pSize = dataSecLength;
 
 exit:
     return cc;
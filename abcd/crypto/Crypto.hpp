@@ -57,10 +57,24 @@ typedef enum eABC_CryptoType
  * and a secret key.
  * This prevents the filename from leaking information about its contents
  * to anybody but the key holder.
+ * Recent results are cached for a few keys.
  */
 std::string
 cryptoFilename(DataSlice key, const std::string &name);
 
+/**
+ * Forgets the cached filenames, along with the keys that made them.
+ */
+void
+cryptoFilenameClear();
+
+/**
+ * Makes every thread forget its cached AES key.
+ * The calling thread forgets right away, and the others on their next use.
+ */
+void
+cryptoCipherClear();
+
 // Encryption:
 tABC_CC ABC_CryptoEncryptJSONObject(const tABC_U08Buf Data,
                                     const tABC_U08Buf Key,
@@ -95,6 +109,20 @@ tABC_CC ABC_CryptoDecryptJSONFileObject(const char *szFilename,
                                         json_t **ppJSON_Data,
                                         tABC_Error  *pError);
 
+/**
+ * Decrypts many files that share one key, as when loading a wallet.
+ * This skips the per-file key setup and buffer churn,
+ * and can spread the files over several threads.
+ * On failure, every slot in aJSON_Data comes back NULL.
+ * @param threads worker threads, 0 for one per core, 1 for none.
+ */
+tABC_CC ABC_CryptoDecryptJSONFiles(const char * const *aszFilenames,
+                                   size_t count,
+                                   const tABC_U08Buf Key,
+                                   json_t **aJSON_Data,
+                                   unsigned threads,
+                                   tABC_Error *pError);
+
 } // namespace abcd
 
 #endif
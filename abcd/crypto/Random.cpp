@@ -7,18 +7,212 @@
 
 #include "Random.hpp"
 #include "../util/FileIO.hpp"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
 #include <openssl/rand.h>
+#include <pthread.h>
 #ifndef __ANDROID__
 #include <sys/statvfs.h>
 #endif
 #include <sys/time.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
 
 namespace abcd {
 
 #define UUID_BYTE_COUNT         16
 #define UUID_STR_LENGTH         (UUID_BYTE_COUNT * 2) + 4
 
+/*
+ * Buffered random generator design
+ *
+ * Encrypting a small file asks for random bytes many times,
+ * and each RAND_bytes call takes OpenSSL's global lock and runs its
+ * reseed checks. Instead, each thread runs its own generator:
+ *
+ * - The state is an AES-256 key, seeded by XOR-ing in 32 bytes
+ *   from RAND_bytes, so it is never weaker than OpenSSL's pool.
+ * - Each refill runs AES-256-CTR with the current key and a zero
+ *   counter. The first 32 bytes of keystream replace the key and the
+ *   rest fill the buffer ("fast key erasure"). The old key is gone
+ *   after each refill, so a leaked state cannot reproduce earlier output.
+ *   Requests bigger than the buffer get their own refill, straight
+ *   into the caller's memory.
+ * - Bytes are wiped from the buffer as they are handed out,
+ *   for the same reason.
+ * - Each generator reseeds from RAND_bytes after RANDOM_RESEED_BYTES
+ *   of output, in a forked child (so parent and child never share a
+ *   stream), and after ABC_CryptoSetRandomSeed adds new entropy.
+ *
+ * If the generator cannot be set up, randomData uses RAND_bytes directly.
+ */
+#define RANDOM_KEY_LENGTH       32
+#define RANDOM_BUFFER_LENGTH    1024
+#define RANDOM_RESEED_BYTES     (1 << 20)
+
+struct RandomState
+{
+    EVP_CIPHER_CTX *ctx;
+    unsigned char key[RANDOM_KEY_LENGTH];
+    unsigned char buffer[RANDOM_BUFFER_LENGTH];
+    size_t used;        // bytes of the buffer already handed out
+    size_t sinceSeed;   // bytes generated since the last reseed
+    unsigned seedEpoch; // gRandomEpoch as of the last reseed
+    bool seeded;
+};
+
+static pthread_key_t gRandomKey;
+static pthread_once_t gRandomOnce = PTHREAD_ONCE_INIT;
+static bool gRandomReady = false;
+
+/**
+ * Bumped after forks and new seeds, telling every generator to reseed.
+ */
+static std::atomic<unsigned> gRandomEpoch(0);
+
+static void
+randomStateFree(void *p)
+{
+    auto state = static_cast<RandomState *>(p);
+    if (state->ctx)
+        EVP_CIPHER_CTX_free(state->ctx);
+    OPENSSL_cleanse(state, sizeof(RandomState));
+    free(state);
+}
+
+static void
+randomAfterFork()
+{
+    ++gRandomEpoch;
+}
+
+static void
+randomInit()
+{
+    gRandomReady = !pthread_key_create(&gRandomKey, randomStateFree) &&
+        !pthread_atfork(NULL, NULL, randomAfterFork);
+}
+
+/**
+ * Fetches the calling thread's generator, creating it if needed.
+ * @return nullptr if the generator is unavailable.
+ */
+static RandomState *
+randomState()
+{
+    pthread_once(&gRandomOnce, randomInit);
+    if (!gRandomReady)
+        return nullptr;
+
+    auto state = static_cast<RandomState *>(pthread_getspecific(gRandomKey));
+    if (!state)
+    {
+        state = static_cast<RandomState *>(calloc(1, sizeof(RandomState)));
+        if (!state)
+            return nullptr;
+        state->ctx = EVP_CIPHER_CTX_new();
+        if (!state->ctx || pthread_setspecific(gRandomKey, state))
+        {
+            randomStateFree(state);
+            return nullptr;
+        }
+        state->used = RANDOM_BUFFER_LENGTH;
+    }
+    return state;
+}
+
+/**
+ * Mixes fresh OpenSSL output into the key and throws away the buffer.
+ */
+static bool
+randomReseed(RandomState *state)
+{
+    unsigned char seed[RANDOM_KEY_LENGTH];
+    const unsigned epoch = gRandomEpoch;
+    if (!RAND_bytes(seed, sizeof(seed)))
+        return false;
+
+    for (size_t i = 0; i < RANDOM_KEY_LENGTH; ++i)
+        state->key[i] ^= seed[i];
+    OPENSSL_cleanse(seed, sizeof(seed));
+    OPENSSL_cleanse(state->buffer, sizeof(state->buffer));
+    state->used = RANDOM_BUFFER_LENGTH;
+    state->sinceSeed = 0;
+    state->seedEpoch = epoch;
+    state->seeded = true;
+    return true;
+}
+
+/**
+ * Runs the key forward, writing size bytes of fresh output.
+ */
+static bool
+randomStream(RandomState *state, uint8_t *out, size_t size)
+{
+    static const unsigned char iv[16] = {0};
+    unsigned char key[RANDOM_KEY_LENGTH] = {0};
+    int keySize = 0;
+    int outSize = 0;
+
+    // The key never repeats, so a zero counter is safe.
+    // Encrypting zeros in place yields the raw keystream:
+    memset(out, 0, size);
+    bool ok = EVP_EncryptInit_ex(state->ctx, EVP_aes_256_ctr(), NULL,
+            state->key, iv) &&
+        EVP_EncryptUpdate(state->ctx, key, &keySize, key, sizeof(key)) &&
+        EVP_EncryptUpdate(state->ctx, out, &outSize, out, size) &&
+        sizeof(key) == size_t(keySize) && size == size_t(outSize);
+    if (ok)
+    {
+        memcpy(state->key, key, RANDOM_KEY_LENGTH);
+        state->sinceSeed += size;
+    }
+    OPENSSL_cleanse(key, sizeof(key));
+    return ok;
+}
+
+/**
+ * Fills the output from the calling thread's generator.
+ * @return false if the generator is unavailable.
+ */
+static bool
+randomGenerate(uint8_t *out, size_t size)
+{
+    RandomState *state = randomState();
+    if (!state)
+        return false;
+
+    if (!state->seeded || state->seedEpoch != gRandomEpoch ||
+        RANDOM_RESEED_BYTES <= state->sinceSeed)
+    {
+        if (!randomReseed(state))
+            return false;
+    }
+
+    // Big requests skip the buffer:
+    if (RANDOM_BUFFER_LENGTH <= size)
+        return randomStream(state, out, size);
+
+    while (size)
+    {
+        if (RANDOM_BUFFER_LENGTH <= state->used)
+        {
+            if (!randomStream(state, state->buffer, RANDOM_BUFFER_LENGTH))
+                return false;
+            state->used = 0;
+        }
+
+        size_t chunk = std::min(size, RANDOM_BUFFER_LENGTH - state->used);
+        memcpy(out, state->buffer + state->used, chunk);
+        OPENSSL_cleanse(state->buffer + state->used, chunk);
+        state->used += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
 /**
  * Sets the seed for the random number generator
  */
@@ -84,6 +278,9 @@ tABC_CC ABC_CryptoSetRandomSeed(const tABC_U08Buf Seed,
     // seed it
     RAND_seed(ABC_BUF_PTR(NewSeed), ABC_BUF_SIZE(NewSeed));
 
+    // have the buffered generators pick up the new entropy
+    ++gRandomEpoch;
+
 exit:
     ABC_FREE_STR(szFileIORootDir);
 
@@ -96,7 +293,8 @@ randomData(DataChunk &result, size_t size)
     DataChunk out;
     out.resize(size);
 
-    if (!RAND_bytes(out.data(), out.size()))
+    if (!randomGenerate(out.data(), out.size()) &&
+        !RAND_bytes(out.data(), out.size()))
         return ABC_ERROR(ABC_CC_Error, "Random data generation failed");
 
     result = std::move(out);
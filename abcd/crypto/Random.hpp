@@ -18,6 +18,8 @@ tABC_CC ABC_CryptoSetRandomSeed(const tABC_U08Buf Seed,
 
 /**
  * Generates cryptographically-secure random data.
+ * Small requests come from a buffered per-thread generator
+ * that OpenSSL seeds; Random.cpp describes the design.
  */
 Status
 randomData(DataChunk &result, size_t size);
@@ -9,8 +9,20 @@
 #include "Encoding.hpp"
 #include "Random.hpp"
 #include "../bitcoin/Testnet.hpp"
+#include "../json/JsonObject.hpp"
+#include "../util/FileIO.hpp"
+#include "../util/Parallel.hpp"
 #include "../../minilibs/scrypt/crypto_scrypt.h"
 #include <sys/time.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
 namespace abcd {
 
@@ -26,6 +38,8 @@ namespace abcd {
 #define SCRYPT_DEFAULT_CLIENT_R    1
 #define SCRYPT_DEFAULT_CLIENT_P    1
 #define SCRYPT_MAX_CLIENT_N        (1 << 17)
+#define SCRYPT_MAX_CLIENT_P        4
+#define SCRYPT_MAX_CLIENT_MEMORY   (128 * 1024 * 1024)
 #define SCRYPT_TARGET_USECONDS     500000
 
 #define SCRYPT_DEFAULT_LENGTH      32
@@ -33,12 +47,73 @@ namespace abcd {
 
 #define TIMED_SCRYPT_PARAMS        TRUE
 
-//
-// Eeewww. Global var. Should we mutex this? It's just a single initialized var at
-// startup. It's never written after that. Only read.
-//
-unsigned int g_timedScryptN = SCRYPT_DEFAULT_CLIENT_N;
-unsigned int g_timedScryptR = SCRYPT_DEFAULT_CLIENT_R;
+#define SCRYPT_CACHE_FILENAME      "Scrypt.json"
+#define SCRYPT_CACHE_MAX_AGE       (30 * 24 * 60 * 60) // seconds
+
+/**
+ * Scrypt parameters for new client-side SNRPs.
+ */
+struct ScryptParams
+{
+    unsigned N;
+    unsigned r;
+    unsigned p;
+};
+
+/**
+ * The last calibration result, saved in the root directory.
+ */
+struct ScryptCacheFile:
+    public JsonObject
+{
+    ABC_JSON_STRING(Fingerprint, "fingerprint", "")
+    ABC_JSON_INTEGER(Date, "date", 0)
+    ABC_JSON_INTEGER(Time, "time", 0)
+    ABC_JSON_INTEGER(N, JSON_ENC_N_FIELD, 0)
+    ABC_JSON_INTEGER(R, JSON_ENC_R_FIELD, 0)
+    ABC_JSON_INTEGER(P, JSON_ENC_P_FIELD, 0)
+};
+
+// The background calibration can update these at any time:
+static std::mutex gScryptMutex;
+static ScryptParams gScryptParams =
+{
+    SCRYPT_DEFAULT_CLIENT_N, SCRYPT_DEFAULT_CLIENT_R, SCRYPT_DEFAULT_CLIENT_P
+};
+static std::thread gCalibrateThread;
+
+// The background derivation thread, and the jobs waiting for it.
+// gWorkerThreadMutex serializes starting and stopping the thread:
+static std::mutex gWorkerThreadMutex;
+static std::mutex gWorkerMutex;
+static std::condition_variable gWorkerChanged;
+static std::deque<ScryptJob *> gWorkerQueue;
+static std::thread gWorkerThread;
+static bool gWorkerStop = false;
+
+/**
+ * Lets the worker finish its queue, then joins it.
+ * The next ScryptJob starts a fresh one.
+ */
+static void
+scryptWorkerStop()
+{
+    std::lock_guard<std::mutex> threadLock(gWorkerThreadMutex);
+    {
+        std::lock_guard<std::mutex> lock(gWorkerMutex);
+        gWorkerStop = true;
+        gWorkerChanged.notify_all();
+    }
+    if (gWorkerThread.joinable())
+        gWorkerThread.join();
+    gWorkerStop = false;
+}
+
+// Programs that exit without ABC_Terminate still need the thread joined:
+static struct ScryptWorkerGuard
+{
+    ~ScryptWorkerGuard() { scryptWorkerStop(); }
+} gWorkerGuard;
 
 static unsigned char gaS1[] = { 0xb5, 0x86, 0x5f, 0xfb, 0x9f, 0xa7, 0xb3, 0xbf, 0xe4, 0xb2, 0x38, 0x4d, 0x47, 0xce, 0x83, 0x1e, 0xe2, 0x2a, 0x4a, 0x9d, 0x5c, 0x34, 0xc7, 0xef, 0x7d, 0x21, 0x46, 0x7c, 0xc7, 0x58, 0xf8, 0x1b };
 
@@ -46,45 +121,47 @@ static unsigned char gaS1[] = { 0xb5, 0x86, 0x5f, 0xfb, 0x9f, 0xa7, 0xb3, 0xbf,
 // with same login that exist on both testnet and mainnet and don't conflict
 static unsigned char gaS1_testnet[] = { 0xa5, 0x96, 0x3f, 0x3b, 0x9c, 0xa6, 0xb3, 0xbf, 0xe4, 0xb2, 0x36, 0x42, 0x37, 0xfe, 0x87, 0x1e, 0xf2, 0x2a, 0x4a, 0x9d, 0x4c, 0x34, 0xa7, 0xef, 0x3d, 0x21, 0x47, 0x8c, 0xc7, 0x58, 0xf8, 0x1b };
 
-/*
- * Initializes Scrypt paramenters by benchmarking device
+/**
+ * Runs scrypt once with the given parameters, and reports how long it took.
+ * @param result the elapsed time, in uSec
  */
-tABC_CC ABC_InitializeCrypto(tABC_Error        *pError)
+static Status
+scryptTime(unsigned long N, unsigned long r, unsigned long p, int &result)
 {
-    tABC_CC cc = ABC_CC_Ok;
+    AutoU08Buf temp;
+    tABC_U08Buf Salt; // Do not free
+    ABC_BUF_SET_PTR(Salt, gaS1, sizeof(gaS1));
 
     struct timeval timerStart;
     struct timeval timerEnd;
-    int totalTime;
-    tABC_U08Buf Salt; // Do not free
-    AutoU08Buf temp;
+    gettimeofday(&timerStart, NULL);
+    ABC_CHECK_OLD(ABC_CryptoScrypt(Salt, Salt, N, r, p,
+                                   SCRYPT_DEFAULT_LENGTH, &temp, &error));
+    gettimeofday(&timerEnd, NULL);
 
-    ABC_DebugLog("%s called", __FUNCTION__);
+    result = 1000000 * (timerEnd.tv_sec - timerStart.tv_sec);
+    result += timerEnd.tv_usec;
+    result -= timerStart.tv_usec;
+    return Status();
+}
 
-    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
-    if (isTestnet())
-    {
-        ABC_BUF_SET_PTR(Salt, gaS1_testnet, sizeof(gaS1));
-    }
-    else
+/**
+ * Benchmarks the device to find scrypt parameters
+ * that take about SCRYPT_TARGET_USECONDS to run.
+ * @param totalTime the time for one default-strength scrypt, in uSec
+ */
+static Status
+scryptCalibrate(ScryptParams &result, int &totalTime)
+{
+    ScryptParams out =
     {
-        ABC_BUF_SET_PTR(Salt, gaS1, sizeof(gaS1));
-    }
-    gettimeofday(&timerStart, NULL);
-    ABC_CHECK_RET(ABC_CryptoScrypt(Salt,
-                                   Salt,
-                                   SCRYPT_DEFAULT_CLIENT_N,
-                                   SCRYPT_DEFAULT_CLIENT_R,
-                                   SCRYPT_DEFAULT_CLIENT_P,
-                                   SCRYPT_DEFAULT_LENGTH,
-                                   &temp,
-                                   pError));
-    gettimeofday(&timerEnd, NULL);
+        SCRYPT_DEFAULT_CLIENT_N, SCRYPT_DEFAULT_CLIENT_R, SCRYPT_DEFAULT_CLIENT_P
+    };
 
     // Totaltime is in uSec
-    totalTime = 1000000 * (timerEnd.tv_sec - timerStart.tv_sec);
-    totalTime += timerEnd.tv_usec;
-    totalTime -= timerStart.tv_usec;
+    ABC_CHECK(scryptTime(SCRYPT_DEFAULT_CLIENT_N,
+                         SCRYPT_DEFAULT_CLIENT_R,
+                         SCRYPT_DEFAULT_CLIENT_P, totalTime));
 
 #ifdef TIMED_SCRYPT_PARAMS
     if (totalTime >= SCRYPT_TARGET_USECONDS)
@@ -97,32 +174,214 @@ tABC_CC ABC_InitializeCrypto(tABC_Error        *pError)
         // Medium speed device.
         // Scale R between 1 to 8 assuming linear effect on hashing time.
         // Don't touch N.
-        g_timedScryptR = SCRYPT_TARGET_USECONDS / totalTime;
+        out.r = SCRYPT_TARGET_USECONDS / totalTime;
     }
     else if (totalTime > 0)
     {
         // Very fast device.
-        g_timedScryptR = 8;
+        out.r = 8;
 
         // Need to adjust scryptN to make scrypt even stronger:
         unsigned int temp = (SCRYPT_TARGET_USECONDS / 8) / totalTime;
-        g_timedScryptN <<= (temp - 1);
-        if (SCRYPT_MAX_CLIENT_N < g_timedScryptN || !g_timedScryptN)
+        out.N <<= (temp - 1);
+        if (SCRYPT_MAX_CLIENT_N < out.N || !out.N)
         {
-            g_timedScryptN = SCRYPT_MAX_CLIENT_N;
+            out.N = SCRYPT_MAX_CLIENT_N;
         }
     }
+
+    // The p lanes run in parallel, so each spare core buys another lane
+    // for free, as long as the lanes fit in memory:
+    out.p = parallelThreads();
+    if (SCRYPT_MAX_CLIENT_P < out.p)
+        out.p = SCRYPT_MAX_CLIENT_P;
+    while (1 < out.p && SCRYPT_MAX_CLIENT_MEMORY < 128 * out.r * out.N * out.p)
+        --out.p;
+
+    // Cores can be busy, throttled, or slower than they look,
+    // so make sure the lanes really do run side-by-side:
+    while (1 < out.p)
+    {
+        int laneTime;
+        ABC_CHECK(scryptTime(SCRYPT_DEFAULT_CLIENT_N,
+                             SCRYPT_DEFAULT_CLIENT_R, out.p, laneTime));
+        if (laneTime <= totalTime + totalTime / 2)
+            break;
+        out.p /= 2;
+    }
 #endif
 
+    result = out;
+    return Status();
+}
+
+/**
+ * Describes the hardware the calibration ran on.
+ * The cached calibration is only good if this still matches.
+ */
+static std::string
+scryptFingerprint()
+{
+    std::string out;
+
+    struct utsname name;
+    if (!uname(&name))
+        out += std::string(name.sysname) + ' ' + name.machine;
+
+    // The CPU model, where Linux and Android give it out:
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line))
+    {
+        if (!line.compare(0, 10, "model name") ||
+            !line.compare(0, 8, "Hardware"))
+        {
+            auto colon = line.find(':');
+            if (colon != std::string::npos)
+                out += ',' + line.substr(colon + 1);
+            break;
+        }
+    }
+
+    out += ", " + std::to_string(parallelThreads()) + " cores";
+    out += std::string(", ") + crypto_scrypt_get_impl();
+    return out;
+}
+
+/**
+ * Reads the cached calibration.
+ * @param fresh set to false if the calibration is old enough to redo.
+ */
+static Status
+scryptCacheLoad(ScryptParams &result, bool &fresh)
+{
+    ScryptCacheFile file;
+    ABC_CHECK(file.load(getRootDir() + SCRYPT_CACHE_FILENAME));
+    ABC_CHECK(file.hasN());
+    ABC_CHECK(file.hasR());
+    ABC_CHECK(file.hasP());
+
+    if (scryptFingerprint() != file.getFingerprint())
+        return ABC_ERROR(ABC_CC_Error, "Scrypt calibration is for different hardware");
+
+    ScryptParams out;
+    out.N = file.getN();
+    out.r = file.getR();
+    out.p = file.getP();
+    if (out.N < SCRYPT_DEFAULT_CLIENT_N || SCRYPT_MAX_CLIENT_N < out.N ||
+        (out.N & (out.N - 1)) ||
+        out.r < SCRYPT_DEFAULT_CLIENT_R || 8 < out.r ||
+        out.p < SCRYPT_DEFAULT_CLIENT_P || SCRYPT_MAX_CLIENT_P < out.p)
+        return ABC_ERROR(ABC_CC_Error, "Bad scrypt calibration");
+
+    time_t age = time(nullptr) - file.getDate();
+    fresh = 0 <= age && age < SCRYPT_CACHE_MAX_AGE;
+    result = out;
+    return Status();
+}
+
+/**
+ * Saves a calibration result for the next run.
+ */
+static Status
+scryptCacheSave(const ScryptParams &params, int totalTime)
+{
+    ScryptCacheFile file;
+    ABC_CHECK(file.setFingerprint(scryptFingerprint().c_str()));
+    ABC_CHECK(file.setDate(time(nullptr)));
+    ABC_CHECK(file.setTime(totalTime));
+    ABC_CHECK(file.setN(params.N));
+    ABC_CHECK(file.setR(params.r));
+    ABC_CHECK(file.setP(params.p));
+    ABC_CHECK(file.save(getRootDir() + SCRYPT_CACHE_FILENAME));
+    return Status();
+}
+
+/**
+ * Calibrates scrypt off the main thread, then publishes and saves the result.
+ */
+static void
+scryptCalibrateThread()
+{
+    ScryptParams params;
+    int totalTime;
+    Status s = scryptCalibrate(params, totalTime);
+    if (!s)
+    {
+        ABC_DebugLog("Scrypt calibration failed: %s", s.message().c_str());
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gScryptMutex);
+        gScryptParams = params;
+    }
     ABC_DebugLog("Scrypt timing: %d\n", totalTime);
-    ABC_DebugLog("Scrypt N = %d\n",g_timedScryptN);
-    ABC_DebugLog("Scrypt R = %d\n",g_timedScryptR);
+    ABC_DebugLog("Scrypt N = %d\n", params.N);
+    ABC_DebugLog("Scrypt R = %d\n", params.r);
+    ABC_DebugLog("Scrypt P = %d\n", params.p);
 
-exit:
+    s = scryptCacheSave(params, totalTime);
+    if (!s)
+        ABC_DebugLog("Cannot save scrypt calibration: %s", s.message().c_str());
+}
+
+/*
+ * Initializes Scrypt paramenters from the cached calibration,
+ * benchmarking the device in the background if that is missing or stale.
+ */
+tABC_CC ABC_InitializeCrypto(tABC_Error        *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+
+    ScryptParams params;
+    bool fresh = false;
+
+    ABC_DebugLog("%s called", __FUNCTION__);
+
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+
+    if (scryptCacheLoad(params, fresh))
+    {
+        std::lock_guard<std::mutex> lock(gScryptMutex);
+        gScryptParams = params;
+        ABC_DebugLog("Scrypt N = %d, R = %d, P = %d (cached)\n",
+                     params.N, params.r, params.p);
+    }
+
+    // Until the calibration finishes, new accounts get the last result,
+    // or failing that the default settings, which are the lowest we'll go.
+    if (!fresh && !gCalibrateThread.joinable())
+    {
+        try
+        {
+            gCalibrateThread = std::thread(scryptCalibrateThread);
+        }
+        catch (const std::system_error &e)
+        {
+            ABC_DebugLog("Cannot start scrypt calibration: %s", e.what());
+        }
+    }
 
     return cc;
 }
 
+void ABC_TerminateCrypto()
+{
+    if (gCalibrateThread.joinable())
+        gCalibrateThread.join();
+
+    ABC_CryptoScryptRelease();
+    ABC_DebugLog("Scrypt peak memory: %zu bytes\n", crypto_scrypt_arena_peak());
+}
+
+void ABC_CryptoScryptRelease()
+{
+    // The worker's scratch memory goes away when its thread exits:
+    scryptWorkerStop();
+    crypto_scrypt_arena_release();
+}
+
 /**
  * Allocate and generate scrypt from an SNRP
  */
@@ -195,16 +454,21 @@ tABC_CC ABC_CryptoCreateSNRPForClient(tABC_CryptoSNRP   **ppSNRP,
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
 
     DataChunk salt;
+    ScryptParams params;
 
     ABC_CHECK_NULL(ppSNRP);
 
     // gen some salt
     ABC_CHECK_NEW(randomData(salt, SCRYPT_DEFAULT_SALT_LENGTH), pError);
 
+    {
+        std::lock_guard<std::mutex> lock(gScryptMutex);
+        params = gScryptParams;
+    }
     ABC_CHECK_RET(ABC_CryptoCreateSNRP(toU08Buf(salt),
-                                       g_timedScryptN,
-                                       g_timedScryptR,
-                                       SCRYPT_DEFAULT_CLIENT_P,
+                                       params.N,
+                                       params.r,
+                                       params.p,
                                        ppSNRP,
                                        pError));
 exit:
@@ -358,6 +622,142 @@ exit:
     return cc;
 }
 
+ScryptJob::~ScryptJob()
+{
+    cancel();
+    U08BufFree(key_);
+    wipe();
+}
+
+ScryptJob::ScryptJob():
+    N_(0), r_(0), p_(0),
+    queued_(false), running_(false),
+    done_(true)
+{
+    ABC_BUF_CLEAR(key_);
+}
+
+void
+ScryptJob::start(tABC_U08Buf Data, const tABC_CryptoSNRP *pSNRP)
+{
+    cancel();
+    U08BufFree(key_);
+    wipe();
+
+    data_ = DataChunk(Data.p, Data.end);
+    salt_ = DataChunk(pSNRP->Salt.p, pSNRP->Salt.end);
+    N_ = pSNRP->N;
+    r_ = pSNRP->r;
+    p_ = pSNRP->p;
+    done_ = false;
+
+    // Hand the job to the worker, starting it if need be:
+    std::lock_guard<std::mutex> threadLock(gWorkerThreadMutex);
+    std::lock_guard<std::mutex> lock(gWorkerMutex);
+    if (!gWorkerThread.joinable())
+    {
+        try
+        {
+            gWorkerThread = std::thread(&ScryptJob::worker);
+        }
+        catch (const std::system_error &)
+        {
+            // wait() will do the work instead.
+            return;
+        }
+    }
+    gWorkerQueue.push_back(this);
+    queued_ = true;
+    gWorkerChanged.notify_all();
+}
+
+bool
+ScryptJob::matches(const tABC_CryptoSNRP *pSNRP) const
+{
+    return N_ == pSNRP->N && r_ == pSNRP->r && p_ == pSNRP->p &&
+        salt_ == DataChunk(pSNRP->Salt.p, pSNRP->Salt.end);
+}
+
+Status
+ScryptJob::wait(tABC_U08Buf &result)
+{
+    {
+        std::unique_lock<std::mutex> lock(gWorkerMutex);
+        gWorkerChanged.wait(lock, [this]() { return !queued_ && !running_; });
+    }
+    if (!done_)
+        run();
+
+    ABC_CHECK(status_);
+    result = key_;
+    ABC_BUF_CLEAR(key_);
+    return Status();
+}
+
+void
+ScryptJob::run()
+{
+    tABC_Error error;
+    if (ABC_CC_Ok == ABC_CryptoScrypt(toU08Buf(data_), toU08Buf(salt_),
+        N_, r_, p_, SCRYPT_DEFAULT_LENGTH, &key_, &error))
+        status_ = Status();
+    else
+        status_ = Status::fromError(error);
+
+    wipe();
+    done_ = true;
+}
+
+void
+ScryptJob::cancel()
+{
+    std::unique_lock<std::mutex> lock(gWorkerMutex);
+    if (queued_)
+    {
+        gWorkerQueue.erase(std::find(gWorkerQueue.begin(), gWorkerQueue.end(), this));
+        queued_ = false;
+    }
+    gWorkerChanged.wait(lock, [this]() { return !running_; });
+}
+
+void
+ScryptJob::wipe()
+{
+    if (data_.size())
+        ABC_UtilGuaranteedMemset(data_.data(), 0, data_.size());
+}
+
+/**
+ * Runs queued scrypt jobs, one at a time, until told to stop.
+ * Staying on one thread lets scrypt reuse that thread's scratch memory.
+ */
+void
+ScryptJob::worker()
+{
+    std::unique_lock<std::mutex> lock(gWorkerMutex);
+    while (true)
+    {
+        gWorkerChanged.wait(lock, []()
+        {
+            return gWorkerStop || !gWorkerQueue.empty();
+        });
+        if (gWorkerQueue.empty())
+            break;
+
+        ScryptJob *job = gWorkerQueue.front();
+        gWorkerQueue.pop_front();
+        job->queued_ = false;
+        job->running_ = true;
+
+        lock.unlock();
+        job->run();
+        lock.lock();
+
+        job->running_ = false;
+        gWorkerChanged.notify_all();
+    }
+}
+
 /**
  * Deep free's an SNRP object including the Seed data
  */
@@ -8,6 +8,8 @@
 #ifndef ABCD_CRYPTO_SCRYPT_HPP
 #define ABCD_CRYPTO_SCRYPT_HPP
 
+#include "../util/Data.hpp"
+#include "../util/Status.hpp"
 #include "../util/U08Buf.hpp"
 #include "../../src/ABC.h"
 #include <jansson.h>
@@ -24,6 +26,20 @@ typedef struct sABC_CryptoSNRP
 
 tABC_CC ABC_InitializeCrypto(tABC_Error        *pError);
 
+/**
+ * Waits for any background scrypt calibration to finish,
+ * and stops the background derivation thread.
+ */
+void ABC_TerminateCrypto();
+
+/**
+ * Frees the scratch memory scrypt keeps on the calling thread,
+ * and stops the ScryptJob thread, which frees its memory too.
+ * Scrypt wipes this memory after each call but keeps it mapped,
+ * so back-to-back derivations don't pay to map and fault it in again.
+ */
+void ABC_CryptoScryptRelease();
+
 tABC_CC ABC_CryptoScryptSNRP(const tABC_U08Buf     Data,
                              const tABC_CryptoSNRP *pSNRP,
                              tABC_U08Buf           *pScryptData,
@@ -61,6 +77,67 @@ tABC_CC ABC_CryptoDecodeJSONObjectSNRP(const json_t      *pJSON_SNRP,
 
 void ABC_CryptoFreeSNRP(tABC_CryptoSNRP *pSNRP);
 
+/**
+ * Runs an SNRP-based scrypt on a background thread,
+ * so the caller can wait on the network in the meantime.
+ * All jobs share one long-lived thread, which keeps its scrypt
+ * scratch memory between jobs until ABC_CryptoScryptRelease.
+ */
+class ScryptJob
+{
+public:
+    ~ScryptJob();
+    ScryptJob();
+
+    /**
+     * Starts the derivation, copying the data and SNRP.
+     * If no thread is available, the work happens in `wait` instead.
+     */
+    void
+    start(tABC_U08Buf Data, const tABC_CryptoSNRP *pSNRP);
+
+    /**
+     * Returns true if the job was started with the same SNRP.
+     */
+    bool
+    matches(const tABC_CryptoSNRP *pSNRP) const;
+
+    /**
+     * Waits for the derivation to finish.
+     * @param result an empty buffer to receive the key. The caller frees it.
+     */
+    Status
+    wait(tABC_U08Buf &result);
+
+    ScryptJob(const ScryptJob &copy) = delete;
+    ScryptJob &operator=(const ScryptJob &copy) = delete;
+
+private:
+    DataChunk data_;
+    DataChunk salt_;
+    unsigned long N_;
+    unsigned long r_;
+    unsigned long p_;
+
+    // The worker's lock protects these two:
+    bool queued_;
+    bool running_;
+    bool done_;
+    Status status_;
+    tABC_U08Buf key_;
+
+    void run();
+
+    /**
+     * Takes the job off the queue, or waits for it to finish running.
+     */
+    void cancel();
+
+    void wipe();
+
+    static void worker();
+};
+
 } // namespace abcd
 
 #endif
@@ -11,6 +11,7 @@
 #include "LoginDir.hpp"
 #include "LoginServer.hpp"
 #include "../crypto/Crypto.hpp"
+#include "../crypto/Scrypt.hpp"
 #include "../util/Util.hpp"
 
 namespace abcd {
@@ -59,20 +60,32 @@ tABC_CC ABC_LoginPasswordServer(std::shared_ptr<Login> &result,
     std::unique_ptr<Login> login;
     tABC_CarePackage    *pCarePackage   = NULL;
     tABC_LoginPackage   *pLoginPackage  = NULL;
+    tABC_CryptoSNRP     *pServerSNRP    = NULL;
     tABC_U08Buf         LRA1            = ABC_BUF_NULL; // Do not free
     AutoU08Buf          LP1;
     AutoU08Buf          LP2;
     AutoU08Buf          MK;
+    ScryptJob           jobLP1;
+    ScryptJob           jobLP2;
+
+    // SNRP1 is always the server SNRP, so start on LP1 right away:
+    ABC_CHECK_RET(ABC_CryptoCreateSNRPForServer(&pServerSNRP, pError));
+    jobLP1.start(LP, pServerSNRP);
 
     // Get the CarePackage:
     ABC_CHECK_RET(ABC_LoginServerGetCarePackage(toU08Buf(lobby->authId()), &pCarePackage, pError));
 
+    // LP2 only needs the CarePackage, so it can run during the next request:
+    jobLP2.start(LP, pCarePackage->pSNRP2);
+
     // Get the LoginPackage:
-    ABC_CHECK_RET(ABC_CryptoScryptSNRP(LP, pCarePackage->pSNRP1, &LP1, pError));
+    if (!jobLP1.matches(pCarePackage->pSNRP1))
+        jobLP1.start(LP, pCarePackage->pSNRP1);
+    ABC_CHECK_NEW(jobLP1.wait(LP1), pError);
     ABC_CHECK_RET(ABC_LoginServerGetLoginPackage(toU08Buf(lobby->authId()), LP1, LRA1, &pLoginPackage, pError));
 
     // Decrypt MK:
-    ABC_CHECK_RET(ABC_CryptoScryptSNRP(LP, pCarePackage->pSNRP2, &LP2, pError));
+    ABC_CHECK_NEW(jobLP2.wait(LP2), pError);
     ABC_CHECK_RET(ABC_CryptoDecryptJSONObject(pLoginPackage->EMK_LP2, LP2, &MK, pError));
 
     // Decrypt SyncKey:
@@ -86,6 +99,7 @@ tABC_CC ABC_LoginPasswordServer(std::shared_ptr<Login> &result,
     result.reset(login.release());
 
 exit:
+    ABC_CryptoFreeSNRP(pServerSNRP);
     ABC_CarePackageFree(pCarePackage);
     ABC_LoginPackageFree(pLoginPackage);
 
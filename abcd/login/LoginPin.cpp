@@ -13,6 +13,7 @@
 #include "../crypto/Crypto.hpp"
 #include "../crypto/Encoding.hpp"
 #include "../crypto/Random.hpp"
+#include "../crypto/Scrypt.hpp"
 #include "../util/Json.hpp"
 #include "../util/Util.hpp"
 #include <jansson.h>
@@ -169,6 +170,7 @@ tABC_CC ABC_LoginPin(std::shared_ptr<Login> &result,
     AutoU08Buf          LPIN2;
     AutoU08Buf          PINK;
     AutoU08Buf          MK;
+    ScryptJob           jobLPIN2;
 
     // Load the packages:
     ABC_CHECK_RET(ABC_LoginDirLoadPackages(lobby->dir(), &pCarePackage, &pLoginPackage, pError));
@@ -176,8 +178,10 @@ tABC_CC ABC_LoginPin(std::shared_ptr<Login> &result,
 
     // LPIN = L + PIN:
     ABC_BUF_STRCAT(LPIN, lobby->username().c_str(), szPin);
+
+    // LPIN2 isn't needed until the server replies, so run it alongside:
+    jobLPIN2.start(LPIN, pCarePackage->pSNRP2);
     ABC_CHECK_RET(ABC_CryptoScryptSNRP(LPIN, pCarePackage->pSNRP1, &LPIN1, pError));
-    ABC_CHECK_RET(ABC_CryptoScryptSNRP(LPIN, pCarePackage->pSNRP2, &LPIN2, pError));
 
     // Get EPINK from the server:
     ABC_CHECK_RET(ABC_LoginServerGetPinPackage(toU08Buf(pLocal->DID), LPIN1, &szEPINK, pError));
@@ -186,6 +190,7 @@ tABC_CC ABC_LoginPin(std::shared_ptr<Login> &result,
         ABC_CC_JSONError, "Error parsing EPINK JSON");
 
     // Decrypt MK:
+    ABC_CHECK_NEW(jobLPIN2.wait(LPIN2), pError);
     ABC_CHECK_RET(ABC_CryptoDecryptJSONObject(pEPINK, LPIN2, &PINK, pError));
     ABC_CHECK_RET(ABC_CryptoDecryptJSONObject(pLocal->pEMK_PINK, PINK, &MK, pError));
 
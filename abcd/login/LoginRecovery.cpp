@@ -11,6 +11,7 @@
 #include "LoginDir.hpp"
 #include "LoginServer.hpp"
 #include "../crypto/Crypto.hpp"
+#include "../crypto/Scrypt.hpp"
 #include "../util/Util.hpp"
 
 namespace abcd {
@@ -75,19 +76,31 @@ tABC_CC ABC_LoginRecovery(std::shared_ptr<Login> &result,
     AutoU08Buf          LRA1;
     AutoU08Buf          LRA3;
     AutoU08Buf          MK;
+    tABC_CryptoSNRP     *pServerSNRP    = NULL;
+    ScryptJob           jobLRA1;
+    ScryptJob           jobLRA3;
+
+    // LRA = L + RA:
+    ABC_BUF_STRCAT(LRA, lobby->username().c_str(), szRecoveryAnswers);
+
+    // SNRP1 is always the server SNRP, so start on LRA1 right away:
+    ABC_CHECK_RET(ABC_CryptoCreateSNRPForServer(&pServerSNRP, pError));
+    jobLRA1.start(LRA, pServerSNRP);
 
     // Get the CarePackage:
     ABC_CHECK_RET(ABC_LoginServerGetCarePackage(toU08Buf(lobby->authId()), &pCarePackage, pError));
 
-    // LRA = L + RA:
-    ABC_BUF_STRCAT(LRA, lobby->username().c_str(), szRecoveryAnswers);
+    // LRA3 only needs the CarePackage, so it can run during the next request:
+    jobLRA3.start(LRA, pCarePackage->pSNRP3);
 
     // Get the LoginPackage:
-    ABC_CHECK_RET(ABC_CryptoScryptSNRP(LRA, pCarePackage->pSNRP1, &LRA1, pError));
+    if (!jobLRA1.matches(pCarePackage->pSNRP1))
+        jobLRA1.start(LRA, pCarePackage->pSNRP1);
+    ABC_CHECK_NEW(jobLRA1.wait(LRA1), pError);
     ABC_CHECK_RET(ABC_LoginServerGetLoginPackage(toU08Buf(lobby->authId()), LP1, LRA1, &pLoginPackage, pError));
 
     // Decrypt MK:
-    ABC_CHECK_RET(ABC_CryptoScryptSNRP(LRA, pCarePackage->pSNRP3, &LRA3, pError));
+    ABC_CHECK_NEW(jobLRA3.wait(LRA3), pError);
     ABC_CHECK_RET(ABC_CryptoDecryptJSONObject(pLoginPackage->EMK_LRA3, LRA3, &MK, pError));
 
     // Decrypt SyncKey:
@@ -101,6 +114,7 @@ tABC_CC ABC_LoginRecovery(std::shared_ptr<Login> &result,
     result.reset(login.release());
 
 exit:
+    ABC_CryptoFreeSNRP(pServerSNRP);
     ABC_CarePackageFree(pCarePackage);
     ABC_LoginPackageFree(pLoginPackage);
 
@@ -102,6 +102,8 @@ exit:
 
 void ABC_DebugLog(const char * format, ...)
 {
+    // Syncs log from several threads at once, and the buffer is shared:
+    std::lock_guard<std::recursive_mutex> lock(gDebugMutex);
     static char szOut[BUF_SIZE];
     struct tm *	newtime;
     time_t		t;
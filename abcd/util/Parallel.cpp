@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace abcd {
+
+unsigned
+parallelThreads()
+{
+    unsigned out = std::thread::hardware_concurrency();
+    return out ? out : 1;
+}
+
+void
+parallelFor(size_t count, std::function<void (size_t i)> f,
+    unsigned threads, size_t minPerThread)
+{
+    if (!threads)
+        threads = parallelThreads();
+    if (!minPerThread)
+        minPerThread = 1;
+    size_t useful = count / minPerThread;
+    if (useful < threads)
+        threads = std::max<size_t>(useful, 1);
+
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            f(i);
+        return;
+    }
+
+    // Each worker pulls the next index until they are all gone:
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+            f(i);
+    };
+
+    // The calling thread does its share too:
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        // If the system is out of threads, the rest of us can cope:
+        try
+        {
+            pool.emplace_back(worker);
+        }
+        catch (const std::system_error &)
+        {
+            break;
+        }
+    }
+    worker();
+    for (auto &thread: pool)
+        thread.join();
+}
+
+} // namespace abcd
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Helpers for spreading independent work across cores.
+ */
+
+#ifndef ABCD_UTIL_PARALLEL_HPP
+#define ABCD_UTIL_PARALLEL_HPP
+
+#include <stddef.h>
+#include <functional>
+
+namespace abcd {
+
+/**
+ * Returns the number of worker threads worth starting,
+ * which is the number of cores, or 1 if that is unknown.
+ */
+unsigned
+parallelThreads();
+
+/**
+ * Calls `f(i)` once for each i in [0, count), spreading the calls
+ * across up to `threads` worker threads (0 means `parallelThreads()`).
+ * The calls may happen in any order, so they must not depend on each other.
+ * Small jobs run on the calling thread, since starting threads costs more.
+ * @param minPerThread the fewest calls worth handing to a thread.
+ */
+void
+parallelFor(size_t count, std::function<void (size_t i)> f,
+    unsigned threads=0, size_t minPerThread=1);
+
+} // namespace abcd
+
+#endif
@@ -8,38 +8,109 @@
 #include "Sync.hpp"
 #include "Util.hpp"
 #include "Mutex.hpp"
+#include "Parallel.hpp"
+#include "SyncServers.hpp"
 #include "../General.hpp"
 #include "../util/Data.hpp"
 #include "../../minilibs/git-sync/sync.h"
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <map>
 #include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
 
 namespace abcd {
 
 static bool gbInitialized = false;
+
+/**
+ * Protects the server selection.
+ * The repositories themselves have their own locks, below.
+ */
 std::recursive_mutex gSyncMutex;
 typedef std::lock_guard<std::recursive_mutex> AutoSyncLock;
 
-static char *gszCurrSyncServer = NULL;
-static int serverIdx = -1;
+/**
+ * What the core keeps for each repository path between syncs.
+ * Each repository has its own lock, so different repositories can sync
+ * at the same time, while any one repository only has one sync in flight.
+ */
+struct SyncRepoState
+{
+    std::mutex mutex;
+
+    /**
+     * An open handle, so later syncs can skip re-reading the config,
+     * refs, and pack indexes. Null until the first sync.
+     */
+    git_repository *repo = nullptr;
+
+    /**
+     * Identifies the .git directory the handle belongs to,
+     * in case somebody deletes or re-creates the repository.
+     */
+    dev_t dev = 0;
+    ino_t ino = 0;
+
+    /**
+     * Packing runs in the background, one at a time per repository.
+     * The flag is protected by the repository's lock.
+     */
+    std::thread packThread;
+    bool packing = false;
+};
 
-static tABC_CC ABC_SyncServerRot(tABC_Error *pError);
-static tABC_CC ABC_SyncGetServer(const char *szRepoKey,
+/**
+ * An account only has a few dozen repositories, so entries stay forever.
+ */
+static std::mutex gReposMutex;
+static std::map<std::string, SyncRepoState> gRepos;
+typedef std::lock_guard<std::mutex> AutoRepoLock;
+
+/**
+ * Ranks the sync servers by how well they have been doing.
+ * Protected by gSyncMutex.
+ */
+static SyncServers gServers;
+
+/**
+ * Set once the host app chooses the servers itself,
+ * so the list from the general info doesn't replace them.
+ */
+static bool gbServersPinned = false;
+
+static tABC_CC ABC_SyncServerPick(std::string &server,
+                                  const std::string &exclude,
+                                  tABC_Error *pError);
+static tABC_CC ABC_SyncGetServer(const std::string &server,
+                                 const char *szRepoKey,
                                  char **pszServer,
                                  tABC_Error *pError);
 
-#define ABC_SYNC_ROT(code, desc) \
-    { \
-        e = code; \
-        if (0 > e) \
-        { \
-            ABC_CHECK_RET(ABC_SyncServerRot(pError)); \
-            ABC_FREE_STR(szServer); \
-            ABC_CHECK_RET(ABC_SyncGetServer(szRepoKey, &szServer, pError)); \
-            e = code; \
-        } \
-        ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, desc); \
-    }
+/**
+ * Finds the state belonging to a repository.
+ */
+static SyncRepoState &
+SyncRepoFind(const char *szRepoPath)
+{
+    std::lock_guard<std::mutex> lock(gReposMutex);
+    return gRepos[szRepoPath];
+}
+
+/**
+ * Closes a repository's cached handle, if any.
+ * The caller must hold the repository's lock.
+ */
+static void
+SyncRepoClose(SyncRepoState &state)
+{
+    if (state.repo)
+        git_repository_free(state.repo);
+    state.repo = nullptr;
+}
 
 /**
  * Logs error information produced by libgit2.
@@ -88,12 +159,32 @@ exit:
  */
 void ABC_SyncTerminate()
 {
+    {
+        // Let any background packing finish:
+        std::lock_guard<std::mutex> lock(gReposMutex);
+        for (auto &repo: gRepos)
+        {
+            if (repo.second.packThread.joinable())
+                repo.second.packThread.join();
+        }
+    }
+
     if (gbInitialized)
     {
+        std::lock_guard<std::mutex> lock(gReposMutex);
+        for (auto &repo: gRepos)
+        {
+            AutoRepoLock repoLock(repo.second.mutex);
+            SyncRepoClose(repo.second);
+        }
+
         git_threads_shutdown();
         gbInitialized = false;
     }
-    ABC_FREE_STR(gszCurrSyncServer);
+
+    AutoSyncLock lock(gSyncMutex);
+    gServers.setServers(std::vector<std::string>());
+    gbServersPinned = false;
 }
 
 /**
@@ -105,7 +196,8 @@ tABC_CC ABC_SyncMakeRepo(const char *szRepoPath,
                          tABC_Error *pError)
 {
     tABC_CC cc = ABC_CC_Ok;
-    AutoSyncLock lock(gSyncMutex);
+    SyncRepoState &state = SyncRepoFind(szRepoPath);
+    AutoRepoLock lock(state.mutex);
     int e = 0;
 
     git_repository_init_options opts = GIT_REPOSITORY_INIT_OPTIONS_INIT;
@@ -120,13 +212,181 @@ exit:
     if (e < 0) SyncLogGitError(e);
     if (repo) git_repository_free(repo);
 
+    // The repository may have been deleted and re-created here,
+    // and the new .git directory can reuse the old one's inode:
+    SyncRepoClose(state);
+
+    return cc;
+}
+
+/**
+ * Finds the open handle for a repository, opening it if needed.
+ * The handle stays valid only as long as the .git directory is the same
+ * one it was opened from, so a deleted repository gets a fresh handle.
+ * The inode check can miss a re-created repository, so ABC_SyncMakeRepo
+ * drops the handle too. The caller must hold the repository's lock.
+ * @param pRepo receives the handle, which belongs to the cache.
+ */
+static
+tABC_CC ABC_SyncRepoOpen(SyncRepoState &state,
+                         const char *szRepoPath,
+                         git_repository **pRepo,
+                         tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    int e = 0;
+    struct stat st;
+    std::string gitDir = std::string(szRepoPath) + "/.git";
+
+    if (stat(gitDir.c_str(), &st))
+    {
+        SyncRepoClose(state);
+        ABC_RET_ERROR(ABC_CC_SysError, "Cannot find the repository");
+    }
+    if (state.repo && (state.dev != st.st_dev || state.ino != st.st_ino))
+        SyncRepoClose(state);
+
+    if (!state.repo)
+    {
+        e = git_repository_open(&state.repo, szRepoPath);
+        ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, "git_repository_open failed");
+        state.dev = st.st_dev;
+        state.ino = st.st_ino;
+    }
+    *pRepo = state.repo;
+
+exit:
+    if (e < 0) SyncLogGitError(e);
     return cc;
 }
 
+/**
+ * Packs a repository's loose objects and prunes the unreachable ones,
+ * logging the object store's size before and after.
+ */
+static
+tABC_CC ABC_SyncRepoPack(SyncRepoState &state,
+                         const char *szRepoPath,
+                         tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    AutoRepoLock lock(state.mutex);
+    int e = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    git_repository *repo = NULL; // Do not free
+    sync_gc_stats before, after;
+
+    ABC_CHECK_RET(ABC_SyncRepoOpen(state, szRepoPath, &repo, pError));
+    e = sync_gc_measure(repo, &before);
+    ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, "sync_gc_measure failed");
+    e = sync_gc(repo);
+    ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, "sync_gc failed");
+
+    // The handle still has the old packs open:
+    SyncRepoClose(state);
+    ABC_CHECK_RET(ABC_SyncRepoOpen(state, szRepoPath, &repo, pError));
+    e = sync_gc_measure(repo, &after);
+    ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, "sync_gc_measure failed");
+
+    ABC_DebugLog("Packed %s in %d ms: "
+        "%zu loose objects, %zu packs, %zu bytes -> "
+        "%zu loose objects, %zu packs, %zu bytes",
+        szRepoPath,
+        (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count(),
+        before.loose, before.packs, before.bytes,
+        after.loose, after.packs, after.bytes);
+
+exit:
+    if (e < 0) SyncLogGitError(e);
+    if (ABC_CC_Ok != cc) SyncRepoClose(state);
+
+    return cc;
+}
+
+/**
+ * Packs a repository in the background, unless that is already happening.
+ * The caller must hold the repository's lock.
+ * @param finished receives the previous pass's thread, which the caller
+ * must join once it has released the lock.
+ */
+static void
+SyncRepoPackStart(SyncRepoState &state, const char *szRepoPath,
+                  std::thread &finished)
+{
+    if (state.packing)
+        return;
+
+    // The previous pass is done with the lock, but may not have exited:
+    finished = std::move(state.packThread);
+
+    try
+    {
+        std::string path = szRepoPath;
+        state.packThread = std::thread([&state, path]()
+        {
+            tABC_Error error;
+            if (ABC_CC_Ok != ABC_SyncRepoPack(state, path.c_str(), &error))
+                ABC_DebugLog("Cannot pack %s: %s", path.c_str(), error.szDescription);
+
+            AutoRepoLock lock(state.mutex);
+            state.packing = false;
+        });
+        state.packing = true;
+    }
+    catch (const std::system_error &e)
+    {
+        ABC_DebugLog("Cannot start packing: %s", e.what());
+    }
+}
+
+/**
+ * Collects the changes git-sync reports into a SyncChanges list.
+ */
+static int
+SyncRecordChange(const char *path, sync_change change, void *payload)
+{
+    auto changes = static_cast<SyncChanges *>(payload);
+    SyncChange out;
+    switch (change)
+    {
+    case SYNC_CHANGE_ADDED:
+        out.type = SyncChange::added;
+        break;
+    case SYNC_CHANGE_DELETED:
+        out.type = SyncChange::deleted;
+        break;
+    default:
+        out.type = SyncChange::modified;
+        break;
+    }
+    out.path = path;
+    changes->push_back(out);
+    return 0;
+}
+
+/**
+ * Fetches from one server, recording the outcome in the server ranking.
+ */
+static int
+SyncFetch(git_repository *repo,
+          const std::string &server,
+          const char *szServer)
+{
+    auto start = SyncServers::Clock::now();
+    int e = sync_fetch(repo, szServer);
+
+    AutoSyncLock lock(gSyncMutex);
+    gServers.report(server, 0 <= e, SyncServers::Clock::now() - start);
+    return e;
+}
+
 /**
  * Synchronizes the directory with the server. New files in the folder will
  * go up to the server, and new files on the server will come down to the
  * directory. If there is a conflict, the server's file will win.
+ * Syncs of different repositories can run at the same time.
  * @param pDirty set to 1 if the sync has modified the filesystem, or 0
  * otherwise.
  */
@@ -134,26 +394,55 @@ tABC_CC ABC_SyncRepo(const char *szRepoPath,
                      const char *szRepoKey,
                      int *pDirty,
                      tABC_Error *pError)
+{
+    return ABC_SyncRepo(szRepoPath, szRepoKey, pDirty, nullptr, pError);
+}
+
+/**
+ * Synchronizes the directory with the server,
+ * also listing the files the sync added, modified, or deleted,
+ * so callers can reload just those.
+ * @param pChanges receives the changed files, if not NULL.
+ */
+tABC_CC ABC_SyncRepo(const char *szRepoPath,
+                     const char *szRepoKey,
+                     int *pDirty,
+                     SyncChanges *pChanges,
+                     tABC_Error *pError)
 {
     tABC_CC cc = ABC_CC_Ok;
-    AutoSyncLock lock(gSyncMutex);
+    SyncRepoState &state = SyncRepoFind(szRepoPath);
+    std::unique_lock<std::mutex> lock(state.mutex);
     int e = 0;
+    std::string server;
     char *szServer = NULL;
+    std::thread finished;
 
-    git_repository *repo = NULL;
+    git_repository *repo = NULL; // Do not free
     int dirty, need_push;
 
-    ABC_CHECK_RET(ABC_SyncGetServer(szRepoKey, &szServer, pError));
-
-    e = git_repository_open(&repo, szRepoPath);
-    ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, "git_repository_open failed");
+    if (pChanges)
+        pChanges->clear();
+    ABC_CHECK_RET(ABC_SyncServerPick(server, std::string(), pError));
+    ABC_CHECK_RET(ABC_SyncGetServer(server, szRepoKey, &szServer, pError));
+    ABC_CHECK_RET(ABC_SyncRepoOpen(state, szRepoPath, &repo, pError));
 
-    e = sync_fetch(repo, szServer);
-    ABC_SYNC_ROT(sync_fetch(repo, szServer), "sync_fetch failed");
+    e = SyncFetch(repo, server, szServer);
+    if (0 > e)
+    {
+        // Give the next-best server a try:
+        SyncLogGitError(e);
+        ABC_CHECK_RET(ABC_SyncServerPick(server, server, pError));
+        ABC_FREE_STR(szServer);
+        ABC_CHECK_RET(ABC_SyncGetServer(server, szRepoKey, &szServer, pError));
+        e = SyncFetch(repo, server, szServer);
+    }
+    ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, "sync_fetch failed");
 
     {
         AutoCoreLock lock(gCoreMutex);
-        e = sync_master(repo, &dirty, &need_push);
+        e = sync_master(repo, &dirty, &need_push,
+            pChanges ? SyncRecordChange : nullptr, pChanges);
     }
     ABC_CHECK_ASSERT(0 <= e, ABC_CC_SysError, "sync_master failed");
 
@@ -165,43 +454,142 @@ tABC_CC ABC_SyncRepo(const char *szRepoPath,
 
     *pDirty = dirty;
 
+    // Every sync adds objects, so pack them once they pile up:
+    if (0 < sync_gc_needed(repo))
+        SyncRepoPackStart(state, szRepoPath, finished);
+
 exit:
     if (e < 0) SyncLogGitError(e);
-    if (repo) git_repository_free(repo);
+
+    // Start from scratch next time, in case the failure left a mess:
+    if (ABC_CC_Ok != cc) SyncRepoClose(state);
 
     ABC_FREE_STR(szServer);
 
+    lock.unlock();
+    if (finished.joinable())
+        finished.join();
+
     return cc;
 }
 
 /**
- * Chooses a new server to use for syncing
+ * Packs a repository's loose objects and prunes the unreachable ones,
+ * right away and on the calling thread. Syncs do this automatically
+ * in the background once enough objects pile up.
  */
-static
-tABC_CC ABC_SyncServerRot(tABC_Error *pError)
+tABC_CC ABC_SyncPack(const char *szRepoPath,
+                     tABC_Error *pError)
+{
+    return ABC_SyncRepoPack(SyncRepoFind(szRepoPath), szRepoPath, pError);
+}
+
+/**
+ * Runs a batch of sync jobs, several at a time, using at most `threads`
+ * threads (0 means SYNC_MAX_THREADS). Each job spends most of its time
+ * waiting on the server, so running them side-by-side means the batch
+ * takes about as long as its slowest job, rather than the sum of them all.
+ * Every job runs, even if some of the others fail.
+ * @param aDirty an array with one slot per job,
+ * which receives that job's dirty flag.
+ * @return the first failure, in job order.
+ */
+tABC_CC ABC_SyncBatch(const std::vector<SyncJob> &jobs,
+                      int *aDirty,
+                      unsigned threads,
+                      tABC_Error *pError)
 {
     tABC_CC cc = ABC_CC_Ok;
-    AutoSyncLock lock(gSyncMutex);
-    tABC_GeneralInfo *pInfo = NULL;
+    std::vector<tABC_CC> results(jobs.size(), ABC_CC_Ok);
+    std::vector<tABC_Error> errors(jobs.size());
 
-    ABC_CHECK_RET(ABC_GeneralGetInfo(&pInfo, pError));
+    ABC_CHECK_NULL(aDirty);
+    if (!threads)
+        threads = SYNC_MAX_THREADS;
 
-    if (serverIdx == -1)
+    parallelFor(jobs.size(), [&](size_t i)
     {
-        // Choose a random server to start with
-        srand((unsigned) time(NULL));
-        serverIdx = rand() % pInfo->countSyncServers;
-    }
-    else
+        aDirty[i] = 0;
+        results[i] = jobs[i](&aDirty[i], &errors[i]);
+    }, threads);
+
+    for (size_t i = 0; i < jobs.size(); ++i)
     {
-        serverIdx++;
+        if (ABC_CC_Ok != results[i])
+        {
+            if (pError)
+                *pError = errors[i];
+            cc = results[i];
+            goto exit;
+        }
     }
-    if (serverIdx >= (int)pInfo->countSyncServers)
+
+exit:
+    return cc;
+}
+
+/**
+ * Makes all future syncs go to the given server.
+ * Mainly useful for testing against a local server.
+ */
+tABC_CC ABC_SyncSetServer(const char *szServer,
+                          tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+
+    ABC_CHECK_NULL(szServer);
+    ABC_CHECK_RET(ABC_SyncSetServers(std::vector<std::string>{szServer}, pError));
+
+exit:
+    return cc;
+}
+
+/**
+ * Makes all future syncs use the given servers,
+ * instead of the ones from the general info.
+ * Mainly useful for testing against several local servers.
+ */
+tABC_CC ABC_SyncSetServers(const std::vector<std::string> &servers,
+                           tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    AutoSyncLock lock(gSyncMutex);
+
+    ABC_CHECK_ASSERT(!servers.empty(), ABC_CC_Error, "No sync servers");
+    gServers.setServers(servers);
+    gbServersPinned = true;
+
+exit:
+    return cc;
+}
+
+/**
+ * Chooses the server for the next sync, preferring the fastest
+ * healthy one. The server list comes from the general info,
+ * and gets refreshed whenever a sync has to fall back.
+ *
+ * @param exclude A server that just failed, or empty.
+ */
+static
+tABC_CC ABC_SyncServerPick(std::string &server,
+                           const std::string &exclude,
+                           tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    AutoSyncLock lock(gSyncMutex);
+    tABC_GeneralInfo *pInfo = NULL;
+
+    if (!gbServersPinned && (gServers.empty() || !exclude.empty()))
     {
-        serverIdx = 0;
+        ABC_CHECK_RET(ABC_GeneralGetInfo(&pInfo, pError));
+        gServers.setServers(std::vector<std::string>(pInfo->aszSyncServers,
+            pInfo->aszSyncServers + pInfo->countSyncServers));
     }
-    ABC_FREE_STR(gszCurrSyncServer);
-    ABC_STRDUP(gszCurrSyncServer, pInfo->aszSyncServers[serverIdx]);
+
+    server = gServers.pick(SyncServers::Clock::now(), exclude);
+    ABC_CHECK_ASSERT(!server.empty(),
+        ABC_CC_SysError, "Unable to find a sync server");
+
 exit:
     ABC_GeneralFreeInfo(pInfo);
 
@@ -209,29 +597,24 @@ exit:
 }
 
 /**
- * Using the settings pick a repo and create the repo URI.
+ * Creates the repo URI on the given server.
  *
  * @param szRepoKey    The repo key.
  * @param pszServer    Pointer to pointer where the resulting server URI
  *                     will be stored. Caller must free.
  */
 static
-tABC_CC ABC_SyncGetServer(const char *szRepoKey, char **pszServer, tABC_Error *pError)
+tABC_CC ABC_SyncGetServer(const std::string &server,
+                          const char *szRepoKey,
+                          char **pszServer,
+                          tABC_Error *pError)
 {
     tABC_CC cc = ABC_CC_Ok;
-    AutoSyncLock lock(gSyncMutex);
     AutoU08Buf URL;
 
     ABC_CHECK_NULL(szRepoKey);
 
-    if (!gszCurrSyncServer)
-    {
-        ABC_CHECK_RET(ABC_SyncServerRot(pError));
-    }
-    ABC_CHECK_ASSERT(gszCurrSyncServer != NULL,
-        ABC_CC_SysError, "Unable to find a sync server");
-
-    ABC_BUF_DUP_PTR(URL, gszCurrSyncServer, strlen(gszCurrSyncServer));
+    ABC_BUF_DUP_PTR(URL, server.c_str(), server.size());
 
     // Do we have a trailing slash?
     if (URL.p[URL.end - URL.p - 1] != '/')
@@ -13,9 +13,19 @@
 #define ABC_Sync_h
 
 #include "../../src/ABC.h"
+#include <functional>
+#include <string>
+#include <vector>
 
 #define SYNC_KEY_LENGTH 20
 
+/**
+ * The most repositories `ABC_SyncBatch` will sync at once.
+ * Syncing is mostly network round-trips, so this can exceed the core count,
+ * but each thread holds a server connection.
+ */
+#define SYNC_MAX_THREADS 8
+
 namespace abcd {
 
 tABC_CC ABC_SyncInit(const char *szCaCertPath, tABC_Error *pError);
@@ -25,11 +35,59 @@ void ABC_SyncTerminate();
 tABC_CC ABC_SyncMakeRepo(const char *szRepoPath,
                          tABC_Error *pError);
 
+/**
+ * A file that a sync changed in the working directory.
+ */
+struct SyncChange
+{
+    enum Type
+    {
+        added,
+        modified,
+        deleted
+    };
+
+    Type type;
+
+    /**
+     * Relative to the repository root, using forward slashes.
+     */
+    std::string path;
+};
+
+typedef std::vector<SyncChange> SyncChanges;
+
+tABC_CC ABC_SyncRepo(const char *szRepoPath,
+                     const char *szRepoKey,
+                     int *pDirty,
+                     tABC_Error *pError);
+
 tABC_CC ABC_SyncRepo(const char *szRepoPath,
                      const char *szRepoKey,
                      int *pDirty,
+                     SyncChanges *pChanges,
                      tABC_Error *pError);
 
+tABC_CC ABC_SyncPack(const char *szRepoPath,
+                     tABC_Error *pError);
+
+/**
+ * Syncs one repository as part of a batch,
+ * setting `*pDirty` if the sync modified the filesystem.
+ */
+typedef std::function<tABC_CC (int *pDirty, tABC_Error *pError)> SyncJob;
+
+tABC_CC ABC_SyncBatch(const std::vector<SyncJob> &jobs,
+                      int *aDirty,
+                      unsigned threads,
+                      tABC_Error *pError);
+
+tABC_CC ABC_SyncSetServer(const char *szServer,
+                          tABC_Error *pError);
+
+tABC_CC ABC_SyncSetServers(const std::vector<std::string> &servers,
+                           tABC_Error *pError);
+
 } // namespace abcd
 
 #endif
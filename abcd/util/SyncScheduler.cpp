@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "SyncScheduler.hpp"
+#include "Debug.hpp"
+#include <algorithm>
+#include <system_error>
+
+namespace abcd {
+
+SyncScheduler::~SyncScheduler()
+{
+    stop();
+}
+
+SyncScheduler::SyncScheduler(std::chrono::milliseconds minDelay,
+    std::chrono::milliseconds maxDelay, unsigned threads):
+    minDelay_(minDelay),
+    maxDelay_(std::max(minDelay, maxDelay)),
+    threadCount_(std::max(threads, 1u)),
+    stop_(false)
+{
+}
+
+void
+SyncScheduler::start(ChangeCallback onChange)
+{
+    if (!threads_.empty())
+        return;
+    onChange_ = onChange;
+
+    try
+    {
+        while (threads_.size() < threadCount_)
+            threads_.push_back(std::thread(&SyncScheduler::run, this));
+    }
+    catch (const std::system_error &e)
+    {
+        // Fewer threads still work, and with none,
+        // the host app's own sync calls still work without us:
+        ABC_DebugLog("Cannot start a sync scheduler thread: %s", e.what());
+    }
+}
+
+void
+SyncScheduler::add(const std::string &name, SyncJob job)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto i = repos_.find(name);
+    if (i != repos_.end())
+    {
+        i->second.job = job;
+    }
+    else
+    {
+        Repo repo;
+        repo.job = job;
+        repo.due = Clock::now();
+        repo.delay = minDelay_;
+        repo.busy = false;
+        repo.again = false;
+        repos_[name] = repo;
+    }
+    wake_.notify_one();
+}
+
+void
+SyncScheduler::remove(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    repos_.erase(name);
+}
+
+void
+SyncScheduler::retain(const std::set<std::string> &names)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto i = repos_.begin(); i != repos_.end(); )
+    {
+        if (names.count(i->first))
+            ++i;
+        else
+            i = repos_.erase(i);
+    }
+}
+
+void
+SyncScheduler::request(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto i = repos_.find(name);
+    if (i == repos_.end())
+        return;
+
+    // A running sync might have missed the change, so go once more:
+    if (i->second.busy)
+        i->second.again = true;
+    else
+        i->second.due = Clock::now();
+    i->second.delay = minDelay_;
+    wake_.notify_one();
+}
+
+void
+SyncScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        wake_.notify_all();
+    }
+    for (auto &thread: threads_)
+        thread.join();
+    threads_.clear();
+}
+
+void
+SyncScheduler::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_)
+    {
+        // Find the most overdue idle repository, and see when the rest will be:
+        auto now = Clock::now();
+        auto next = Clock::time_point::max();
+        auto pick = repos_.end();
+        for (auto i = repos_.begin(); i != repos_.end(); ++i)
+        {
+            Repo &repo = i->second;
+            if (repo.busy)
+                continue;
+            if (repo.due <= now)
+            {
+                if (pick == repos_.end() || repo.due < pick->second.due)
+                    pick = i;
+            }
+            else if (repo.due < next)
+            {
+                next = repo.due;
+            }
+        }
+
+        if (pick == repos_.end())
+        {
+            if (next == Clock::time_point::max())
+                wake_.wait(lock);
+            else
+                wake_.wait_until(lock, next);
+            continue;
+        }
+
+        std::string name = pick->first;
+        SyncJob job = pick->second.job;
+        pick->second.busy = true;
+        pick->second.again = false;
+
+        // Sync without the lock, so requests and other syncs can go meanwhile:
+        lock.unlock();
+        int dirty = 0;
+        tABC_Error error;
+        if (ABC_CC_Ok != job(&dirty, &error))
+            ABC_DebugLog("Background sync of %s failed: %s",
+                name.c_str(), error.szDescription);
+        lock.lock();
+
+        // Reschedule, backing off if there was no news:
+        auto i = repos_.find(name);
+        bool known = i != repos_.end();
+        if (known)
+        {
+            Repo &repo = i->second;
+            repo.busy = false;
+            if (dirty)
+                repo.delay = minDelay_;
+            else if (!repo.again)
+                repo.delay = std::min(repo.delay * 2, maxDelay_);
+            repo.due = repo.again ? Clock::now() : Clock::now() + repo.delay;
+        }
+
+        if (dirty && known)
+        {
+            lock.unlock();
+            onChange_(name);
+            lock.lock();
+        }
+    }
+}
+
+} // namespace abcd
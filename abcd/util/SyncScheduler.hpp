@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Background scheduling for repository syncs.
+ */
+
+#ifndef ABCD_UTIL_SYNC_SCHEDULER_HPP
+#define ABCD_UTIL_SYNC_SCHEDULER_HPP
+
+#include "Sync.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace abcd {
+
+/**
+ * Keeps a set of repositories in sync from a few background threads.
+ *
+ * A repository with a pending request syncs right away.
+ * Otherwise, a repository syncs on a timer, which starts at `minDelay`
+ * and doubles after every sync that finds nothing new, up to `maxDelay`.
+ * A sync that changes something resets the timer.
+ *
+ * Requests coalesce: any number of requests made before a sync starts
+ * lead to one sync, and any number made during a sync lead to one more.
+ * Each thread takes one due repository at a time, so a slow or
+ * unreachable server only holds up the thread that is waiting on it.
+ */
+class SyncScheduler
+{
+public:
+    /**
+     * Receives the name of each repository whose sync changed files.
+     * This runs on one of the scheduler's threads, outside its lock,
+     * so it may call `add`, `remove`, `retain` or `request`,
+     * but not `stop`.
+     */
+    typedef std::function<void (const std::string &name)> ChangeCallback;
+
+    ~SyncScheduler();
+    SyncScheduler(std::chrono::milliseconds minDelay,
+        std::chrono::milliseconds maxDelay,
+        unsigned threads=SYNC_MAX_THREADS);
+
+    /**
+     * Starts the background threads.
+     * Nothing syncs before this, so repositories can be added first.
+     */
+    void
+    start(ChangeCallback onChange);
+
+    /**
+     * Adds a repository to the schedule, and syncs it right away.
+     * Adding an existing name replaces its job.
+     */
+    void
+    add(const std::string &name, SyncJob job);
+
+    /**
+     * Takes a repository off the schedule.
+     * A sync that is already running will still finish.
+     */
+    void
+    remove(const std::string &name);
+
+    /**
+     * Takes every repository not in the list off the schedule,
+     * such as wallets that have left the account.
+     */
+    void
+    retain(const std::set<std::string> &names);
+
+    /**
+     * Asks for a repository to sync soon, typically after a local change.
+     */
+    void
+    request(const std::string &name);
+
+    /**
+     * Stops the threads, waiting for any running syncs to finish.
+     */
+    void
+    stop();
+
+    SyncScheduler(const SyncScheduler &copy) = delete;
+    SyncScheduler &operator=(const SyncScheduler &copy) = delete;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Repo
+    {
+        SyncJob job;
+        Clock::time_point due;
+        Clock::duration delay;
+        bool busy;
+        bool again;
+    };
+
+    ChangeCallback onChange_;
+    Clock::duration minDelay_;
+    Clock::duration maxDelay_;
+    unsigned threadCount_;
+
+    // Everything below here is protected by the mutex:
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::map<std::string, Repo> repos_;
+    bool stop_;
+
+    std::vector<std::thread> threads_;
+
+    void run();
+};
+
+} // namespace abcd
+
+#endif
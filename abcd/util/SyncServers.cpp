@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "SyncServers.hpp"
+#include <time.h>
+#include <algorithm>
+#include <random>
+
+namespace abcd {
+
+/**
+ * How much each new sample moves the rolling averages.
+ */
+constexpr double sampleWeight = 0.3;
+
+/**
+ * Servers with a rolling error rate above this are unhealthy.
+ * One failure is enough, but one success afterwards brings it back.
+ */
+constexpr double maxErrors = 0.25;
+
+SyncServers::SyncServers(Clock::duration reprobe):
+    reprobe_(reprobe)
+{
+}
+
+void
+SyncServers::setServers(const std::vector<std::string> &servers)
+{
+    std::vector<Stats> stats;
+    for (const auto &server: servers)
+    {
+        auto i = std::find_if(stats_.begin(), stats_.end(),
+            [&](const Stats &s) { return s.server == server; });
+        if (i != stats_.end())
+        {
+            stats.push_back(*i);
+        }
+        else
+        {
+            Stats fresh;
+            fresh.server = server;
+            stats.push_back(fresh);
+        }
+    }
+
+    // Spread clients across the servers nobody has tried yet:
+    std::shuffle(stats.begin(), stats.end(),
+        std::default_random_engine(time(nullptr)));
+    stats_ = stats;
+}
+
+std::string
+SyncServers::pick(Clock::time_point now, const std::string &exclude)
+{
+    Stats *probe = nullptr;
+    Stats *best = nullptr;
+    for (auto &stats: stats_)
+    {
+        if (stats.server == exclude && 1 < stats_.size())
+            continue;
+
+        // Servers nobody has picked lately need fresh numbers:
+        if (!stats.picked || reprobe_ <= now - stats.lastPick)
+        {
+            if (!probe || (probe->picked &&
+                (!stats.picked || stats.lastPick < probe->lastPick)))
+                probe = &stats;
+        }
+
+        if (!best || better(stats, *best))
+            best = &stats;
+    }
+
+    Stats *out = probe ? probe : best;
+    if (!out)
+        return std::string();
+
+    out->probing = out == probe && out->tried;
+    out->picked = true;
+    out->lastPick = now;
+    return out->server;
+}
+
+void
+SyncServers::report(const std::string &server, bool ok, Clock::duration latency)
+{
+    for (auto &stats: stats_)
+    {
+        if (stats.server != server)
+            continue;
+
+        if (!stats.tried || stats.probing)
+        {
+            stats.latency = latency;
+            stats.errors = ok ? 0 : 1;
+        }
+        else
+        {
+            if (ok)
+                stats.latency += std::chrono::duration_cast<Clock::duration>(
+                    (latency - stats.latency) * sampleWeight);
+            stats.errors += ((ok ? 0 : 1) - stats.errors) * sampleWeight;
+        }
+        stats.tried = true;
+        stats.probing = false;
+    }
+}
+
+bool
+SyncServers::healthy(const Stats &stats) const
+{
+    return stats.errors <= maxErrors;
+}
+
+/**
+ * Orders servers from best to worst: healthy ones by latency,
+ * then unhealthy ones by error rate, then ones with no results yet.
+ */
+bool
+SyncServers::better(const Stats &a, const Stats &b) const
+{
+    if (a.tried != b.tried)
+        return a.tried;
+    if (!a.tried)
+        return a.lastPick < b.lastPick;
+    if (healthy(a) != healthy(b))
+        return healthy(a);
+    if (healthy(a))
+        return a.latency < b.latency;
+    return a.errors < b.errors;
+}
+
+} // namespace abcd
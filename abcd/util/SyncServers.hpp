@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Ranking of sync servers by how well they have been performing.
+ */
+
+#ifndef ABCD_UTIL_SYNC_SERVERS_HPP
+#define ABCD_UTIL_SYNC_SERVERS_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace abcd {
+
+/**
+ * Keeps rolling fetch latency and error statistics for each sync server,
+ * and picks the fastest healthy one.
+ *
+ * Servers that have never been tried go first, in random order,
+ * so clients spread out. After that, a server that nobody has picked
+ * for `reprobe` gets one sync, so a slow or failing server can earn
+ * its way back once it recovers.
+ *
+ * This class is not thread-safe, so the caller must provide locking.
+ */
+class SyncServers
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit SyncServers(Clock::duration reprobe = std::chrono::minutes(5));
+
+    /**
+     * Replaces the list of servers.
+     * Servers that remain on the list keep their statistics.
+     */
+    void
+    setServers(const std::vector<std::string> &servers);
+
+    bool
+    empty() const { return stats_.empty(); }
+
+    /**
+     * Chooses a server for the next sync.
+     * @param exclude a server to avoid, typically one that just failed,
+     * unless it is the only one.
+     */
+    std::string
+    pick(Clock::time_point now, const std::string &exclude = "");
+
+    /**
+     * Records how a fetch went.
+     * The latency only counts for successful fetches.
+     * The first result from a re-probe replaces the stale statistics.
+     */
+    void
+    report(const std::string &server, bool ok, Clock::duration latency);
+
+private:
+    struct Stats
+    {
+        std::string server;
+        bool tried = false;
+        bool picked = false;
+        bool probing = false;
+        Clock::time_point lastPick;
+        Clock::duration latency = Clock::duration::zero();
+        double errors = 0;
+    };
+
+    Clock::duration reprobe_;
+    std::vector<Stats> stats_;
+
+    bool
+    healthy(const Stats &stats) const;
+
+    bool
+    better(const Stats &a, const Stats &b) const;
+};
+
+} // namespace abcd
+
+#endif
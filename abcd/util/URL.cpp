@@ -38,17 +38,38 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <curl/curl.h>
+#include <openssl/crypto.h>
 #include <openssl/ssl.h>
+#include <pthread.h>
+#include <condition_variable>
+#include <vector>
 
 namespace abcd {
 
 #define URL_CONN_TIMEOUT 10
 
+// Give up on transfers that stall below 1 byte/s for this many seconds:
+#define URL_LOW_SPEED_TIME 30
+
+// How long ABC_URLTerminate waits beyond the background request timeout:
+#define URL_TERMINATE_GRACE 5
+
 static char *gszCaCertPath = NULL;
 static bool gbInitialized = false;
 std::recursive_mutex gCurlMutex;
 
+// OpenSSL needs these locks to be used from more than one thread:
+static std::vector<std::mutex> gSSLLocks;
+static bool gbSSLLocks = false;
+
+// Requests running on detached threads, which must finish before cleanup:
+static std::mutex gBackgroundMutex;
+static std::condition_variable gBackgroundDone;
+static size_t gBackgroundCount = 0;
+
 static CURLcode ABC_URLSSLCallback(CURL *curl, void *ssl_ctx, void *userptr);
+static void     ABC_URLSSLLock(int mode, int n, const char *file, int line);
+static unsigned long ABC_URLSSLThreadId();
 static size_t   ABC_URLCurlWriteData(void *pBuffer, size_t memberSize, size_t numMembers, void *pUserData);
 
 /**
@@ -73,6 +94,15 @@ tABC_CC ABC_URLInitialize(const char *szCaCertPath, tABC_Error *pError)
         ABC_STRDUP(gszCaCertPath, szCaCertPath);
     }
 
+    // Make OpenSSL thread-safe, unless somebody else already has:
+    if (!CRYPTO_get_locking_callback())
+    {
+        gSSLLocks = std::vector<std::mutex>(CRYPTO_num_locks());
+        CRYPTO_set_id_callback(ABC_URLSSLThreadId);
+        CRYPTO_set_locking_callback(ABC_URLSSLLock);
+        gbSSLLocks = true;
+    }
+
     gbInitialized = true;
 
 exit:
@@ -87,15 +117,64 @@ void ABC_URLTerminate()
 {
     if (gbInitialized == true)
     {
-        // cleanup curl
-        curl_global_cleanup();
+        // wait for background requests, since they still use curl
+        bool idle;
+        {
+            std::unique_lock<std::mutex> lock(gBackgroundMutex);
+            idle = gBackgroundDone.wait_for(lock,
+                std::chrono::seconds(ABC_URL_BACKGROUND_TIMEOUT + URL_TERMINATE_GRACE),
+                []() { return !gBackgroundCount; });
+        }
 
-        ABC_FREE_STR(gszCaCertPath);
+        // If a request is somehow still stuck, leak the curl and OpenSSL
+        // state rather than pulling it out from under that thread:
+        if (idle)
+        {
+            // cleanup curl
+            curl_global_cleanup();
+
+            // uninstall our OpenSSL locks before freeing them
+            if (gbSSLLocks)
+            {
+                CRYPTO_set_locking_callback(NULL);
+                CRYPTO_set_id_callback(NULL);
+                std::vector<std::mutex>().swap(gSSLLocks);
+                gbSSLLocks = false;
+            }
+
+            ABC_FREE_STR(gszCaCertPath);
+        }
+        else
+        {
+            ABC_DebugLog("Background requests still running at shutdown\n");
+        }
 
         gbInitialized = false;
     }
 }
 
+/**
+ * Registers a request that will run on a detached thread.
+ * Call this before starting the thread, and have the thread call
+ * ABC_URLBackgroundDone once it no longer touches curl or the logs.
+ * The request must set CURLOPT_TIMEOUT to ABC_URL_BACKGROUND_TIMEOUT.
+ */
+void ABC_URLBackgroundStart()
+{
+    std::lock_guard<std::mutex> lock(gBackgroundMutex);
+    ++gBackgroundCount;
+}
+
+/**
+ * Marks a background request as finished.
+ */
+void ABC_URLBackgroundDone()
+{
+    std::lock_guard<std::mutex> lock(gBackgroundMutex);
+    --gBackgroundCount;
+    gBackgroundDone.notify_all();
+}
+
 /**
  * Makes a URL request.
  * @param szURL         The request URL.
@@ -194,6 +273,21 @@ CURLcode ABC_URLSSLCallback(CURL *curl, void *ssl_ctx, void *userptr)
     return CURLE_OK;
 }
 
+static
+void ABC_URLSSLLock(int mode, int n, const char *file, int line)
+{
+    if (mode & CRYPTO_LOCK)
+        gSSLLocks[n].lock();
+    else
+        gSSLLocks[n].unlock();
+}
+
+static
+unsigned long ABC_URLSSLThreadId()
+{
+    return (unsigned long)pthread_self();
+}
+
 /**
  * Makes a URL post request.
  *
@@ -337,6 +431,11 @@ tABC_CC ABC_URLCurlHandleInit(CURL **ppCurlHandle, tABC_Error *pError)
     curlCode = curl_easy_setopt(pCurlHandle, CURLOPT_CONNECTTIMEOUT, URL_CONN_TIMEOUT);
     ABC_CHECK_ASSERT(curlCode == 0, ABC_CC_Error, "Unable to set connection timeout");
 
+    curlCode = curl_easy_setopt(pCurlHandle, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    ABC_CHECK_ASSERT(curlCode == 0, ABC_CC_Error, "Unable to set low speed limit");
+    curlCode = curl_easy_setopt(pCurlHandle, CURLOPT_LOW_SPEED_TIME, (long)URL_LOW_SPEED_TIME);
+    ABC_CHECK_ASSERT(curlCode == 0, ABC_CC_Error, "Unable to set low speed time");
+
     *ppCurlHandle = pCurlHandle;
 exit:
     return cc;
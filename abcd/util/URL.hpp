@@ -49,10 +49,18 @@ typedef std::lock_guard<std::recursive_mutex> AutoCurlLock;
 
 #define ABC_URL_MAX_PATH_LENGTH 2048
 
+// Background requests must give up within this many seconds,
+// since ABC_URLTerminate only waits so long for them:
+#define ABC_URL_BACKGROUND_TIMEOUT 30
+
 tABC_CC ABC_URLInitialize(const char *szCaCertPath, tABC_Error *pError);
 
 void ABC_URLTerminate();
 
+void ABC_URLBackgroundStart();
+
+void ABC_URLBackgroundDone();
+
 tABC_CC ABC_URLRequest(const char *szURL,
                        tABC_U08Buf *pData,
                        tABC_Error *pError);
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * A tiny micro-benchmark registry.
+ */
+
+#ifndef BENCH_BENCH_HPP
+#define BENCH_BENCH_HPP
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+
+/**
+ * Runs the code under test `iterations` times.
+ * The whole call is timed, so expensive fixtures belong in statics.
+ */
+typedef std::function<void (size_t iterations)> BenchFunction;
+
+/**
+ * Adds a benchmark to the global list, typically from a static initializer.
+ * @param bytes the amount of data one iteration processes,
+ * for reporting throughput, or 0 if that doesn't apply.
+ */
+struct BenchRegistration
+{
+    BenchRegistration(const char *name, BenchFunction f, size_t bytes=0);
+};
+
+/**
+ * Marks the running benchmark as skipped, for code that turns out
+ * not to work on this machine. The harness stops running it.
+ */
+void
+benchSkip();
+
+/**
+ * Creates a scratch directory, which the harness deletes
+ * once every benchmark has run.
+ */
+std::string
+benchTempDir();
+
+#define BENCH_CONCAT2(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT2(a, b)
+
+/**
+ * Declares a benchmark function, which receives a `size_t iterations`.
+ */
+#define BENCH(name) \
+    static void BENCH_CONCAT(bench_, __LINE__)(size_t iterations); \
+    static BenchRegistration BENCH_CONCAT(benchReg_, __LINE__)( \
+        name, BENCH_CONCAT(bench_, __LINE__)); \
+    static void BENCH_CONCAT(bench_, __LINE__)(size_t iterations)
+
+/**
+ * Declares a benchmark that processes `bytes` of data per iteration.
+ */
+#define BENCH_BYTES(name, bytes) \
+    static void BENCH_CONCAT(bench_, __LINE__)(size_t iterations); \
+    static BenchRegistration BENCH_CONCAT(benchReg_, __LINE__)( \
+        name, BENCH_CONCAT(bench_, __LINE__), bytes); \
+    static void BENCH_CONCAT(bench_, __LINE__)(size_t iterations)
+
+#endif
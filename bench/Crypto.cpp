@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Bench.hpp"
+#include "../abcd/crypto/Crypto.hpp"
+#include "../abcd/crypto/Random.hpp"
+#include <openssl/rand.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+static const abcd::DataChunk key(AES_256_KEY_LENGTH, 0x5a);
+
+/**
+ * Encrypts a buffer of the given size into the JSON package format.
+ */
+static void
+benchEncrypt(size_t iterations, size_t size)
+{
+    abcd::DataChunk data(size, 0xa5);
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        json_t *package = nullptr;
+        tABC_Error error;
+        abcd::ABC_CryptoEncryptJSONObject(abcd::toU08Buf(data),
+            abcd::toU08Buf(key), abcd::ABC_CryptoType_AES256,
+            &package, &error);
+        json_decref(package);
+    }
+}
+
+/**
+ * Decrypts a JSON package holding a buffer of the given size.
+ */
+static void
+benchDecrypt(size_t iterations, size_t size)
+{
+    abcd::DataChunk data(size, 0xa5);
+    json_t *package = nullptr;
+    tABC_Error error;
+    abcd::ABC_CryptoEncryptJSONObject(abcd::toU08Buf(data),
+        abcd::toU08Buf(key), abcd::ABC_CryptoType_AES256, &package, &error);
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        abcd::AutoU08Buf out;
+        abcd::ABC_CryptoDecryptJSONObject(package, abcd::toU08Buf(key),
+            &out, &error);
+    }
+    json_decref(package);
+}
+
+BENCH_BYTES("aes encrypt 64B", 64)          { benchEncrypt(iterations, 64); }
+BENCH_BYTES("aes encrypt 256B", 256)        { benchEncrypt(iterations, 256); }
+BENCH_BYTES("aes encrypt 1KB", 1024)        { benchEncrypt(iterations, 1024); }
+BENCH_BYTES("aes encrypt 2KB", 2048)        { benchEncrypt(iterations, 2048); }
+BENCH_BYTES("aes encrypt 64KB", 65536)      { benchEncrypt(iterations, 65536); }
+BENCH_BYTES("aes encrypt 1MB", 1 << 20)     { benchEncrypt(iterations, 1 << 20); }
+BENCH_BYTES("aes decrypt 64B", 64)          { benchDecrypt(iterations, 64); }
+BENCH_BYTES("aes decrypt 256B", 256)        { benchDecrypt(iterations, 256); }
+BENCH_BYTES("aes decrypt 1KB", 1024)        { benchDecrypt(iterations, 1024); }
+BENCH_BYTES("aes decrypt 2KB", 2048)        { benchDecrypt(iterations, 2048); }
+BENCH_BYTES("aes decrypt 64KB", 65536)      { benchDecrypt(iterations, 65536); }
+BENCH_BYTES("aes decrypt 1MB", 1 << 20)     { benchDecrypt(iterations, 1 << 20); }
+
+/**
+ * A wallet's worth of small encrypted files, written once per run.
+ */
+static const std::vector<std::string> &
+walletFiles()
+{
+    static std::vector<std::string> out;
+    if (out.empty())
+    {
+        std::string dir = benchTempDir();
+        for (int i = 0; i < 500; ++i)
+        {
+            out.push_back(dir + "/" + std::to_string(i));
+            abcd::DataChunk data(600 + i % 1000, 'x');
+            tABC_Error error;
+            abcd::ABC_CryptoEncryptJSONFile(abcd::toU08Buf(data),
+                abcd::toU08Buf(key), abcd::ABC_CryptoType_AES256,
+                out.back().c_str(), &error);
+        }
+    }
+    return out;
+}
+
+BENCH("decrypt 500 files one by one")
+{
+    const auto &files = walletFiles();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        for (const auto &file: files)
+        {
+            abcd::AutoU08Buf out;
+            tABC_Error error;
+            abcd::ABC_CryptoDecryptJSONFile(file.c_str(),
+                abcd::toU08Buf(key), &out, &error);
+        }
+    }
+}
+
+static void
+benchDecryptFiles(size_t iterations, unsigned threads)
+{
+    const auto &files = walletFiles();
+    std::vector<const char *> names;
+    for (const auto &file: files)
+        names.push_back(file.c_str());
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        std::vector<json_t *> out(names.size());
+        tABC_Error error;
+        abcd::ABC_CryptoDecryptJSONFiles(names.data(), names.size(),
+            abcd::toU08Buf(key), out.data(), threads, &error);
+        for (auto json: out)
+            json_decref(json);
+    }
+}
+
+BENCH("decrypt 500 files batched")  { benchDecryptFiles(iterations, 1); }
+BENCH("decrypt 500 files parallel") { benchDecryptFiles(iterations, 0); }
+
+BENCH("cryptoFilename")
+{
+    for (size_t i = 0; i < iterations; ++i)
+        abcd::cryptoFilename(key, "Transactions/" + std::to_string(i));
+}
+
+BENCH("cryptoFilename hot")
+{
+    // A plugin reading a handful of keys over and over:
+    static const std::string names[] = {"plugin", "settings", "prefs", "cards"};
+    for (size_t i = 0; i < iterations; ++i)
+        abcd::cryptoFilename(key, names[i % 4]);
+}
+
+static void
+benchRandom(size_t iterations, size_t size)
+{
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        abcd::DataChunk out;
+        abcd::randomData(out, size);
+    }
+}
+
+BENCH_BYTES("randomData 1B", 1)             { benchRandom(iterations, 1); }
+BENCH_BYTES("randomData 16B", 16)           { benchRandom(iterations, 16); }
+BENCH_BYTES("randomData 32B", 32)           { benchRandom(iterations, 32); }
+BENCH_BYTES("randomData 4KB", 4096)         { benchRandom(iterations, 4096); }
+
+BENCH_BYTES("RAND_bytes 16B", 16)
+{
+    unsigned char out[16];
+    for (size_t i = 0; i < iterations; ++i)
+        RAND_bytes(out, sizeof(out));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Bench.hpp"
+#include "../abcd/crypto/Encoding.hpp"
+
+/**
+ * Deterministic test data of the given size.
+ */
+static abcd::DataChunk
+testData(size_t size)
+{
+    abcd::DataChunk out(size);
+    for (size_t i = 0; i < size; ++i)
+        out[i] = i * 131 + 7;
+    return out;
+}
+
+static void
+benchBase16Encode(size_t iterations, size_t size)
+{
+    const auto data = testData(size);
+    for (size_t i = 0; i < iterations; ++i)
+        abcd::base16Encode(data);
+}
+
+static void
+benchBase16Decode(size_t iterations, size_t size)
+{
+    const auto text = abcd::base16Encode(testData(size));
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        abcd::DataChunk out;
+        abcd::base16Decode(out, text);
+    }
+}
+
+static void
+benchBase64Encode(size_t iterations, size_t size)
+{
+    const auto data = testData(size);
+    for (size_t i = 0; i < iterations; ++i)
+        abcd::base64Encode(data);
+}
+
+static void
+benchBase64Decode(size_t iterations, size_t size)
+{
+    const auto text = abcd::base64Encode(testData(size));
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        abcd::DataChunk out;
+        abcd::base64Decode(out, text);
+    }
+}
+
+BENCH_BYTES("base16 encode 32B", 32)        { benchBase16Encode(iterations, 32); }
+BENCH_BYTES("base16 encode 1KB", 1024)      { benchBase16Encode(iterations, 1024); }
+BENCH_BYTES("base16 encode 64KB", 65536)    { benchBase16Encode(iterations, 65536); }
+BENCH_BYTES("base16 decode 32B", 32)        { benchBase16Decode(iterations, 32); }
+BENCH_BYTES("base16 decode 1KB", 1024)      { benchBase16Decode(iterations, 1024); }
+BENCH_BYTES("base16 decode 64KB", 65536)    { benchBase16Decode(iterations, 65536); }
+BENCH_BYTES("base64 encode 32B", 32)        { benchBase64Encode(iterations, 32); }
+BENCH_BYTES("base64 encode 1KB", 1024)      { benchBase64Encode(iterations, 1024); }
+BENCH_BYTES("base64 encode 64KB", 65536)    { benchBase64Encode(iterations, 65536); }
+BENCH_BYTES("base64 decode 32B", 32)        { benchBase64Decode(iterations, 32); }
+BENCH_BYTES("base64 decode 1KB", 1024)      { benchBase64Decode(iterations, 1024); }
+BENCH_BYTES("base64 decode 64KB", 65536)    { benchBase64Decode(iterations, 65536); }
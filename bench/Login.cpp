@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Bench.hpp"
+#include "../abcd/crypto/Scrypt.hpp"
+#include <chrono>
+#include <thread>
+
+/**
+ * Stands in for a login server request.
+ */
+static void
+roundTrip()
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+/**
+ * A password login, shaped like ABC_LoginPasswordServer:
+ * fetch the CarePackage, derive LP1, fetch the LoginPackage, derive LP2.
+ * With `overlap`, the derivations run while the requests are in flight.
+ */
+static void
+benchLogin(size_t iterations, bool overlap)
+{
+    const std::string password = "username" "password";
+    const std::string salt1 = "server salt";
+    const std::string salt2 = "client salt";
+
+    abcd::tABC_CryptoSNRP snrp1 = {abcd::toU08Buf(salt1), 16384, 1, 1};
+    abcd::tABC_CryptoSNRP snrp2 = {abcd::toU08Buf(salt2), 16384, 8, 1};
+    auto LP = abcd::toU08Buf(password);
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        abcd::AutoU08Buf LP1;
+        abcd::AutoU08Buf LP2;
+        tABC_Error error;
+
+        if (overlap)
+        {
+            abcd::ScryptJob job1;
+            abcd::ScryptJob job2;
+            job1.start(LP, &snrp1);
+            roundTrip();
+            job2.start(LP, &snrp2);
+            job1.wait(LP1);
+            roundTrip();
+            job2.wait(LP2);
+        }
+        else
+        {
+            roundTrip();
+            abcd::ABC_CryptoScryptSNRP(LP, &snrp1, &LP1, &error);
+            roundTrip();
+            abcd::ABC_CryptoScryptSNRP(LP, &snrp2, &LP2, &error);
+        }
+    }
+}
+
+BENCH("login serial")     { benchLogin(iterations, false); }
+BENCH("login overlapped") { benchLogin(iterations, true); }
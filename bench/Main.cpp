@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Bench.hpp"
+#include "../abcd/util/FileIO.hpp"
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+/**
+ * Each benchmark runs for at least this long.
+ */
+constexpr auto minTime = std::chrono::milliseconds(500);
+
+/**
+ * Gives up on reaching minTime after this many iterations,
+ * in case the benchmark is too cheap to measure.
+ */
+constexpr size_t maxIterations = size_t(1) << 30;
+
+/**
+ * Counts heap allocations, so benchmarks can report allocations per op.
+ */
+static std::atomic<size_t> gAllocations(0);
+
+#ifdef __GLIBC__
+/*
+ * On glibc, replacing the C allocator catches everything: C++ `new`,
+ * the ABC_NEW and ABC_STR_NEW family, jansson, OpenSSL, and libgit2.
+ */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+extern "C" void *
+malloc(size_t size)
+{
+    ++gAllocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void *
+calloc(size_t count, size_t size)
+{
+    ++gAllocations;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *
+realloc(void *p, size_t size)
+{
+    ++gAllocations;
+    return __libc_realloc(p, size);
+}
+#define ALLOCS_NAME "allocs"
+#else
+/*
+ * Elsewhere, only C++ `new` shows up.
+ * The C allocations inside the core and its libraries don't count.
+ */
+void *
+operator new(size_t size)
+{
+    ++gAllocations;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *
+operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void
+operator delete[](void *p) noexcept
+{
+    free(p);
+}
+#define ALLOCS_NAME "news"
+#endif
+
+struct BenchInfo
+{
+    std::string name;
+    BenchFunction f;
+    size_t bytes;
+};
+
+struct BenchResult
+{
+    bool skipped;
+    size_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double mbPerSecond;
+};
+
+static std::vector<BenchInfo> &
+benchList()
+{
+    // Function-local, so it exists before the static registrations run:
+    static std::vector<BenchInfo> list;
+    return list;
+}
+
+BenchRegistration::BenchRegistration(const char *name, BenchFunction f,
+    size_t bytes)
+{
+    benchList().push_back(BenchInfo{name, f, bytes});
+}
+
+static bool gSkipped;
+static std::vector<std::string> gTempDirs;
+
+void
+benchSkip()
+{
+    gSkipped = true;
+}
+
+std::string
+benchTempDir()
+{
+    char dir[] = "/tmp/abc-bench-XXXXXX";
+    if (!mkdtemp(dir))
+        abort();
+    gTempDirs.push_back(dir);
+    return dir;
+}
+
+/**
+ * Runs a benchmark with increasing iteration counts until
+ * the timing is long enough to trust.
+ */
+static BenchResult
+runBench(BenchInfo &bench)
+{
+    size_t iterations = 1;
+    while (true)
+    {
+        gSkipped = false;
+        size_t allocations = gAllocations;
+        auto start = std::chrono::steady_clock::now();
+        bench.f(iterations);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        allocations = gAllocations - allocations;
+
+        if (gSkipped)
+        {
+            BenchResult out = {};
+            out.skipped = true;
+            return out;
+        }
+
+        if (minTime <= elapsed || maxIterations <= iterations)
+        {
+            double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+            BenchResult out;
+            out.skipped = false;
+            out.iterations = iterations;
+            out.nsPerOp = ns / iterations;
+            out.allocsPerOp = double(allocations) / iterations;
+            out.mbPerSecond = bench.bytes ?
+                1e3 * bench.bytes * iterations / ns : 0;
+            return out;
+        }
+        iterations *= 2;
+    }
+}
+
+/**
+ * Quotes a benchmark name for JSON output.
+ */
+static std::string
+jsonString(const std::string &s)
+{
+    std::string out = "\"";
+    for (char c: s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + '"';
+}
+
+static long
+peakRss()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0;
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char *argv[])
+{
+    // Usage: abc-bench [--csv | --json] [name-filter]
+    enum { text, csv, json } format = text;
+    const char *filter = "";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--csv"))
+            format = csv;
+        else if (!strcmp(argv[i], "--json"))
+            format = json;
+        else
+            filter = argv[i];
+    }
+
+    if (csv == format)
+        printf("name,iterations,ns_per_op,mb_per_s," ALLOCS_NAME "_per_op\n");
+    if (json == format)
+        printf("{\n  \"benchmarks\": [");
+
+    bool first = true;
+    for (auto &bench: benchList())
+    {
+        if (!strstr(bench.name.c_str(), filter))
+            continue;
+
+        BenchResult r = runBench(bench);
+        if (r.skipped)
+        {
+            if (text == format)
+                printf("%-40s skipped\n", bench.name.c_str());
+            if (json == format)
+                printf("%s\n    {\"name\": %s, \"skipped\": true}",
+                    first ? "" : ",", jsonString(bench.name).c_str());
+            first = false;
+            fflush(stdout);
+            continue;
+        }
+
+        switch (format)
+        {
+        case text:
+            printf("%-40s %14.0f ns/op", bench.name.c_str(), r.nsPerOp);
+            if (bench.bytes)
+                printf(" %10.1f MB/s", r.mbPerSecond);
+            else
+                printf(" %15s", "");
+            printf(" %10.1f " ALLOCS_NAME "/op\n", r.allocsPerOp);
+            break;
+
+        case csv:
+            printf("\"%s\",%zu,%.1f,%.3f,%.3f\n", bench.name.c_str(),
+                r.iterations, r.nsPerOp, r.mbPerSecond, r.allocsPerOp);
+            break;
+
+        case json:
+            printf("%s\n    {\"name\": %s, \"iterations\": %zu, "
+                "\"ns_per_op\": %.1f, \"mb_per_s\": %.3f, "
+                "\"" ALLOCS_NAME "_per_op\": %.3f}", first ? "" : ",",
+                jsonString(bench.name).c_str(), r.iterations,
+                r.nsPerOp, r.mbPerSecond, r.allocsPerOp);
+            break;
+        }
+        first = false;
+        fflush(stdout);
+    }
+
+    // Benchmarks like scrypt care about memory as much as time:
+    if (text == format)
+        printf("peak RSS: %ld KB\n", peakRss());
+    if (json == format)
+        printf("\n  ],\n  \"peak_rss_kb\": %ld\n}\n", peakRss());
+
+    // Teardown:
+    for (const auto &dir: gTempDirs)
+    {
+        tABC_Error error;
+        abcd::ABC_FileIODeleteRecursive(dir.c_str(), &error);
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Bench.hpp"
+#include "../minilibs/scrypt/crypto_scrypt.h"
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+/**
+ * Runs scrypt with the given implementation and the login-style r = 8.
+ */
+static void
+benchScrypt(size_t iterations, const char *impl, uint64_t N)
+{
+    if (crypto_scrypt_set_impl(impl))
+        return benchSkip();
+
+    const uint8_t password[] = "password";
+    const uint8_t salt[] = "salt";
+    uint8_t out[32];
+    for (size_t i = 0; i < iterations; ++i)
+        crypto_scrypt(password, sizeof(password), salt, sizeof(salt),
+            N, 8, 1, out, sizeof(out));
+
+    crypto_scrypt_set_impl(nullptr);
+}
+
+/**
+ * Registers the single-lane benchmarks for each implementation
+ * this build and CPU actually support, so none of them is a no-op.
+ */
+static bool
+registerScrypt()
+{
+    bool sse2 = !crypto_scrypt_set_impl("sse2");
+    crypto_scrypt_set_impl(nullptr);
+
+    for (int logN: {10, 12, 14, 16})
+    {
+        for (const char *impl: {"portable", "sse2"})
+        {
+            if (!strcmp(impl, "sse2") && !sse2)
+                continue;
+
+            std::string name = std::string("scrypt ") + impl +
+                " N=2^" + std::to_string(logN);
+            uint64_t N = uint64_t(1) << logN;
+            BenchRegistration(name.c_str(), [impl, N](size_t iterations)
+            {
+                benchScrypt(iterations, impl, N);
+            });
+        }
+    }
+    return true;
+}
+
+static bool gScryptRegistered = registerScrypt();
+
+/**
+ * Runs a multi-lane scrypt on the given number of threads.
+ */
+static void
+benchScryptLanes(size_t iterations, uint32_t threads, uint32_t p)
+{
+    crypto_scrypt_set_threads(threads);
+
+    const uint8_t password[] = "password";
+    const uint8_t salt[] = "salt";
+    uint8_t out[32];
+    for (size_t i = 0; i < iterations; ++i)
+        crypto_scrypt(password, sizeof(password), salt, sizeof(salt),
+            1 << 14, 8, p, out, sizeof(out));
+
+    crypto_scrypt_set_threads(0);
+}
+
+BENCH("scrypt N=2^14 p=4 serial")   { benchScryptLanes(iterations, 1, 4); }
+BENCH("scrypt N=2^14 p=4 parallel") { benchScryptLanes(iterations, 0, 4); }
+
+/**
+ * A login-style run of back-to-back derivations,
+ * dropping the scratch memory each time, as a fresh thread would.
+ */
+static void
+benchScryptRelease(size_t iterations, bool release)
+{
+    const uint8_t password[] = "password";
+    const uint8_t salt[] = "salt";
+    uint8_t out[32];
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        crypto_scrypt(password, sizeof(password), salt, sizeof(salt),
+            1 << 14, 8, 1, out, sizeof(out));
+        if (release)
+            crypto_scrypt_arena_release();
+    }
+}
+
+BENCH("scrypt N=2^14 reused arena") { benchScryptRelease(iterations, false); }
+BENCH("scrypt N=2^14 fresh arena")  { benchScryptRelease(iterations, true); }
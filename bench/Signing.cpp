@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Bench.hpp"
+#include "../abcd/bitcoin/picker.hpp"
+
+/**
+ * A consolidation transaction, where every input
+ * spends a different address into a single output.
+ */
+struct Consolidation
+{
+    abcd::unsigned_transaction utx;
+    abcd::key_table keys;
+
+    Consolidation(size_t inputs)
+    {
+        utx.tx.version = 1;
+        utx.tx.locktime = 0;
+
+        for (size_t i = 0; i < inputs; ++i)
+        {
+            // Deterministic keys and previous outputs:
+            bc::data_chunk seed(4);
+            seed[0] = i;
+            seed[1] = i >> 8;
+            abcd::wif_key key{bc::sha256_hash(seed), true};
+            bc::payment_address address;
+            bc::set_public_key(address,
+                bc::secret_to_public_key(key.secret, true));
+            keys[address] = key;
+
+            bc::transaction_input_type input;
+            input.previous_output.hash = bc::bitcoin_hash(seed);
+            input.previous_output.index = i % 3;
+            input.sequence = 0xffffffff;
+            utx.tx.inputs.push_back(input);
+            utx.challenges.push_back(
+                abcd::build_pubkey_hash_script(address.hash()));
+        }
+
+        bc::transaction_output_type output;
+        output.value = 5430 * inputs;
+        output.script = abcd::build_pubkey_hash_script(bc::short_hash());
+        utx.tx.outputs.push_back(output);
+    }
+
+    void sign(size_t iterations)
+    {
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            auto copy = utx;
+            abcd::sign_tx(copy, keys);
+        }
+    }
+};
+
+BENCH("sign_tx consolidation 10 inputs")
+{
+    static Consolidation fixture(10);
+    fixture.sign(iterations);
+}
+
+BENCH("sign_tx consolidation 200 inputs")
+{
+    static Consolidation fixture(200);
+    fixture.sign(iterations);
+}
+
+BENCH("sign_tx consolidation 500 inputs")
+{
+    static Consolidation fixture(500);
+    fixture.sign(iterations);
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Bench.hpp"
+#include "../abcd/util/Sync.hpp"
+#include <git2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+/**
+ * The number of repositories in an account with a pile of wallets.
+ */
+constexpr size_t repoCount = 20;
+
+/**
+ * A working directory and the key of its repository on the server.
+ */
+struct BenchRepo
+{
+    std::string path;
+    std::string key;
+};
+
+/**
+ * A scratch directory holding bare repositories, which stands in for
+ * the sync server. Set up once per run.
+ */
+static const std::string &
+serverDir()
+{
+    static std::string out;
+    if (out.empty())
+    {
+        out = benchTempDir();
+
+        tABC_Error error;
+        abcd::ABC_SyncInit(NULL, &error);
+        abcd::ABC_SyncSetServer(("file://" + out).c_str(), &error);
+    }
+    return out;
+}
+
+/**
+ * Writes a small file into a working directory.
+ */
+static void
+writeFile(const std::string &path, const std::string &contents)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f)
+        abort();
+    fputs(contents.c_str(), f);
+    fclose(f);
+}
+
+/**
+ * Creates a bare repository on the server and a working directory
+ * holding `files` small files, then syncs them once.
+ */
+static BenchRepo
+makeRepo(const std::string &key, size_t files)
+{
+    BenchRepo out;
+    out.key = key;
+    out.path = serverDir() + "/work-" + key;
+
+    git_repository *server = nullptr;
+    if (git_repository_init(&server, (serverDir() + "/" + key).c_str(), 1) < 0)
+        abort();
+    git_repository_free(server);
+
+    tABC_Error error;
+    if (abcd::ABC_SyncMakeRepo(out.path.c_str(), &error))
+        abort();
+    for (size_t i = 0; i < files; ++i)
+        writeFile(out.path + "/" + std::to_string(i) + ".json",
+            "{\"name\":\"bench\"}");
+
+    int dirty;
+    if (abcd::ABC_SyncRepo(out.path.c_str(), out.key.c_str(), &dirty, &error))
+        abort();
+    return out;
+}
+
+/**
+ * `repoCount` small repositories, like an account with a pile of wallets.
+ */
+static const std::vector<BenchRepo> &
+syncRepos()
+{
+    static std::vector<BenchRepo> out;
+    if (out.empty())
+    {
+        for (size_t i = 0; i < repoCount; ++i)
+            out.push_back(makeRepo("repo" + std::to_string(i), 1));
+    }
+    return out;
+}
+
+BENCH("sync 20 repos one by one")
+{
+    const auto &repos = syncRepos();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        for (const auto &repo: repos)
+        {
+            int dirty;
+            tABC_Error error;
+            abcd::ABC_SyncRepo(repo.path.c_str(), repo.key.c_str(),
+                &dirty, &error);
+        }
+    }
+}
+
+BENCH("sync 20 repos batched")
+{
+    const auto &repos = syncRepos();
+    std::vector<abcd::SyncJob> jobs;
+    for (const auto &repo: repos)
+    {
+        jobs.push_back([&repo](int *pDirty, tABC_Error *pError)
+        {
+            return abcd::ABC_SyncRepo(repo.path.c_str(), repo.key.c_str(),
+                pDirty, pError);
+        });
+    }
+
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        std::vector<int> dirty(jobs.size());
+        tABC_Error error;
+        abcd::ABC_SyncBatch(jobs, dirty.data(), 0, &error);
+    }
+}
+
+BENCH("sync 50k-file repo after one edit")
+{
+    static const BenchRepo repo = makeRepo("big", 50000);
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        writeFile(repo.path + "/0.json", std::to_string(i));
+
+        int dirty;
+        tABC_Error error;
+        abcd::ABC_SyncRepo(repo.path.c_str(), repo.key.c_str(),
+            &dirty, &error);
+    }
+}
+
+/**
+ * A repository with `syncs` small edits of history behind it,
+ * all still sitting in loose objects.
+ */
+static BenchRepo
+makeHistory(const std::string &key, size_t syncs)
+{
+    BenchRepo out = makeRepo(key, 10);
+    for (size_t i = 0; i < syncs; ++i)
+    {
+        writeFile(out.path + "/0.json", std::to_string(i));
+
+        int dirty;
+        tABC_Error error;
+        abcd::ABC_SyncRepo(out.path.c_str(), out.key.c_str(), &dirty, &error);
+    }
+    return out;
+}
+
+BENCH("sync repo with 300 loose commits")
+{
+    static const BenchRepo repo = makeHistory("loose", 300);
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        int dirty;
+        tABC_Error error;
+        abcd::ABC_SyncRepo(repo.path.c_str(), repo.key.c_str(),
+            &dirty, &error);
+    }
+}
+
+BENCH("sync repo with 300 packed commits")
+{
+    static const BenchRepo repo = []()
+    {
+        BenchRepo out = makeHistory("packed", 300);
+        tABC_Error error;
+        abcd::ABC_SyncPack(out.path.c_str(), &error);
+        return out;
+    }();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        int dirty;
+        tABC_Error error;
+        abcd::ABC_SyncRepo(repo.path.c_str(), repo.key.c_str(),
+            &dirty, &error);
+    }
+}
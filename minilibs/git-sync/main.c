@@ -44,7 +44,7 @@ int main(int argc, char *argv[])
         goto exit;
     }
 
-    if (sync_master(repo, &files_changed, &need_push) < 0)
+    if (sync_master(repo, &files_changed, &need_push, NULL, NULL) < 0)
     {
         print_error();
         fprintf(stderr, "error: failed to merge\n");
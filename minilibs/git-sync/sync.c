@@ -10,7 +10,14 @@
 
 #include "sync.h"
 #include <git2/sys/commit.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define git_check(f) if ((e = f) < 0) goto exit;
 
@@ -20,6 +27,11 @@
 #define SYNC_GIT_NAME                   "wallet"
 #define SYNC_GIT_EMAIL                  "wallet@airbitz.co"
 
+// Pack once the repository has this many loose objects or packs:
+#define SYNC_GC_LOOSE                   2000
+#define SYNC_GC_PACKS                   20
+#define SYNC_GC_SAMPLE                  "17"
+
 /**
  * Checks out the given branch.
  */
@@ -125,39 +137,6 @@ exit:
     return e;
 }
 
-/**
- * Determines whether or not the working directory has non-committed changes.
- */
-static int sync_local_dirty(int *out,
-                            git_repository *repo,
-                            git_oid *commit_id)
-{
-    int e = 0;
-    git_tree *tree = NULL;
-    git_diff *diff = NULL;
-
-    if (git_repository_is_bare(repo))
-    {
-        *out = 0;
-        goto exit;
-    }
-
-    git_oid tree_id;
-    git_check(sync_get_tree(&tree_id, repo, commit_id));
-    git_check(git_tree_lookup(&tree, repo, &tree_id));
-
-    git_diff_options diff_options = GIT_DIFF_OPTIONS_INIT;
-    diff_options.flags |= GIT_DIFF_INCLUDE_UNTRACKED;
-    git_check(git_diff_tree_to_workdir(&diff, repo, tree, &diff_options));
-
-    *out = git_diff_num_deltas(diff);
-
-exit:
-    if (tree)           git_tree_free(tree);
-    if (diff)           git_diff_free(diff);
-    return e;
-}
-
 /**
  * Looks up a reference, ignoring not-found errors.
  */
@@ -174,10 +153,39 @@ static int sync_lookup_soft(git_oid *out,
     return e;
 }
 
+/**
+ * Compares two tree entries using git's sort order,
+ * where a sub-tree sorts as if its name ended with a slash.
+ */
+static int sync_entry_cmp(const git_tree_entry *a,
+                          const git_tree_entry *b)
+{
+    const char *name_a = git_tree_entry_name(a);
+    const char *name_b = git_tree_entry_name(b);
+    size_t len_a = strlen(name_a);
+    size_t len_b = strlen(name_b);
+    size_t len = len_a < len_b ? len_a : len_b;
+
+    int s = memcmp(name_a, name_b, len);
+    if (s)
+        return s;
+
+    unsigned char c_a = len < len_a ? name_a[len] :
+        GIT_OBJ_TREE == git_tree_entry_type(a) ? '/' : 0;
+    unsigned char c_b = len < len_b ? name_b[len] :
+        GIT_OBJ_TREE == git_tree_entry_type(b) ? '/' : 0;
+    return c_a < c_b ? -1 : c_a > c_b;
+}
+
 /**
  * Merges two tree objects, producing a third tree.
  * The base tree allows the algorithm to distinguish between adds and deletes.
  * The algorithm always prefers the item from tree 1 when there is a conflict.
+ *
+ * All three trees are sorted, so the algorithm walks them side-by-side.
+ * If tree 2 matches either tree 1 or the base, the result is just tree 1,
+ * so identical sub-trees cost nothing, and the work is proportional
+ * to what has changed.
  */
 static int sync_merge_trees(git_oid *out,
                             git_repository *repo,
@@ -190,17 +198,27 @@ static int sync_merge_trees(git_oid *out,
     git_tree *tree1 = NULL;
     git_tree *tree2 = NULL;
     git_treebuilder *tb = NULL;
-    size_t size1, size2;
+    size_t base_size, size1, size2;
+    size_t base_i = 0;
     size_t i1 = 0;
     size_t i2 = 0;
+    const git_tree_entry *base_e = NULL;
     const git_tree_entry *e1 = NULL;
     const git_tree_entry *e2 = NULL;
     enum { ONLY1 = 1, ONLY2 = 2, BOTH = 3 } state = BOTH;
 
+    // Nothing to merge:
+    if (!git_oid_cmp(id2, id1) || !git_oid_cmp(id2, base_id))
+    {
+        git_oid_cpy(out, id1);
+        return 0;
+    }
+
     git_check(git_tree_lookup(&base_tree, repo, base_id));
     git_check(git_tree_lookup(&tree1, repo, id1));
     git_check(git_tree_lookup(&tree2, repo, id2));
     git_check(git_treebuilder_create(&tb, NULL));
+    base_size = git_tree_entrycount(base_tree);
     size1 = git_tree_entrycount(tree1);
     size2 = git_tree_entrycount(tree2);
 
@@ -219,7 +237,7 @@ static int sync_merge_trees(git_oid *out,
         // Determine state:
         if (e1 && e2)
         {
-            int s = strcmp(git_tree_entry_name(e1), git_tree_entry_name(e2));
+            int s = sync_entry_cmp(e1, e2);
             state = s < 0 ? ONLY1 :
                     s > 0 ? ONLY2 :
                     BOTH;
@@ -240,8 +258,33 @@ static int sync_merge_trees(git_oid *out,
         // Grab the entry in question:
         const git_tree_entry *entry =
             (state == ONLY1 || state == BOTH) ? e1 : e2;
-        const git_tree_entry *base_entry =
-            git_tree_entry_byname(base_tree, git_tree_entry_name(entry));
+        const char *name = git_tree_entry_name(entry);
+
+        // A file and a directory with the same name sort apart,
+        // so the walk can't pair them up. Match them by name instead,
+        // letting tree 1's entry win just as it would for two files:
+        int both = state == BOTH;
+        if (state == ONLY1 && git_tree_entry_byname(tree2, name))
+            both = 1;
+        if (state == ONLY2 && git_tree_entry_byname(tree1, name))
+            continue;
+
+        // Catch the base tree up, since it is sorted the same way:
+        int base_s = -1;
+        while (base_i < base_size)
+        {
+            base_e = git_tree_entry_byindex(base_tree, base_i);
+            base_s = sync_entry_cmp(base_e, entry);
+            if (0 <= base_s)
+                break;
+            ++base_i;
+        }
+        const git_tree_entry *base_entry = base_s ? NULL : base_e;
+        if (!base_entry && !both)
+        {
+            // The base may have had this name as the other type:
+            base_entry = git_tree_entry_byname(base_tree, name);
+        }
 
         // Decide what to do with the entry:
         if (state == BOTH && base_entry &&
@@ -260,11 +303,11 @@ static int sync_merge_trees(git_oid *out,
                 &new_tree,
                 git_tree_entry_filemode(e1)));
         }
-        else if (state == BOTH || !base_entry)
+        else if (both || !base_entry)
         {
             // Entry was added, or already present:
             git_check(git_treebuilder_insert(NULL, tb,
-                git_tree_entry_name(entry),
+                name,
                 git_tree_entry_id(entry),
                 git_tree_entry_filemode(entry)));
         }
@@ -281,32 +324,135 @@ exit:
     return e;
 }
 
+/**
+ * Adds a file to the index, or removes it if it no longer exists.
+ */
+static int sync_index_update(git_index *index,
+                             const char *path)
+{
+    int e = git_index_add_bypath(index, path);
+    if (e == GIT_ENOTFOUND)
+    {
+        giterr_clear();
+        e = git_index_remove_bypath(index, path);
+    }
+    return e;
+}
+
 /**
  * Creates a git tree object representing the state of the working directory.
+ * The index remembers each file's size and modification time from the
+ * last sync, so only files whose stat information has changed get hashed.
  */
 static int sync_workdir_tree(git_oid *out,
                              git_repository *repo)
 {
     int e = 0;
     git_index *index = NULL;
+    git_diff *diff = NULL;
+    char *path = NULL;
+    int changed = 0;
+    size_t i;
 
+    // The caller may keep the repository open between syncs,
+    // so pick up any changes made through other handles:
     git_check(git_repository_index(&index, repo));
-    git_check(git_index_clear(index));
-    git_strarray paths = {NULL, 0};
-    git_check(git_index_add_all(index, &paths, 0, NULL, NULL));
+    git_check(git_index_read(index, 0));
+
+    // A file written in the same second as the index could have changed
+    // again without its stat information changing, so hash those again.
+    // Going backwards means removals only shift entries we have seen:
+    const char *index_path = git_index_path(index);
+    struct stat st;
+    if (index_path && !stat(index_path, &st))
+    {
+        for (i = git_index_entrycount(index); i-- > 0; )
+        {
+            const git_index_entry *entry = git_index_get_byindex(index, i);
+            if (entry->mtime.seconds < st.st_mtime)
+                continue;
+
+            // Updating the entry frees the old path:
+            path = strdup(entry->path);
+            if (!path)
+            {
+                giterr_set_oom();
+                e = GIT_ERROR;
+                goto exit;
+            }
+            git_check(sync_index_update(index, path));
+            free(path);
+            path = NULL;
+            changed = 1;
+        }
+    }
+
+    // Find files with new stat information, and hash just those:
+    git_diff_options diff_options = GIT_DIFF_OPTIONS_INIT;
+    diff_options.flags |= GIT_DIFF_INCLUDE_UNTRACKED;
+    diff_options.flags |= GIT_DIFF_RECURSE_UNTRACKED_DIRS;
+    git_check(git_diff_index_to_workdir(&diff, repo, index, &diff_options));
+    for (i = 0; i < git_diff_num_deltas(diff); ++i)
+    {
+        const git_diff_delta *delta = git_diff_get_delta(diff, i);
+        if (delta->status == GIT_DELTA_DELETED)
+        {
+            git_check(git_index_remove_bypath(index, delta->old_file.path));
+        }
+        else
+        {
+            git_check(git_index_add_bypath(index, delta->new_file.path));
+        }
+        changed = 1;
+    }
+
     git_check(git_index_write_tree(out, index));
-    if (!git_repository_is_bare(repo))
+    if (changed && !git_repository_is_bare(repo))
     {
         git_check(git_index_write(index));
     }
 
 exit:
+    if (path)           free(path);
+    if (diff)           git_diff_free(diff);
     if (index)          git_index_free(index);
     return e;
 }
 
+/**
+ * Finds the tree for the working directory,
+ * and determines whether or not it has non-committed changes.
+ * Bare repositories have no working directory,
+ * so the tree comes from the commit instead.
+ */
+static int sync_local_tree(git_oid *out,
+                           int *dirty,
+                           git_repository *repo,
+                           git_oid *commit_id)
+{
+    int e = 0;
+    git_oid commit_tree;
+
+    git_check(sync_get_tree(&commit_tree, repo, commit_id));
+    if (git_repository_is_bare(repo))
+    {
+        git_oid_cpy(out, &commit_tree);
+        *dirty = 0;
+        goto exit;
+    }
+
+    git_check(sync_workdir_tree(out, repo));
+    *dirty = !git_oid_equal(out, &commit_tree);
+
+exit:
+    return e;
+}
+
 /**
  * Fetches the contents of the server into the "incoming" branch.
+ * The incoming branch remembers what the server had last time,
+ * so if the server's advertised master branch still matches it,
+ * there is nothing to download.
  */
 int sync_fetch(git_repository *repo,
                const char *server)
@@ -314,29 +460,102 @@ int sync_fetch(git_repository *repo,
     int e = 0;
     git_signature *sig = NULL;
     git_remote *remote = NULL;
+    const git_remote_head **heads = NULL;
+    size_t heads_count = 0;
+    git_oid server_id = {{0}};
+    git_oid incoming_id = {{0}};
+    size_t i;
 
-    git_check(git_signature_now(&sig, SYNC_GIT_NAME, SYNC_GIT_EMAIL));
     git_check(git_remote_create_anonymous(&remote, repo, server, SYNC_REFSPEC));
-    git_check(git_remote_fetch(remote, sig, "fetch"));
+    git_check(git_remote_connect(remote, GIT_DIRECTION_FETCH));
+
+    // Compare the server's master branch with what we saw last time:
+    git_check(git_remote_ls(&heads, &heads_count, remote));
+    for (i = 0; i < heads_count; ++i)
+    {
+        if (!strcmp(heads[i]->name, SYNC_REF_MASTER))
+        {
+            git_oid_cpy(&server_id, &heads[i]->oid);
+            break;
+        }
+    }
+    git_check(sync_lookup_soft(&incoming_id, repo, SYNC_REF_REMOTE));
+    if (!git_oid_cmp(&server_id, &incoming_id))
+        goto exit;
+
+    git_check(git_signature_now(&sig, SYNC_GIT_NAME, SYNC_GIT_EMAIL));
+    git_check(git_remote_download(remote));
+    git_check(git_remote_update_tips(remote, sig, "fetch"));
 
 exit:
     if (sig)        git_signature_free(sig);
-    if (remote)     git_remote_free(remote);
+    if (remote)
+    {
+        git_remote_disconnect(remote);
+        git_remote_free(remote);
+    }
+    return e;
+}
+
+/**
+ * Reports the files that differ between two trees.
+ */
+static int sync_report_changes(git_repository *repo,
+                               const git_oid *old_id,
+                               const git_oid *new_id,
+                               sync_change_cb changed,
+                               void *payload)
+{
+    int e = 0;
+    git_tree *old_tree = NULL;
+    git_tree *new_tree = NULL;
+    git_diff *diff = NULL;
+    size_t i;
+
+    git_check(git_tree_lookup(&old_tree, repo, old_id));
+    git_check(git_tree_lookup(&new_tree, repo, new_id));
+    git_check(git_diff_tree_to_tree(&diff, repo, old_tree, new_tree, NULL));
+    for (i = 0; i < git_diff_num_deltas(diff); ++i)
+    {
+        const git_diff_delta *delta = git_diff_get_delta(diff, i);
+        if (delta->status == GIT_DELTA_ADDED)
+        {
+            git_check(changed(delta->new_file.path, SYNC_CHANGE_ADDED, payload));
+        }
+        else if (delta->status == GIT_DELTA_DELETED)
+        {
+            git_check(changed(delta->old_file.path, SYNC_CHANGE_DELETED, payload));
+        }
+        else
+        {
+            git_check(changed(delta->new_file.path, SYNC_CHANGE_MODIFIED, payload));
+        }
+    }
+
+exit:
+    if (diff)           git_diff_free(diff);
+    if (new_tree)       git_tree_free(new_tree);
+    if (old_tree)       git_tree_free(old_tree);
     return e;
 }
 
 /**
  * Updates the master branch with the latest changes, including local
  * changes and changes from the remote repository.
+ * Only remote changes touch the working directory, so the changed files
+ * are the difference between the local tree and the new master tree.
  */
 int sync_master(git_repository *repo,
                 int *files_changed,
-                int *need_push)
+                int *need_push,
+                sync_change_cb changed,
+                void *payload)
 {
     int e = 0;
     git_oid master_id = {{0}};
     git_oid remote_id = {{0}};
     git_oid base_id = {{0}};
+    git_oid local_tree = {{0}};
     int master_dirty = 0;
     int remote_dirty = 0;
     int local_dirty = 0;
@@ -344,7 +563,12 @@ int sync_master(git_repository *repo,
     // Find the relevant commit objects:
     git_check(sync_lookup_soft(&master_id, repo, SYNC_REF_MASTER));
     git_check(sync_lookup_soft(&remote_id, repo, SYNC_REF_REMOTE));
-    if (!git_oid_iszero(&remote_id) && !git_oid_iszero(&master_id))
+    if (!git_oid_cmp(&master_id, &remote_id))
+    {
+        // Nothing to merge, which is the usual case:
+        git_oid_cpy(&base_id, &master_id);
+    }
+    else if (!git_oid_iszero(&remote_id) && !git_oid_iszero(&master_id))
     {
         e = git_merge_base(&base_id, repo, &master_id, &remote_id);
         if (e < 0 && e != GIT_ENOTFOUND)
@@ -356,30 +580,23 @@ int sync_master(git_repository *repo,
     // Figure out what needs syncing:
     master_dirty = git_oid_cmp(&master_id, &base_id);
     remote_dirty = git_oid_cmp(&remote_id, &base_id);
-    git_check(sync_local_dirty(&local_dirty, repo, &master_id));
+    git_check(sync_local_tree(&local_tree, &local_dirty, repo, &master_id));
 
     if (remote_dirty)
     {
+        git_oid new_tree;
         if (master_dirty || local_dirty)
         {
             // 3-way merge:
-            git_oid local_tree;
             git_oid base_tree;
             git_oid remote_tree;
-            if (local_dirty)
-            {
-                git_check(sync_workdir_tree(&local_tree, repo));
-            }
-            else
-            {
-                git_check(sync_get_tree(&local_tree, repo, &master_id));
-            }
             git_check(sync_get_tree(&remote_tree, repo, &remote_id));
             git_check(sync_get_tree(&base_tree, repo, &base_id));
 
             // Do merge:
             git_oid merged_tree;
             git_check(sync_merge_trees(&merged_tree, repo, &base_tree, &remote_tree, &local_tree));
+            git_oid_cpy(&new_tree, &merged_tree);
 
             // Commit to master:
             char const *message =
@@ -399,17 +616,20 @@ int sync_master(git_repository *repo,
         {
             // Fast-forward to remote:
             git_check(sync_fast_forward(repo, SYNC_REF_MASTER, &remote_id));
+            git_check(sync_get_tree(&new_tree, repo, &remote_id));
         }
         if (!git_repository_is_bare(repo))
         {
             git_check(sync_checkout(repo, SYNC_REF_MASTER));
         }
+        if (changed)
+        {
+            git_check(sync_report_changes(repo, &local_tree, &new_tree, changed, payload));
+        }
     }
     else if (local_dirty)
     {
         // Commit local changes:
-        git_oid local_tree;
-        git_check(sync_workdir_tree(&local_tree, repo));
         if (git_oid_iszero(&master_id))
         {
             const git_oid *parents[] = {NULL};
@@ -449,6 +669,7 @@ int sync_push(git_repository *repo,
     int e = 0;
     git_remote *remote = NULL;
     git_push *push = NULL;
+    git_oid master_id;
 
     git_check(git_remote_create_anonymous(&remote, repo, server, SYNC_REFSPEC));
     git_check(git_remote_connect(remote, GIT_DIRECTION_PUSH));
@@ -465,8 +686,253 @@ int sync_push(git_repository *repo,
     }
     git_check(git_push_status_foreach(push, sync_push_cb, NULL));
 
+    // The server has our master branch now, so the next fetch can skip it:
+    git_check(git_reference_name_to_id(&master_id, repo, SYNC_REF_MASTER));
+    git_check(sync_fast_forward(repo, SYNC_REF_REMOTE, &master_id));
+
 exit:
     if (remote)     git_remote_free(remote);
     if (push)       git_push_free(push);
     return e;
 }
+
+/**
+ * Flushes a file or directory to stable storage.
+ */
+static int sync_fsync(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        giterr_set_str(GITERR_OS, "Cannot open file to flush");
+        return GIT_ERROR;
+    }
+    if (fsync(fd))
+    {
+        close(fd);
+        giterr_set_str(GITERR_OS, "Cannot flush file");
+        return GIT_ERROR;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * Finds a path inside the repository's object store.
+ */
+static int sync_objects_path(char *out,
+                             git_repository *repo,
+                             const char *name)
+{
+    int n = snprintf(out, PATH_MAX, "%sobjects/%s",
+                     git_repository_path(repo), name);
+    if (n < 0 || PATH_MAX <= n)
+    {
+        giterr_set_str(GITERR_OS, "Object store path is too long");
+        return GIT_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * Adds up the files in one directory of the object store.
+ * A missing directory is just empty.
+ * @param suffix only count names ending in this, or NULL for all files
+ */
+static int sync_objects_scan(size_t *count,
+                             size_t *bytes,
+                             git_repository *repo,
+                             const char *name,
+                             const char *suffix)
+{
+    int e = 0;
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    DIR *d = NULL;
+    struct dirent *de;
+    struct stat st;
+
+    git_check(sync_objects_path(dir, repo, name));
+    d = opendir(dir);
+    if (!d)
+        goto exit;
+
+    while ((de = readdir(d)))
+    {
+        size_t length = strlen(de->d_name);
+        if (de->d_name[0] == '.')
+            continue;
+
+        if (bytes &&
+            snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) < (int)sizeof(path) &&
+            !stat(path, &st))
+            *bytes += st.st_size;
+
+        if (!suffix || (strlen(suffix) <= length &&
+            !strcmp(de->d_name + length - strlen(suffix), suffix)))
+            ++*count;
+    }
+
+exit:
+    if (d)              closedir(d);
+    return e;
+}
+
+/**
+ * Deletes the files in one directory of the object store,
+ * then the directory itself if that leaves it empty.
+ * @param prefix only delete names starting with this
+ * @param keep never delete names containing this, if not NULL
+ */
+static int sync_objects_remove(git_repository *repo,
+                               const char *name,
+                               const char *prefix,
+                               const char *keep)
+{
+    int e = 0;
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    DIR *d = NULL;
+    struct dirent *de;
+
+    git_check(sync_objects_path(dir, repo, name));
+    d = opendir(dir);
+    if (!d)
+        goto exit;
+
+    while ((de = readdir(d)))
+    {
+        if (de->d_name[0] == '.' ||
+            strncmp(de->d_name, prefix, strlen(prefix)) ||
+            (keep && strstr(de->d_name, keep)))
+            continue;
+
+        if ((int)sizeof(path) <= snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) ||
+            unlink(path))
+        {
+            giterr_set_str(GITERR_OS, "Cannot delete an old object file");
+            e = GIT_ERROR;
+            goto exit;
+        }
+    }
+    rmdir(dir);
+
+exit:
+    if (d)              closedir(d);
+    return e;
+}
+
+/**
+ * Measures the repository's object store.
+ */
+int sync_gc_measure(git_repository *repo,
+                    sync_gc_stats *out)
+{
+    int e = 0;
+    char name[3];
+    unsigned i;
+
+    memset(out, 0, sizeof(*out));
+    for (i = 0; i < 256; ++i)
+    {
+        snprintf(name, sizeof(name), "%02x", i);
+        git_check(sync_objects_scan(&out->loose, &out->bytes, repo, name, NULL));
+    }
+    git_check(sync_objects_scan(&out->packs, &out->bytes, repo, "pack", ".pack"));
+
+exit:
+    return e;
+}
+
+/**
+ * Decides whether the repository needs packing.
+ * Loose objects spread evenly across the 256 fan-out directories,
+ * so like `git gc --auto`, this counts just one and multiplies.
+ */
+int sync_gc_needed(git_repository *repo)
+{
+    int e = 0;
+    size_t loose = 0;
+    size_t packs = 0;
+
+    git_check(sync_objects_scan(&loose, NULL, repo, SYNC_GC_SAMPLE, NULL));
+    git_check(sync_objects_scan(&packs, NULL, repo, "pack", ".pack"));
+    e = SYNC_GC_LOOSE < 256 * loose || SYNC_GC_PACKS < packs;
+
+exit:
+    return e;
+}
+
+/**
+ * Packs everything the branches and the index refer to into one pack.
+ * Once that pack is safely on disk, every loose object and older pack
+ * is either a duplicate or unreachable, so they all go.
+ */
+int sync_gc(git_repository *repo)
+{
+    int e = 0;
+    git_packbuilder *pb = NULL;
+    git_revwalk *walk = NULL;
+    git_index *index = NULL;
+    git_oid id;
+    char path[PATH_MAX];
+    char file[PATH_MAX + GIT_OID_HEXSZ + 16];
+    char keep[GIT_OID_HEXSZ + 1] = "";
+    char name[3];
+    unsigned i;
+
+    git_check(git_packbuilder_new(&pb, repo));
+
+    // Every commit on every branch, with its tree:
+    git_check(git_revwalk_new(&walk, repo));
+    git_check(git_revwalk_push_glob(walk, "refs/heads/*"));
+    while (!(e = git_revwalk_next(&id, walk)))
+    {
+        git_check(git_packbuilder_insert_commit(pb, &id));
+    }
+    if (e != GIT_ITEROVER)
+        goto exit;
+    giterr_clear();
+    e = 0;
+
+    // The index won't hash unchanged files again,
+    // so keep its blobs even if no commit has them yet:
+    if (!git_repository_is_bare(repo))
+    {
+        git_check(git_repository_index(&index, repo));
+        git_check(git_index_read(index, 0));
+        for (i = 0; i < git_index_entrycount(index); ++i)
+        {
+            const git_index_entry *entry = git_index_get_byindex(index, i);
+            git_check(git_packbuilder_insert(pb, &entry->oid, entry->path));
+        }
+    }
+
+    if (git_packbuilder_object_count(pb))
+    {
+        git_check(sync_objects_path(path, repo, "pack"));
+        git_check(git_packbuilder_write(pb, path, 0, NULL, NULL));
+        git_oid_tostr(keep, sizeof(keep), git_packbuilder_hash(pb));
+
+        // The new pack must survive a power cut before the
+        // loose objects go, or unpushed history could be lost:
+        snprintf(file, sizeof(file), "%s/pack-%s.pack", path, keep);
+        git_check(sync_fsync(file));
+        snprintf(file, sizeof(file), "%s/pack-%s.idx", path, keep);
+        git_check(sync_fsync(file));
+        git_check(sync_fsync(path));
+    }
+
+    for (i = 0; i < 256; ++i)
+    {
+        snprintf(name, sizeof(name), "%02x", i);
+        git_check(sync_objects_remove(repo, name, "", NULL));
+    }
+    git_check(sync_objects_remove(repo, "pack", "pack-", keep[0] ? keep : NULL));
+
+exit:
+    if (index)          git_index_free(index);
+    if (walk)           git_revwalk_free(walk);
+    if (pb)             git_packbuilder_free(pb);
+    return e;
+}
@@ -23,16 +23,38 @@ extern "C" {
 int sync_fetch(git_repository *repo,
                const char *server);
 
+/**
+ * The ways a sync can change a file in the working directory.
+ */
+typedef enum sync_change
+{
+    SYNC_CHANGE_ADDED,
+    SYNC_CHANGE_MODIFIED,
+    SYNC_CHANGE_DELETED
+} sync_change;
+
+/**
+ * Receives each file a sync has changed in the working directory,
+ * as a path relative to the repository root.
+ * Returning a negative number stops the sync with that error.
+ */
+typedef int (*sync_change_cb)(const char *path,
+                              sync_change change,
+                              void *payload);
+
 /**
  * Updates the master branch with the latest changes, including local
  * changes and changes from the remote repository.
  * @param files_changed set to 1 if the function has changed the workdir.
  * @param need_push set to 1 if the master branch has changes not on the
  * server.
+ * @param changed receives the changed files, if not NULL.
  */
 int sync_master(git_repository *repo,
                 int *files_changed,
-                int *need_push);
+                int *need_push,
+                sync_change_cb changed,
+                void *payload);
 
 /**
  * Pushes the master branch to the server.
@@ -40,6 +62,38 @@ int sync_master(git_repository *repo,
 int sync_push(git_repository *repo,
               const char *server);
 
+/**
+ * The size of a repository's object store.
+ */
+typedef struct sync_gc_stats
+{
+    size_t loose;
+    size_t packs;
+    size_t bytes;
+} sync_gc_stats;
+
+/**
+ * Counts the loose objects, packs, and bytes in the object store.
+ * This visits every loose object, so it is too slow to run on every sync.
+ */
+int sync_gc_measure(git_repository *repo,
+                    sync_gc_stats *out);
+
+/**
+ * Quickly estimates whether the repository has enough loose objects
+ * or packs to be worth packing.
+ * @return 1 if so, 0 if not, or a negative error code.
+ */
+int sync_gc_needed(git_repository *repo);
+
+/**
+ * Packs all the reachable objects into a single pack,
+ * deleting the loose objects and old packs.
+ * Other handles to the repository may be left looking at deleted packs,
+ * so they should be re-opened afterwards.
+ */
+int sync_gc(git_repository *repo);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,13 +38,55 @@ static int create_file(const char *path, const char *contents)
     return 0;
 }
 
+static int check_file(const char *path, const char *contents)
+{
+    char buffer[256] = {0};
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return -1;
+
+    size_t size = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    if (size != strlen(contents) || memcmp(buffer, contents, size))
+    {
+        fprintf(stderr, "%s does not contain \"%s\"\n", path, contents);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * The files the last sync changed, joined with spaces.
+ */
+static char changes[256];
+
+static int record_change(const char *path, sync_change change, void *payload)
+{
+    const char *prefix[] = {"+", "~", "-"};
+    size_t used = strlen(changes);
+    snprintf(changes + used, sizeof(changes) - used, "%s%s%s",
+             used ? " " : "", prefix[change], path);
+    return 0;
+}
+
+static int check_changes(const char *expected)
+{
+    if (strcmp(changes, expected))
+    {
+        fprintf(stderr, "sync changed \"%s\", not \"%s\"\n", changes, expected);
+        return -1;
+    }
+    return 0;
+}
+
 static int do_sync(git_repository *repo, const char *server)
 {
     int e = 0;
     int dirty, need_push;
 
+    changes[0] = 0;
     CHECK(sync_fetch(repo, server));
-    CHECK(sync_master(repo, &dirty, &need_push));
+    CHECK(sync_master(repo, &dirty, &need_push, record_change, NULL));
     if (need_push)
         CHECK(sync_push(repo, server));
 
@@ -85,6 +127,7 @@ int main(int argc, char *argv[])
     CHECK(create_file(REPO_B "/c.txt", "b\n"));
     CHECK(do_sync(repo_a, SERVER));
     CHECK(do_sync(repo_b, SERVER));
+    CHECK(check_changes("-a.txt ~c.txt"));
     CHECK(do_sync(repo_a, SERVER));
 
     // Create a subdir:
@@ -92,6 +135,7 @@ int main(int argc, char *argv[])
     CHECK(create_file(REPO_A "/sub/a.txt", "a\n"));
     CHECK(do_sync(repo_a, SERVER));
     CHECK(do_sync(repo_b, SERVER));
+    CHECK(check_changes("+sub/a.txt"));
 
     // Subdir chaos:
     CHECK(create_file(REPO_B "/sub/b.txt", "b\n"));
@@ -103,12 +147,42 @@ int main(int argc, char *argv[])
     CHECK(do_sync(repo_a, SERVER));
 
     // When this is done, the two subdirs should match exactly:
-    // b.txt = b
-    // c.txt = a
-    // sub/b.txt = b
-    // sub/c.txt = a
+    CHECK(check_file(REPO_B "/b.txt", "b\n"));
+    CHECK(check_file(REPO_B "/c.txt", "a\n"));
+    CHECK(check_file(REPO_B "/sub/b.txt", "b\n"));
+    CHECK(check_file(REPO_B "/sub/c.txt", "a\n"));
+
+    // Same-size edits right after a sync must not hide behind the index:
+    CHECK(create_file(REPO_A "/b.txt", "x\n"));
+    CHECK(do_sync(repo_a, SERVER));
+    CHECK(create_file(REPO_A "/b.txt", "y\n"));
+    CHECK(do_sync(repo_a, SERVER));
+    CHECK(do_sync(repo_b, SERVER));
+    CHECK(check_file(REPO_B "/b.txt", "y\n"));
 
-    // TODO: Verify this in code
+    // A file on the server and a directory locally, with the same name.
+    // These sort apart, but the server's file must still win:
+    CHECK(create_file(REPO_A "/t", "t\n"));
+    CHECK(do_sync(repo_a, SERVER));
+    CHECK(do_sync(repo_b, SERVER));
+    CHECK(create_file(REPO_A "/t", "tt\n"));
+    CHECK(do_sync(repo_a, SERVER));
+    CHECK(remove(REPO_B "/t"));
+    CHECK(mkdir(REPO_B "/t", S_IRWXU | S_IRWXG | S_IRWXO));
+    CHECK(create_file(REPO_B "/t/a.txt", "b\n"));
+    CHECK(do_sync(repo_b, SERVER));
+    CHECK(check_file(REPO_B "/t", "tt\n"));
+
+    // Packing must keep everything the next sync needs:
+    CHECK(sync_gc(repo_a));
+    git_repository_free(repo_a);
+    repo_a = NULL;
+    CHECK(git_repository_open(&repo_a, REPO_A));
+    CHECK(create_file(REPO_A "/b.txt", "z\n"));
+    CHECK(do_sync(repo_a, SERVER));
+    CHECK(do_sync(repo_b, SERVER));
+    CHECK(check_changes("~b.txt"));
+    CHECK(check_file(REPO_B "/b.txt", "z\n"));
 
 exit:
     if (repo_a) git_repository_free(repo_a);
@@ -28,177 +28,159 @@
  */
 
 #include "crypto_scrypt.h"
-#include "sysendian.h"
+#include "crypto_scrypt_arena.h"
+#include "crypto_scrypt_smix.h"
 #include <openssl/evp.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <unistd.h>
 
-static void blkcpy(uint8_t *, uint8_t *, size_t);
-static void blkxor(uint8_t *, uint8_t *, size_t);
-static void salsa20_8(uint8_t[64]);
-static void blockmix_salsa8(uint8_t *, uint8_t *, size_t);
-static uint64_t integerify(uint8_t *, size_t);
-static void smix(uint8_t *, size_t, uint64_t, uint8_t *, uint8_t *);
+static crypto_scrypt_smix_t * smix_func = NULL;
+static pthread_once_t smix_once = PTHREAD_ONCE_INIT;
+static uint32_t max_threads = 0;
 
-static void
-blkcpy(uint8_t * dest, uint8_t * src, size_t len)
-{
-	size_t i;
-
-	for (i = 0; i < len; i++)
-		dest[i] = src[i];
-}
-
-static void
-blkxor(uint8_t * dest, uint8_t * src, size_t len)
-{
-	size_t i;
-
-	for (i = 0; i < len; i++)
-		dest[i] ^= src[i];
-}
+static void selectsmix(void);
+static int testsmix(crypto_scrypt_smix_t *);
 
 /**
- * salsa20_8(B):
- * Apply the salsa20/8 core to the provided block.
+ * testsmix(smix):
+ * Check an smix implementation against the portable one on a small input,
+ * in case the compiler or CPU has let us down.  Return 0 if they match.
  */
-static void
-salsa20_8(uint8_t B[64])
+static int
+testsmix(crypto_scrypt_smix_t * smix)
 {
-	uint32_t B32[16];
-	uint32_t x[16];
+	uint8_t B1[128 * 2], B2[128 * 2];
+	void * V = NULL;
+	void * XY = NULL;
 	size_t i;
+	int rc = -1;
 
-	/* Convert little-endian values in. */
-	for (i = 0; i < 16; i++)
-		B32[i] = le32dec(&B[i * 4]);
-
-	/* Compute x = doubleround^4(B32). */
-	for (i = 0; i < 16; i++)
-		x[i] = B32[i];
-	for (i = 0; i < 8; i += 2) {
-#define R(a,b) (((a) << (b)) | ((a) >> (32 - (b))))
-		/* Operate on columns. */
-		x[ 4] ^= R(x[ 0]+x[12], 7);  x[ 8] ^= R(x[ 4]+x[ 0], 9);
-		x[12] ^= R(x[ 8]+x[ 4],13);  x[ 0] ^= R(x[12]+x[ 8],18);
-
-		x[ 9] ^= R(x[ 5]+x[ 1], 7);  x[13] ^= R(x[ 9]+x[ 5], 9);
-		x[ 1] ^= R(x[13]+x[ 9],13);  x[ 5] ^= R(x[ 1]+x[13],18);
-
-		x[14] ^= R(x[10]+x[ 6], 7);  x[ 2] ^= R(x[14]+x[10], 9);
-		x[ 6] ^= R(x[ 2]+x[14],13);  x[10] ^= R(x[ 6]+x[ 2],18);
-
-		x[ 3] ^= R(x[15]+x[11], 7);  x[ 7] ^= R(x[ 3]+x[15], 9);
-		x[11] ^= R(x[ 7]+x[ 3],13);  x[15] ^= R(x[11]+x[ 7],18);
+	if (posix_memalign(&V, 64, 128 * 2 * 16))
+		goto done;
+	if (posix_memalign(&XY, 64, 256 * 2 + 64))
+		goto done;
 
-		/* Operate on rows. */
-		x[ 1] ^= R(x[ 0]+x[ 3], 7);  x[ 2] ^= R(x[ 1]+x[ 0], 9);
-		x[ 3] ^= R(x[ 2]+x[ 1],13);  x[ 0] ^= R(x[ 3]+x[ 2],18);
+	for (i = 0; i < sizeof(B1); i++)
+		B1[i] = B2[i] = (uint8_t)(i * 7 + 3);
+	crypto_scrypt_smix(B1, 2, 16, V, XY);
+	smix(B2, 2, 16, V, XY);
+	rc = memcmp(B1, B2, sizeof(B1)) ? -1 : 0;
 
-		x[ 6] ^= R(x[ 5]+x[ 4], 7);  x[ 7] ^= R(x[ 6]+x[ 5], 9);
-		x[ 4] ^= R(x[ 7]+x[ 6],13);  x[ 5] ^= R(x[ 4]+x[ 7],18);
-
-		x[11] ^= R(x[10]+x[ 9], 7);  x[ 8] ^= R(x[11]+x[10], 9);
-		x[ 9] ^= R(x[ 8]+x[11],13);  x[10] ^= R(x[ 9]+x[ 8],18);
-
-		x[12] ^= R(x[15]+x[14], 7);  x[13] ^= R(x[12]+x[15], 9);
-		x[14] ^= R(x[13]+x[12],13);  x[15] ^= R(x[14]+x[13],18);
-#undef R
-	}
-
-	/* Compute B32 = B32 + x. */
-	for (i = 0; i < 16; i++)
-		B32[i] += x[i];
-
-	/* Convert little-endian values out. */
-	for (i = 0; i < 16; i++)
-		le32enc(&B[4 * i], B32[i]);
+done:
+	free(XY);
+	free(V);
+	return (rc);
 }
 
 /**
- * blockmix_salsa8(B, Y, r):
- * Compute B = BlockMix_{salsa20/8, r}(B).  The input B must be 128r bytes in
- * length; the temporary space Y must also be the same size.
+ * selectsmix():
+ * Pick the fastest smix that works on this CPU.
  */
 static void
-blockmix_salsa8(uint8_t * B, uint8_t * Y, size_t r)
+selectsmix(void)
 {
-	uint8_t X[64];
-	size_t i;
 
-	/* 1: X <-- B_{2r - 1} */
-	blkcpy(X, &B[(2 * r - 1) * 64], 64);
+#ifdef CRYPTO_SCRYPT_SMIX_SSE2
+	if (crypto_scrypt_smix_sse2_supported() &&
+	    !testsmix(crypto_scrypt_smix_sse2)) {
+		smix_func = crypto_scrypt_smix_sse2;
+		return;
+	}
+#endif
+	smix_func = crypto_scrypt_smix;
+}
 
-	/* 2: for i = 0 to 2r - 1 do */
-	for (i = 0; i < 2 * r; i++) {
-		/* 3: X <-- H(X \xor B_i) */
-		blkxor(X, &B[i * 64], 64);
-		salsa20_8(X);
+int
+crypto_scrypt_set_impl(const char * name)
+{
 
-		/* 4: Y_i <-- X */
-		blkcpy(&Y[i * 64], X, 64);
+	pthread_once(&smix_once, selectsmix);
+	if (name == NULL) {
+		smix_func = NULL;
+		selectsmix();
+		return (0);
 	}
-
-	/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
-	for (i = 0; i < r; i++)
-		blkcpy(&B[i * 64], &Y[(i * 2) * 64], 64);
-	for (i = 0; i < r; i++)
-		blkcpy(&B[(i + r) * 64], &Y[(i * 2 + 1) * 64], 64);
+	if (!strcmp(name, "portable")) {
+		smix_func = crypto_scrypt_smix;
+		return (0);
+	}
+#ifdef CRYPTO_SCRYPT_SMIX_SSE2
+	if (!strcmp(name, "sse2") && crypto_scrypt_smix_sse2_supported()) {
+		smix_func = crypto_scrypt_smix_sse2;
+		return (0);
+	}
+#endif
+	return (-1);
 }
 
-/**
- * integerify(B, r):
- * Return the result of parsing B_{2r-1} as a little-endian integer.
- */
-static uint64_t
-integerify(uint8_t * B, size_t r)
+const char *
+crypto_scrypt_get_impl(void)
 {
-	uint8_t * X = &B[(2 * r - 1) * 64];
 
-	return (le64dec(X));
+	pthread_once(&smix_once, selectsmix);
+#ifdef CRYPTO_SCRYPT_SMIX_SSE2
+	if (smix_func == crypto_scrypt_smix_sse2)
+		return ("sse2");
+#endif
+	return ("portable");
 }
 
 /**
- * smix(B, r, N, V, XY):
- * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length; the
- * temporary storage V must be 128rN bytes in length; the temporary storage
- * XY must be 256r bytes in length.  The value N must be a power of 2.
+ * The smix lanes one thread is responsible for:
+ * lanes first, first + step, first + 2 * step, ... up to p - 1.
  */
-static void
-smix(uint8_t * B, size_t r, uint64_t N, uint8_t * V, uint8_t * XY)
+struct smix_lanes {
+	uint8_t * B;
+	size_t r;
+	uint64_t N;
+	uint32_t p;
+	uint32_t first;
+	uint32_t step;
+	void * V;
+	void * XY;
+};
+
+static void *
+smix_lanes(void * cookie)
 {
-	uint8_t * X = XY;
-	uint8_t * Y = &XY[128 * r];
-	uint64_t i;
-	uint64_t j;
+	struct smix_lanes * lanes = cookie;
+	uint32_t i;
 
-	/* 1: X <-- B */
-	blkcpy(X, B, 128 * r);
+	for (i = lanes->first; i < lanes->p; i += lanes->step)
+		smix_func(&lanes->B[i * 128 * lanes->r], lanes->r, lanes->N,
+		    lanes->V, lanes->XY);
+	return (NULL);
+}
 
-	/* 2: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i++) {
-		/* 3: V_i <-- X */
-		blkcpy(&V[i * (128 * r)], X, 128 * r);
+int
+crypto_scrypt_set_threads(uint32_t n)
+{
 
-		/* 4: X <-- H(X) */
-		blockmix_salsa8(X, Y, r);
-	}
+	if (n > SCRYPT_MAX_THREADS)
+		return (-1);
+	max_threads = n;
+	return (0);
+}
 
-	/* 6: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i++) {
-		/* 7: j <-- Integerify(X) mod N */
-		j = integerify(X, r) & (N - 1);
+uint32_t
+crypto_scrypt_get_threads(void)
+{
+	long n;
 
-		/* 8: X <-- H(X \xor V_j) */
-		blkxor(X, &V[j * (128 * r)], 128 * r);
-		blockmix_salsa8(X, Y, r);
-	}
+	if (max_threads)
+		return (max_threads);
 
-	/* 10: B' <-- X */
-	blkcpy(B, X, 128 * r);
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		return (1);
+	if (n > SCRYPT_MAX_THREADS)
+		return (SCRYPT_MAX_THREADS);
+	return ((uint32_t)n);
 }
 
 /**
@@ -215,10 +197,14 @@ crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
     const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
     uint8_t * buf, size_t buflen)
 {
+	struct smix_lanes lanes[SCRYPT_MAX_THREADS];
+	pthread_t threads[SCRYPT_MAX_THREADS];
+	int started[SCRYPT_MAX_THREADS];
+	struct scrypt_arena * arena;
 	uint8_t * B;
-	uint8_t * V;
-	uint8_t * XY;
-	uint32_t i;
+	uint32_t nthreads;
+	uint32_t t;
+	int rc = -1;
 
 	/* Sanity-check parameters. */
 #if SIZE_MAX > UINT32_MAX
@@ -231,7 +217,7 @@ crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
 		errno = EFBIG;
 		goto err0;
 	}
-	if (((N & (N - 1)) != 0) || (N == 0)) {
+	if (((N & (N - 1)) != 0) || (N < 2)) {
 		errno = EINVAL;
 		goto err0;
 	}
@@ -244,43 +230,80 @@ crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
 		goto err0;
 	}
 
-	/* Allocate memory. */
-	if ((B = malloc(128 * r * p)) == NULL)
+	/* Each thread needs its own V and XY, so don't start extras. */
+	nthreads = crypto_scrypt_get_threads();
+	if (nthreads > p)
+		nthreads = p;
+
+	/*
+	 * Borrow memory from this thread's arena, which keeps it between
+	 * calls so back-to-back derivations skip the page faults.
+	 */
+	if ((arena = scrypt_arena_get()) == NULL)
 		goto err0;
-	if ((XY = malloc(256 * r)) == NULL)
-		goto err1;
-	if ((V = malloc((unsigned long)((uint64_t) 128 * r * (uint64_t) N))) == NULL)
-		goto err2;
+	if ((B = scrypt_region_reserve(&arena->B, 128 * r * p)) == NULL)
+		goto err0;
+	for (t = 0; t < nthreads; t++) {
+		started[t] = 0;
+		lanes[t].XY = scrypt_region_reserve(&arena->XY[t],
+		    (size_t)256 * r + 64);
+		lanes[t].V = scrypt_region_reserve(&arena->V[t],
+		    (size_t)128 * r * N);
+		if (lanes[t].XY == NULL || lanes[t].V == NULL) {
+			/* Make do with fewer threads if we have at least one. */
+			if (t == 0)
+				goto err1;
+			nthreads = t;
+			break;
+		}
+	}
+	for (t = 0; t < nthreads; t++) {
+		lanes[t].B = B;
+		lanes[t].r = r;
+		lanes[t].N = N;
+		lanes[t].p = p;
+		lanes[t].first = t;
+		lanes[t].step = nthreads;
+	}
+	pthread_once(&smix_once, selectsmix);
 
 	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
 	if (!PKCS5_PBKDF2_HMAC((char *)passwd, passwdlen, salt, saltlen,
 		1, EVP_sha256(), p * 128 * r, B))
-		goto err2;
+		goto err1;
 
 	/* 2: for i = 0 to p - 1 do */
-	for (i = 0; i < p; i++) {
-		/* 3: B_i <-- MF(B_i, N) */
-		smix(&B[i * 128 * r], r, N, V, XY);
+	/* 3: B_i <-- MF(B_i, N) */
+	for (t = 1; t < nthreads; t++)
+		started[t] = !pthread_create(&threads[t], NULL, smix_lanes,
+		    &lanes[t]);
+	smix_lanes(&lanes[0]);
+	for (t = 1; t < nthreads; t++) {
+		/* If we couldn't get a thread, do its share here. */
+		if (started[t])
+			pthread_join(threads[t], NULL);
+		else
+			smix_lanes(&lanes[t]);
 	}
 
 	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
 	if (!PKCS5_PBKDF2_HMAC((char *)passwd, passwdlen, B, p * 128 * r,
 		1, EVP_sha256(), buflen, buf))
-		goto err2;
-
-	/* Free memory. */
-	free(V);
-	free(XY);
-	free(B);
+		goto err1;
 
 	/* Success! */
-	return (0);
+	rc = 0;
 
-err2:
-	free(XY);
 err1:
-	free(B);
+	/*
+	 * Wipe everything we used, including V, since V[0] is a single
+	 * PBKDF2 of the password.  Only the mappings stay for next time.
+	 */
+	scrypt_region_wipe(&arena->B, 128 * r * p);
+	for (t = 0; t < nthreads; t++) {
+		scrypt_region_wipe(&arena->XY[t], (size_t)256 * r + 64);
+		scrypt_region_wipe(&arena->V[t], (size_t)128 * r * N);
+	}
 err0:
-	/* Failure! */
-	return (-1);
+	return (rc);
 }
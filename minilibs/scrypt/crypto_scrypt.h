@@ -43,11 +43,62 @@ extern "C" {
  * must satisfy r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N
  * must be a power of 2 greater than 1.
  *
+ * The p lanes are independent, so they run on up to
+ * crypto_scrypt_get_threads() threads, each with its own 128rN bytes of
+ * scratch memory.  The memory is wiped before returning, but the calling
+ * thread keeps it mapped for its next call, until crypto_scrypt_arena_release
+ * or the thread exits.
+ *
  * Return 0 on success; or -1 on error.
  */
 int crypto_scrypt(const uint8_t *, size_t, const uint8_t *, size_t, uint64_t,
     uint32_t, uint32_t, uint8_t *, size_t);
 
+/**
+ * crypto_scrypt_set_impl(name):
+ * Force the use of a particular smix implementation, "portable" or "sse2",
+ * or pass NULL to go back to the fastest one this CPU supports.  This is
+ * meant for tests and benchmarks, and is not thread-safe.
+ *
+ * Return 0 on success; or -1 if the implementation is not available.
+ */
+int crypto_scrypt_set_impl(const char *);
+
+/**
+ * crypto_scrypt_get_impl():
+ * Return the name of the smix implementation in use.
+ */
+const char * crypto_scrypt_get_impl(void);
+
+/**
+ * crypto_scrypt_set_threads(n):
+ * Limit the number of threads crypto_scrypt uses for its p lanes, or pass 0
+ * to use one per online CPU, up to 8.  This is not thread-safe.
+ *
+ * Return 0 on success; or -1 if n is too large.
+ */
+int crypto_scrypt_set_threads(uint32_t);
+
+/**
+ * crypto_scrypt_get_threads():
+ * Return the most threads crypto_scrypt will use.
+ */
+uint32_t crypto_scrypt_get_threads(void);
+
+/**
+ * crypto_scrypt_arena_release():
+ * Wipe and free the scratch memory crypto_scrypt keeps for the calling
+ * thread.  Each thread's memory is also released when the thread exits.
+ */
+void crypto_scrypt_arena_release(void);
+
+/**
+ * crypto_scrypt_arena_peak():
+ * Return the most scratch memory, in bytes, that crypto_scrypt has held
+ * across all threads at once.
+ */
+size_t crypto_scrypt_arena_peak(void);
+
 #ifdef __cplusplus
 }
 #endif
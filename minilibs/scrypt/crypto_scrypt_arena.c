@@ -0,0 +1,197 @@
+/*-
+ * Copyright 2015 AirBitz, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "crypto_scrypt.h"
+#include "crypto_scrypt_arena.h"
+#include <openssl/crypto.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static int arena_key_ok = 0;
+
+/* Bytes held by all arenas, now and at most. */
+static pthread_mutex_t arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t arena_bytes = 0;
+static size_t arena_peak = 0;
+
+static void arena_account(size_t, size_t);
+static void region_release(struct scrypt_region *);
+static void arena_free(void *);
+static void arena_init(void);
+
+/**
+ * arena_account(added, removed):
+ * Update the running totals as regions come and go.
+ */
+static void
+arena_account(size_t added, size_t removed)
+{
+
+	pthread_mutex_lock(&arena_mutex);
+	arena_bytes += added;
+	arena_bytes -= removed;
+	if (arena_peak < arena_bytes)
+		arena_peak = arena_bytes;
+	pthread_mutex_unlock(&arena_mutex);
+}
+
+/**
+ * region_release(region):
+ * Wipe the region and hand its memory back to the system.
+ */
+static void
+region_release(struct scrypt_region * region)
+{
+
+	if (region->ptr == NULL)
+		return;
+
+	OPENSSL_cleanse(region->ptr, region->size);
+	if (region->locked)
+		munlock(region->ptr, region->size);
+	munmap(region->ptr, region->size);
+	arena_account(0, region->size);
+
+	region->ptr = NULL;
+	region->size = 0;
+	region->locked = 0;
+}
+
+/**
+ * arena_free(arena):
+ * Release everything an arena holds, then the arena itself.
+ */
+static void
+arena_free(void * cookie)
+{
+	struct scrypt_arena * arena = cookie;
+	size_t i;
+
+	if (arena == NULL)
+		return;
+
+	region_release(&arena->B);
+	for (i = 0; i < SCRYPT_MAX_THREADS; i++) {
+		region_release(&arena->XY[i]);
+		region_release(&arena->V[i]);
+	}
+	free(arena);
+}
+
+static void
+arena_init(void)
+{
+
+	arena_key_ok = !pthread_key_create(&arena_key, arena_free);
+}
+
+struct scrypt_arena *
+scrypt_arena_get(void)
+{
+	struct scrypt_arena * arena;
+
+	pthread_once(&arena_once, arena_init);
+	if (!arena_key_ok)
+		return (NULL);
+
+	if ((arena = pthread_getspecific(arena_key)) != NULL)
+		return (arena);
+
+	if ((arena = calloc(1, sizeof(struct scrypt_arena))) == NULL)
+		return (NULL);
+	if (pthread_setspecific(arena_key, arena)) {
+		free(arena);
+		return (NULL);
+	}
+	return (arena);
+}
+
+void *
+scrypt_region_reserve(struct scrypt_region * region, size_t size)
+{
+	void * ptr;
+
+	if (size <= region->size)
+		return (region->ptr);
+	region_release(region);
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return (NULL);
+
+	/*
+	 * Keep the working memory out of swap if we can.  Most systems cap
+	 * locked memory at a few megabytes, so failing here is normal.
+	 */
+	region->locked = !mlock(ptr, size);
+	region->ptr = ptr;
+	region->size = size;
+	arena_account(size, 0);
+	return (ptr);
+}
+
+void
+scrypt_region_wipe(struct scrypt_region * region, size_t len)
+{
+
+	if (region->ptr == NULL)
+		return;
+	if (len > region->size)
+		len = region->size;
+	OPENSSL_cleanse(region->ptr, len);
+}
+
+void
+crypto_scrypt_arena_release(void)
+{
+
+	pthread_once(&arena_once, arena_init);
+	if (!arena_key_ok)
+		return;
+
+	arena_free(pthread_getspecific(arena_key));
+	pthread_setspecific(arena_key, NULL);
+}
+
+size_t
+crypto_scrypt_arena_peak(void)
+{
+	size_t peak;
+
+	pthread_mutex_lock(&arena_mutex);
+	peak = arena_peak;
+	pthread_mutex_unlock(&arena_mutex);
+	return (peak);
+}
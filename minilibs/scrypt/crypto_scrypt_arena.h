@@ -0,0 +1,76 @@
+/*-
+ * Copyright 2015 AirBitz, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef _CRYPTO_SCRYPT_ARENA_H_
+#define _CRYPTO_SCRYPT_ARENA_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* The most threads crypto_scrypt will run smix lanes on. */
+#define SCRYPT_MAX_THREADS 8
+
+/**
+ * A page-aligned block of scratch memory, locked into RAM if possible.
+ */
+struct scrypt_region {
+	uint8_t * ptr;
+	size_t size;
+	int locked;
+};
+
+/**
+ * The scratch memory crypto_scrypt keeps between calls on one thread:
+ * the shared B buffer, plus an XY and V buffer for each lane thread.
+ */
+struct scrypt_arena {
+	struct scrypt_region B;
+	struct scrypt_region XY[SCRYPT_MAX_THREADS];
+	struct scrypt_region V[SCRYPT_MAX_THREADS];
+};
+
+/**
+ * scrypt_arena_get():
+ * Return the calling thread's arena, creating an empty one if needed, or
+ * NULL if that fails.  The arena is wiped and freed when the thread exits.
+ */
+struct scrypt_arena * scrypt_arena_get(void);
+
+/**
+ * scrypt_region_reserve(region, size):
+ * Make sure the region holds at least size bytes, reusing the existing
+ * memory if it is big enough.  Return a pointer to the memory, or NULL if
+ * it cannot be had.
+ */
+void * scrypt_region_reserve(struct scrypt_region *, size_t);
+
+/**
+ * scrypt_region_wipe(region, len):
+ * Overwrite the first len bytes of the region with zeros, while keeping the
+ * memory around for later.
+ */
+void scrypt_region_wipe(struct scrypt_region *, size_t);
+
+#endif /* !_CRYPTO_SCRYPT_ARENA_H_ */
@@ -0,0 +1,61 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#ifndef _CRYPTO_SCRYPT_SMIX_H_
+#define _CRYPTO_SCRYPT_SMIX_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * A function computing B = SMix_r(B, N).  The input B must be 128r bytes in
+ * length; the temporary storage V must be 128rN bytes in length; the
+ * temporary storage XY must be 256r + 64 bytes in length.  V and XY must be
+ * aligned to 64 bytes.  The value N must be even.
+ */
+typedef void crypto_scrypt_smix_t(uint8_t *, size_t, uint64_t, void *,
+    void *);
+
+/**
+ * crypto_scrypt_smix(B, r, N, V, XY):
+ * Portable implementation, working on native-endian words.
+ */
+crypto_scrypt_smix_t crypto_scrypt_smix;
+
+/**
+ * crypto_scrypt_smix_sse2(B, r, N, V, XY):
+ * SSE2 implementation.  Only present on x86 builds, and only usable if
+ * crypto_scrypt_smix_sse2_supported() returns non-zero.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define CRYPTO_SCRYPT_SMIX_SSE2 1
+crypto_scrypt_smix_t crypto_scrypt_smix_sse2;
+int crypto_scrypt_smix_sse2_supported(void);
+#endif
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_H_ */
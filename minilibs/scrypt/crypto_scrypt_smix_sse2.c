@@ -0,0 +1,249 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+
+#include "crypto_scrypt_smix.h"
+
+#ifdef CRYPTO_SCRYPT_SMIX_SSE2
+
+#include "sysendian.h"
+#include <emmintrin.h>
+#include <stdint.h>
+
+/*
+ * The SSE2 code keeps each 64-byte block in four registers, laid out along
+ * the salsa20 diagonals, so the column and row rounds become plain vector
+ * operations with a lane rotation in between.  Word i of the block lives in
+ * position (i * 5) % 16.
+ *
+ * On x86-64, SSE2 is always present.  On 32-bit x86, these functions are
+ * compiled for SSE2 regardless of the global flags, and only run if the CPU
+ * turns out to support it.
+ */
+#if defined(__i386__) && !defined(__SSE2__)
+#define SSE2_TARGET __attribute__((target("sse2")))
+#else
+#define SSE2_TARGET
+#endif
+
+static void blkcpy(__m128i *, const __m128i *, size_t);
+static void blkxor(__m128i *, const __m128i *, size_t);
+static void salsa20_8(__m128i[4]);
+static void blockmix_salsa8(const __m128i *, __m128i *, __m128i *, size_t);
+static uint64_t integerify(const __m128i *, size_t);
+
+SSE2_TARGET static void
+blkcpy(__m128i * dest, const __m128i * src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len / 16; i++)
+		dest[i] = src[i];
+}
+
+SSE2_TARGET static void
+blkxor(__m128i * dest, const __m128i * src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len / 16; i++)
+		dest[i] = _mm_xor_si128(dest[i], src[i]);
+}
+
+/**
+ * salsa20_8(B):
+ * Apply the salsa20/8 core to the provided block, which is in the shuffled
+ * diagonal layout.
+ */
+SSE2_TARGET static void
+salsa20_8(__m128i B[4])
+{
+	__m128i X0, X1, X2, X3;
+	__m128i T;
+	size_t i;
+
+	X0 = B[0];
+	X1 = B[1];
+	X2 = B[2];
+	X3 = B[3];
+
+	for (i = 0; i < 8; i += 2) {
+#define R(x, t, a) \
+	x = _mm_xor_si128(x, _mm_slli_epi32(t, a)); \
+	x = _mm_xor_si128(x, _mm_srli_epi32(t, 32 - a))
+		/* Operate on "columns". */
+		T = _mm_add_epi32(X0, X3); R(X1, T, 7);
+		T = _mm_add_epi32(X1, X0); R(X2, T, 9);
+		T = _mm_add_epi32(X2, X1); R(X3, T, 13);
+		T = _mm_add_epi32(X3, X2); R(X0, T, 18);
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x93);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x39);
+
+		/* Operate on "rows". */
+		T = _mm_add_epi32(X0, X1); R(X3, T, 7);
+		T = _mm_add_epi32(X3, X0); R(X2, T, 9);
+		T = _mm_add_epi32(X2, X3); R(X1, T, 13);
+		T = _mm_add_epi32(X1, X2); R(X0, T, 18);
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x39);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x93);
+#undef R
+	}
+
+	B[0] = _mm_add_epi32(B[0], X0);
+	B[1] = _mm_add_epi32(B[1], X1);
+	B[2] = _mm_add_epi32(B[2], X2);
+	B[3] = _mm_add_epi32(B[3], X3);
+}
+
+/**
+ * blockmix_salsa8(Bin, Bout, X, r):
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin).  The input Bin must be 128r
+ * bytes in length; the output Bout must also be the same size.  The
+ * temporary space X must be 64 bytes.
+ */
+SSE2_TARGET static void
+blockmix_salsa8(const __m128i * Bin, __m128i * Bout, __m128i * X, size_t r)
+{
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	blkcpy(X, &Bin[8 * r - 4], 64);
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < r; i++) {
+		/* 3: X <-- H(X \xor B_i) */
+		blkxor(X, &Bin[i * 8], 64);
+		salsa20_8(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		blkcpy(&Bout[i * 4], X, 64);
+
+		/* 3: X <-- H(X \xor B_i) */
+		blkxor(X, &Bin[i * 8 + 4], 64);
+		salsa20_8(X);
+
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		blkcpy(&Bout[(r + i) * 4], X, 64);
+	}
+}
+
+/**
+ * integerify(B, r):
+ * Return the result of parsing B_{2r-1} as a little-endian integer.
+ * Word 1 sits in position 13 of the shuffled layout.
+ */
+SSE2_TARGET static uint64_t
+integerify(const __m128i * B, size_t r)
+{
+	const uint32_t * X = (const uint32_t *)&B[8 * r - 4];
+
+	return (((uint64_t)(X[13]) << 32) + X[0]);
+}
+
+SSE2_TARGET void
+crypto_scrypt_smix_sse2(uint8_t * B, size_t r, uint64_t N, void * _V,
+    void * XY)
+{
+	__m128i * X = XY;
+	__m128i * Y = (__m128i *)((uint8_t *)(XY) + 128 * r);
+	__m128i * Z = (__m128i *)((uint8_t *)(XY) + 256 * r);
+	uint32_t * X32 = (uint32_t *)X;
+	__m128i * V = _V;
+	uint64_t i;
+	uint64_t j;
+	size_t k, n;
+
+	/* 1: X <-- B */
+	for (k = 0; k < 2 * r; k++) {
+		for (n = 0; n < 16; n++) {
+			X32[k * 16 + n] =
+			    le32dec(&B[(k * 16 + (n * 5 % 16)) * 4]);
+		}
+	}
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i += 2) {
+		/* 3: V_i <-- X */
+		blkcpy(&V[i * (8 * r)], X, 128 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(X, Y, Z, r);
+
+		/* 3: V_i <-- X */
+		blkcpy(&V[(i + 1) * (8 * r)], Y, 128 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(Y, X, Z, r);
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i += 2) {
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(X, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(X, &V[j * (8 * r)], 128 * r);
+		blockmix_salsa8(X, Y, Z, r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(Y, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(Y, &V[j * (8 * r)], 128 * r);
+		blockmix_salsa8(Y, X, Z, r);
+	}
+
+	/* 10: B' <-- X */
+	for (k = 0; k < 2 * r; k++) {
+		for (n = 0; n < 16; n++) {
+			le32enc(&B[(k * 16 + (n * 5 % 16)) * 4],
+			    X32[k * 16 + n]);
+		}
+	}
+}
+
+int
+crypto_scrypt_smix_sse2_supported(void)
+{
+#if defined(__x86_64__) || defined(__SSE2__)
+	return (1);
+#else
+	__builtin_cpu_init();
+	return (__builtin_cpu_supports("sse2"));
+#endif
+}
+
+#endif /* CRYPTO_SCRYPT_SMIX_SSE2 */
@@ -42,8 +42,10 @@
 #include "../abcd/bitcoin/Testnet.hpp"
 #include "../abcd/bitcoin/Text.hpp"
 #include "../abcd/bitcoin/WatcherBridge.hpp"
+#include "../abcd/crypto/Crypto.hpp"
 #include "../abcd/crypto/Encoding.hpp"
 #include "../abcd/crypto/Random.hpp"
+#include "../abcd/crypto/Scrypt.hpp"
 #include "../abcd/exchange/Exchange.hpp"
 #include "../abcd/login/Lobby.hpp"
 #include "../abcd/login/Login.hpp"
@@ -57,6 +59,7 @@
 #include "../abcd/util/FileIO.hpp"
 #include "../abcd/util/Json.hpp"
 #include "../abcd/util/Sync.hpp"
+#include "../abcd/util/SyncScheduler.hpp"
 #include "../abcd/util/URL.hpp"
 #include "../abcd/util/Util.hpp"
 #include <qrencode.h>
@@ -66,11 +69,38 @@
 #include <pthread.h>
 #include <jansson.h>
 #include <math.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 
 using namespace abcd;
 
 static bool gbInitialized = false;
 
+// Background sync, once the host app asks for it:
+#define SYNC_ACCOUNT_REPO   "account"
+#define SYNC_DELAY_MIN      std::chrono::seconds(30)
+#define SYNC_DELAY_MAX      std::chrono::minutes(10)
+static std::mutex gSchedulerMutex;
+static std::unique_ptr<SyncScheduler> gScheduler;
+
+/**
+ * Stops the background sync, if it is running.
+ * Stopping waits for the running sync, and its callbacks may call
+ * ABC_DataSyncRequest, so the lock must be released before that.
+ */
+static void
+ABC_DataSyncShutdown()
+{
+    std::unique_ptr<SyncScheduler> old;
+    {
+        std::lock_guard<std::mutex> lock(gSchedulerMutex);
+        old = std::move(gScheduler);
+    }
+    old.reset();
+}
+
 static tABC_Currency gaCurrencies[] = {
     { "AUD", 36, "Australian Dollar", " Australia, Christmas Island (CX), Cocos (Keeling) Islands (CC), Heard and McDonald Islands (HM), Kiribati (KI), Nauru (NR), Norfolk Island (NF), Tuvalu (TV), and Australian Antarctic Territory" },
     { "CAD", 124, "Canadian dollar", "Canada, Saint Pierre and Miquelon" },
@@ -160,6 +190,8 @@ void ABC_Terminate()
 
         ABC_SyncTerminate();
 
+        ABC_TerminateCrypto();
+
         ABC_DebugTerminate();
 
         gbInitialized = false;
@@ -648,8 +680,13 @@ tABC_CC ABC_ClearKeyCache(tABC_Error *pError)
 
     ABC_CHECK_ASSERT(true == gbInitialized, ABC_CC_NotInitialized, "The core library has not been initalized");
 
+    // The scheduler's jobs hold on to the login:
+    ABC_DataSyncShutdown();
     cacheLogout();
     ABC_WalletClearCache();
+    ABC_CryptoScryptRelease();
+    cryptoFilenameClear();
+    cryptoCipherClear();
 
 exit:
     return cc;
@@ -2059,6 +2096,46 @@ exit:
     return cc;
 }
 
+/**
+ * Sweeps a batch of private keys into the wallet.
+ * This watches all the keys at once,
+ * and sweeps their funds with a single transaction.
+ *
+ * @param szUserName        UserName for the account associated with the transactions
+ * @param szPassword        Password for the account associated with the transactions
+ * @param szWalletUUID      UUID of the wallet associated with the transactions
+ * @param aszKeys           Private keys in WIF format
+ * @param keyCount          Number of keys in the array
+ * @param fProgress         Called as keys resolve. May be NULL.
+ * @param fCallback         Called when the sweep is done.
+ * @param pData             Closure parameter for the callback.
+ */
+tABC_CC ABC_SweepKeys(const char *szUsername,
+                      const char *szPassword,
+                      const char *szWalletUUID,
+                      const char **aszKeys,
+                      unsigned int keyCount,
+                      tABC_Sweep_Progress_Callback fProgress,
+                      tABC_Sweep_Done_Callback fCallback,
+                      void *pData,
+                      tABC_Error *pError)
+{
+    ABC_DebugLog("%s called", __FUNCTION__);
+
+    tABC_CC cc = ABC_CC_Ok;
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+
+    std::shared_ptr<Login> login;
+
+    ABC_CHECK_NULL(aszKeys);
+    ABC_CHECK_NEW(cacheLogin(login, szUsername), pError);
+    ABC_CHECK_RET(ABC_BridgeSweepKeys(ABC_WalletID(*login, szWalletUUID),
+        aszKeys, keyCount, fProgress, fCallback, pData, pError));
+
+exit:
+    return cc;
+}
+
 /**
  * Gets the transaction specified
  *
@@ -2708,7 +2785,9 @@ void ABC_FreeAccountSettings(tABC_AccountSettings *pSettings)
 }
 
 /**
- * Run sync on all directories
+ * Run sync on all directories.
+ * The account and its wallets sync side-by-side,
+ * up to SYNC_MAX_THREADS at a time.
  *
  * @param szUserName UserName for the account
  * @param szPassword Password for the account
@@ -2725,21 +2804,56 @@ tABC_CC ABC_DataSyncAll(const char *szUserName,
     int walletDirty = 0;
     std::shared_ptr<Login> login;
     AutoStringArray uuids;
+    AutoStringArray newUuids;
+    std::vector<SyncJob> jobs;
+    std::vector<int> dirty;
 
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
     ABC_CHECK_ASSERT(true == gbInitialized, ABC_CC_NotInitialized, "The core library has not been initalized");
 
     ABC_CHECK_NEW(cacheLogin(login, szUserName), pError);
-    ABC_CHECK_RET(ABC_DataSyncAccount(szUserName, szPassword, fAsyncBitCoinEventCallback, pData, pError));
 
-    // Sync the wallets:
+    // Sync the account and the wallets we already know about:
     ABC_CHECK_RET(ABC_AccountWalletList(*login, &uuids.data, &uuids.size, pError));
+    jobs.push_back([&](int *pDirty, tABC_Error *pError)
+    {
+        // This reports its own changes:
+        return ABC_DataSyncAccount(szUserName, szPassword, fAsyncBitCoinEventCallback, pData, pError);
+    });
     for (size_t i = 0; i < uuids.size; ++i)
     {
-        int dirty = 0;
-        ABC_CHECK_RET(ABC_WalletSyncData(ABC_WalletID(*login, uuids.data[i]), &dirty, pError));
-        walletDirty |= dirty;
+        tABC_WalletID id = ABC_WalletID(*login, uuids.data[i]);
+        jobs.push_back([id](int *pDirty, tABC_Error *pError)
+        {
+            return ABC_WalletSyncData(id, pDirty, pError);
+        });
+    }
+    dirty.resize(jobs.size());
+    ABC_CHECK_RET(ABC_SyncBatch(jobs, dirty.data(), 0, pError));
+    for (size_t i = 1; i < dirty.size(); ++i)
+        walletDirty |= dirty[i];
+
+    // Sync any wallets the account sync brought in:
+    jobs.clear();
+    ABC_CHECK_RET(ABC_AccountWalletList(*login, &newUuids.data, &newUuids.size, pError));
+    for (size_t i = 0; i < newUuids.size; ++i)
+    {
+        bool known = false;
+        for (size_t j = 0; j < uuids.size && !known; ++j)
+            known = !strcmp(newUuids.data[i], uuids.data[j]);
+        if (known)
+            continue;
+
+        tABC_WalletID id = ABC_WalletID(*login, newUuids.data[i]);
+        jobs.push_back([id](int *pDirty, tABC_Error *pError)
+        {
+            return ABC_WalletSyncData(id, pDirty, pError);
+        });
     }
+    dirty.assign(jobs.size(), 0);
+    ABC_CHECK_RET(ABC_SyncBatch(jobs, dirty.data(), 0, pError));
+    for (size_t i = 0; i < dirty.size(); ++i)
+        walletDirty |= dirty[i];
 
     if (walletDirty && fAsyncBitCoinEventCallback)
     {
@@ -2754,15 +2868,21 @@ exit:
     return cc;
 }
 
-tABC_CC ABC_DataSyncAccount(const char *szUserName,
-                            const char *szPassword,
-                            tABC_BitCoin_Event_Callback fAsyncBitCoinEventCallback,
-                            void *pData,
-                            tABC_Error *pError)
+/**
+ * Syncs the account repository, reporting password changes and
+ * account updates through the callback.
+ *
+ * @param pDirty Set to 1 if the sync changed any files
+ */
+static
+tABC_CC ABC_DataSyncAccountRepo(const char *szUserName,
+                                tABC_BitCoin_Event_Callback fAsyncBitCoinEventCallback,
+                                void *pData,
+                                int *pDirty,
+                                tABC_Error *pError)
 {
-    ABC_DebugLog("%s called", __FUNCTION__);
-
     tABC_CC cc = ABC_CC_Ok;
+    *pDirty = 0;
 
     ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
     ABC_CHECK_ASSERT(true == gbInitialized, ABC_CC_NotInitialized, "The core library has not been initalized");
@@ -2802,16 +2922,28 @@ tABC_CC ABC_DataSyncAccount(const char *szUserName,
     // Actually do the sync:
     {
         std::shared_ptr<Login> login;
-        int accountDirty = 0;
+        SyncChanges changes;
 
         // Sync the account data
         ABC_CHECK_NEW(cacheLogin(login, szUserName), pError);
-        ABC_CHECK_RET(ABC_SyncRepo(login->syncDir().c_str(), login->syncKey().c_str(), &accountDirty, pError));
-        if (accountDirty && fAsyncBitCoinEventCallback)
+        ABC_CHECK_RET(ABC_SyncRepo(login->syncDir().c_str(), login->syncKey().c_str(), pDirty, &changes, pError));
+
+        // Drop the cached keys for any wallets whose entries changed:
+        for (const auto &change: changes)
         {
-            // Try to clear the wallet cache in case the Wallets list changed
-            ABC_WalletClearCache();
+            const std::string prefix = "Wallets/";
+            const std::string suffix = ".json";
+            if (!change.path.compare(0, prefix.size(), prefix) &&
+                prefix.size() + suffix.size() < change.path.size())
+            {
+                std::string uuid = change.path.substr(prefix.size(),
+                    change.path.size() - prefix.size() - suffix.size());
+                ABC_CHECK_RET(ABC_WalletRemoveFromCache(uuid.c_str(), pError));
+            }
+        }
 
+        if (*pDirty && fAsyncBitCoinEventCallback)
+        {
             tABC_AsyncBitCoinInfo info;
             info.eventType = ABC_AsyncEventType_DataSyncUpdate;
             info.pData = pData;
@@ -2825,6 +2957,177 @@ exit:
     return cc;
 }
 
+tABC_CC ABC_DataSyncAccount(const char *szUserName,
+                            const char *szPassword,
+                            tABC_BitCoin_Event_Callback fAsyncBitCoinEventCallback,
+                            void *pData,
+                            tABC_Error *pError)
+{
+    ABC_DebugLog("%s called", __FUNCTION__);
+
+    tABC_CC cc = ABC_CC_Ok;
+    int dirty = 0;
+
+    ABC_CHECK_RET(ABC_DataSyncAccountRepo(szUserName, fAsyncBitCoinEventCallback, pData, &dirty, pError));
+
+exit:
+    return cc;
+}
+
+/**
+ * Matches the scheduler's wallets to the account's wallet list,
+ * adding new wallets and dropping the ones that have left the account.
+ */
+static
+tABC_CC ABC_DataSyncUpdateWallets(SyncScheduler &scheduler,
+                                  std::shared_ptr<Login> login,
+                                  tABC_Error *pError)
+{
+    tABC_CC cc = ABC_CC_Ok;
+    AutoStringArray uuids;
+    std::set<std::string> names;
+
+    ABC_CHECK_RET(ABC_AccountWalletList(*login, &uuids.data, &uuids.size, pError));
+    names.insert(SYNC_ACCOUNT_REPO);
+    for (size_t i = 0; i < uuids.size; ++i)
+    {
+        std::string uuid = uuids.data[i];
+        names.insert(uuid);
+        scheduler.add(uuid, [login, uuid](int *pDirty, tABC_Error *pError)
+        {
+            return ABC_WalletSyncData(ABC_WalletID(*login, uuid.c_str()), pDirty, pError);
+        });
+    }
+    scheduler.retain(names);
+
+exit:
+    return cc;
+}
+
+/**
+ * Starts syncing the account and its wallets in the background.
+ *
+ * Everything syncs right away, and then on a timer that backs off
+ * while nothing changes. Changes arrive through the callback as
+ * ABC_AsyncEventType_DataSyncUpdate events, with szWalletUUID set
+ * for wallet changes, so the host app doesn't need to poll.
+ * Each account sync re-reads the wallet list, so new wallets join the
+ * schedule and removed ones leave it.
+ * Calling this again restarts the scheduler for the given account.
+ *
+ * @param szUserName UserName for the account
+ * @param szPassword Password for the account
+ */
+tABC_CC ABC_DataSyncStart(const char *szUserName,
+                          const char *szPassword,
+                          tABC_BitCoin_Event_Callback fAsyncBitCoinEventCallback,
+                          void *pData,
+                          tABC_Error *pError)
+{
+    ABC_DebugLog("%s called", __FUNCTION__);
+
+    tABC_CC cc = ABC_CC_Ok;
+    std::shared_ptr<Login> login;
+    std::unique_ptr<SyncScheduler> old; // Destroyed after the lock is gone
+    std::lock_guard<std::mutex> lock(gSchedulerMutex);
+
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+    ABC_CHECK_ASSERT(true == gbInitialized, ABC_CC_NotInitialized, "The core library has not been initalized");
+    ABC_CHECK_NULL(szUserName);
+    ABC_CHECK_NULL(fAsyncBitCoinEventCallback);
+
+    ABC_CHECK_NEW(cacheLogin(login, szUserName), pError);
+
+    old = std::move(gScheduler);
+    gScheduler.reset(new SyncScheduler(SYNC_DELAY_MIN, SYNC_DELAY_MAX));
+    {
+        // The scheduler outlives its threads, so the jobs can use it:
+        SyncScheduler *scheduler = gScheduler.get();
+        std::string userName = szUserName;
+        scheduler->add(SYNC_ACCOUNT_REPO,
+            [scheduler, login, userName, fAsyncBitCoinEventCallback, pData](int *pDirty, tABC_Error *pError)
+        {
+            tABC_CC cc = ABC_CC_Ok;
+
+            // This reports its own changes:
+            ABC_CHECK_RET(ABC_DataSyncAccountRepo(userName.c_str(), fAsyncBitCoinEventCallback, pData, pDirty, pError));
+
+            // Wallets can come and go remotely or locally, so check every time:
+            ABC_CHECK_RET(ABC_DataSyncUpdateWallets(*scheduler, login, pError));
+
+        exit:
+            return cc;
+        });
+    }
+    ABC_CHECK_RET(ABC_DataSyncUpdateWallets(*gScheduler, login, pError));
+
+    {
+        gScheduler->start([fAsyncBitCoinEventCallback, pData](const std::string &name)
+        {
+            // The account job reports its own changes:
+            if (name == SYNC_ACCOUNT_REPO)
+                return;
+
+            tABC_AsyncBitCoinInfo info = {0};
+            info.eventType = ABC_AsyncEventType_DataSyncUpdate;
+            info.pData = pData;
+            info.szWalletUUID = const_cast<char *>(name.c_str());
+            info.szDescription = const_cast<char *>("Wallet Updated");
+            fAsyncBitCoinEventCallback(&info);
+        });
+    }
+
+exit:
+    // The thread hasn't started, so this doesn't wait for anything:
+    if (ABC_CC_Ok != cc)
+        gScheduler.reset();
+    return cc;
+}
+
+/**
+ * Asks the background sync to run soon, typically after a local change.
+ * Bursts of requests coalesce into a single sync.
+ *
+ * @param szWalletUUID The wallet to sync, or NULL for the account
+ */
+tABC_CC ABC_DataSyncRequest(const char *szWalletUUID,
+                            tABC_Error *pError)
+{
+    ABC_DebugLog("%s called", __FUNCTION__);
+
+    tABC_CC cc = ABC_CC_Ok;
+    std::lock_guard<std::mutex> lock(gSchedulerMutex);
+
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+    ABC_CHECK_ASSERT(true == gbInitialized, ABC_CC_NotInitialized, "The core library has not been initalized");
+    ABC_CHECK_ASSERT(gScheduler, ABC_CC_Error, "The background sync has not been started");
+
+    gScheduler->request(szWalletUUID ? szWalletUUID : SYNC_ACCOUNT_REPO);
+
+exit:
+    return cc;
+}
+
+/**
+ * Stops the background sync, waiting for any running syncs to finish.
+ * Logging out does this automatically.
+ * Do not call this from inside the sync callback.
+ */
+tABC_CC ABC_DataSyncStop(tABC_Error *pError)
+{
+    ABC_DebugLog("%s called", __FUNCTION__);
+
+    tABC_CC cc = ABC_CC_Ok;
+
+    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+    ABC_CHECK_ASSERT(true == gbInitialized, ABC_CC_NotInitialized, "The core library has not been initalized");
+
+    ABC_DataSyncShutdown();
+
+exit:
+    return cc;
+}
+
 tABC_CC ABC_DataSyncWallet(const char *szUserName,
                            const char *szPassword,
                            const char *szWalletUUID,
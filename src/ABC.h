@@ -571,6 +571,20 @@ typedef void (*tABC_Sweep_Done_Callback)(tABC_CC cc,
                                          const char *szID,
                                          uint64_t amount);
 
+/**
+ * Called as a multi-key sweep resolves its keys.
+ * A key resolves once its history has been fetched,
+ * even if that history turns out to be empty,
+ * so `found` reaches `total` before the sweep happens.
+ *
+ * @param found The number of keys resolved so far.
+ * @param total The number of keys being swept.
+ * @param amount The number of satoshis found so far.
+ */
+typedef void (*tABC_Sweep_Progress_Callback)(unsigned int found,
+                                             unsigned int total,
+                                             uint64_t amount);
+
 /* === Library lifetime: === */
 tABC_CC ABC_Initialize(const char                   *szRootDir,
                        const char                   *szCaCertPath,
@@ -593,6 +607,17 @@ tABC_CC ABC_DataSyncAll(const char *szUserName,
                         void *pData,
                         tABC_Error *pError);
 
+tABC_CC ABC_DataSyncStart(const char *szUserName,
+                          const char *szPassword,
+                          tABC_BitCoin_Event_Callback fAsyncBitCoinEventCallback,
+                          void *pData,
+                          tABC_Error *pError);
+
+tABC_CC ABC_DataSyncRequest(const char *szWalletUUID,
+                            tABC_Error *pError);
+
+tABC_CC ABC_DataSyncStop(tABC_Error *pError);
+
 /* === General info: === */
 
 /**
@@ -1061,6 +1086,16 @@ tABC_CC ABC_SweepKey(const char *szUsername,
                      void *pData,
                      tABC_Error *pError);
 
+tABC_CC ABC_SweepKeys(const char *szUsername,
+                      const char *szPassword,
+                      const char *szWalletUUID,
+                      const char **aszKeys,
+                      unsigned int keyCount,
+                      tABC_Sweep_Progress_Callback fProgress,
+                      tABC_Sweep_Done_Callback fCallback,
+                      void *pData,
+                      tABC_Error *pError);
+
 /* === Transactions: === */
 tABC_CC ABC_GetTransaction(const char *szUserName,
                            const char *szPassword,
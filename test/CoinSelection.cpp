@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/bitcoin/CoinSelection.hpp"
+#include "../minilibs/catch/catch.hpp"
+
+static abcd::CoinSelectionParams
+testParams(uint64_t target)
+{
+    abcd::CoinSelectionParams out;
+    out.target = target;
+    out.fee = [](size_t inputs, bool change)
+    {
+        // A flat 1000 satoshis per input, plus 500 for change:
+        return 1000 * inputs + (change ? 500 : 0);
+    };
+    out.minChange = 5430;
+    out.budget = std::chrono::milliseconds(100);
+    out.maxTries = 100000;
+    return out;
+}
+
+TEST_CASE("Changeless coin selection", "[bitcoin][coins]")
+{
+    // 30000 + 20000 pays 48000 plus a 2000 fee exactly:
+    std::vector<uint64_t> values = {100000, 30000, 20000, 7000};
+    abcd::CoinSelection result;
+    REQUIRE(abcd::coinSelect(result, values, testParams(48000)));
+    REQUIRE(result.change == 0);
+    REQUIRE(result.fee == 2000);
+    REQUIRE(result.total == 50000);
+    REQUIRE(result.inputs.size() == 2);
+    REQUIRE(std::count(result.inputs.begin(), result.inputs.end(), 1));
+    REQUIRE(std::count(result.inputs.begin(), result.inputs.end(), 2));
+}
+
+TEST_CASE("Coin selection with change", "[bitcoin][coins]")
+{
+    std::vector<uint64_t> values = {100000, 60000, 7000};
+    abcd::CoinSelection result;
+    REQUIRE(abcd::coinSelect(result, values, testParams(40000)));
+
+    // The 60000 coin is the smallest that works on its own:
+    REQUIRE(result.inputs.size() == 1);
+    REQUIRE(result.inputs[0] == 1);
+    REQUIRE(result.fee == 1500);
+    REQUIRE(result.change == 60000 - 40000 - 1500);
+}
+
+TEST_CASE("Dust change goes to the miners", "[bitcoin][coins]")
+{
+    // 10000 - 8000 - 1500 leaves 500 in change, below the dust limit:
+    std::vector<uint64_t> values = {10000};
+    abcd::CoinSelection result;
+    REQUIRE(abcd::coinSelect(result, values, testParams(8000)));
+    REQUIRE(result.change == 0);
+    REQUIRE(result.fee == 1000);
+    REQUIRE(result.spent() == 10000);
+}
+
+TEST_CASE("Insufficient funds", "[bitcoin][coins]")
+{
+    std::vector<uint64_t> values = {10000, 5000};
+    abcd::CoinSelection result;
+    auto s = abcd::coinSelect(result, values, testParams(14000));
+    REQUIRE_FALSE(s);
+    REQUIRE(s.value() == ABC_CC_InsufficientFunds);
+}
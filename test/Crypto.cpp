@@ -9,6 +9,8 @@
 #include "../abcd/crypto/Encoding.hpp"
 #include "../abcd/json/JsonFile.hpp"
 #include "../minilibs/catch/catch.hpp"
+#include <stdlib.h>
+#include <unistd.h>
 
 // sha256("Satoshi"):
 static const char keyHex[] =
@@ -61,6 +63,9 @@ TEST_CASE("Encryption round-trip", "[crypto][encryption]")
         abcd::toU08Buf(payload), abcd::toU08Buf(key),
         abcd::ABC_CryptoType_AES256, &json, &error));
 
+    // Logging out drops the cached key, which must not break anything:
+    abcd::cryptoCipherClear();
+
     abcd::AutoU08Buf data;
     CHECK(ABC_CC_Ok == ABC_CryptoDecryptJSONObject(
         json, abcd::toU08Buf(key), &data, &error));
@@ -69,3 +74,70 @@ TEST_CASE("Encryption round-trip", "[crypto][encryption]")
     if (json)
         json_decref(json);
 }
+
+TEST_CASE("Batch decryption", "[crypto][encryption]")
+{
+    tABC_Error error;
+    abcd::DataChunk key;
+    abcd::base16Decode(key, keyHex);
+
+    char dir[] = "/tmp/abc-test-XXXXXX";
+    REQUIRE(mkdtemp(dir));
+    std::vector<std::string> filenames;
+    for (int i = 0; i < 200; ++i)
+    {
+        filenames.push_back(std::string(dir) + "/" + std::to_string(i));
+        json_t *json = json_pack("{si}", "n", i);
+        REQUIRE(ABC_CC_Ok == ABC_CryptoEncryptJSONFileObject(json,
+            abcd::toU08Buf(key), abcd::ABC_CryptoType_AES256,
+            filenames.back().c_str(), &error));
+        json_decref(json);
+    }
+    std::vector<const char *> names;
+    for (const auto &filename: filenames)
+        names.push_back(filename.c_str());
+
+    for (unsigned threads: {1, 4})
+    {
+        std::vector<json_t *> out(names.size());
+        REQUIRE(ABC_CC_Ok == ABC_CryptoDecryptJSONFiles(names.data(),
+            names.size(), abcd::toU08Buf(key), out.data(), threads, &error));
+        for (size_t i = 0; i < out.size(); ++i)
+        {
+            CHECK(json_integer_value(json_object_get(out[i], "n")) == (int)i);
+            json_decref(out[i]);
+        }
+    }
+
+    // A missing file fails the whole batch:
+    names[150] = "/nonexistent";
+    std::vector<json_t *> out(names.size());
+    CHECK(ABC_CC_Ok != ABC_CryptoDecryptJSONFiles(names.data(),
+        names.size(), abcd::toU08Buf(key), out.data(), 4, &error));
+    for (auto json: out)
+        CHECK(!json);
+
+    for (const auto &filename: filenames)
+        unlink(filename.c_str());
+    rmdir(dir);
+}
+
+TEST_CASE("File name cache", "[crypto]")
+{
+    const std::string keyA("Satoshi");
+    const std::string keyB("Nakamoto");
+
+    // Enough names to push the first ones out of the cache:
+    std::vector<std::string> first;
+    for (int i = 0; i < 600; ++i)
+        first.push_back(abcd::cryptoFilename(keyA, std::to_string(i)));
+    for (int i = 0; i < 600; ++i)
+    {
+        CHECK(abcd::cryptoFilename(keyA, std::to_string(i)) == first[i]);
+        CHECK(abcd::cryptoFilename(keyB, std::to_string(i)) != first[i]);
+    }
+
+    abcd::cryptoFilenameClear();
+    CHECK(abcd::cryptoFilename(keyA, "1PeChFbhxDD9NLbU21DfD55aQBC4ZTR3tE") ==
+        "5vJNMWZ68tsp2HJa1AfMhZpcpU9Wm9ccEw7cTwvARHXh");
+}
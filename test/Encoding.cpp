@@ -5,8 +5,12 @@
  * See the LICENSE file for more information.
  */
 
+#include "../abcd/crypto/ChunkEncoding.hpp"
 #include "../abcd/crypto/Encoding.hpp"
 #include "../minilibs/catch/catch.hpp"
+#include <ctype.h>
+#include <algorithm>
+#include <random>
 
 TEST_CASE("RFC 4648 base16 test vectors", "[crypto][base16]")
 {
@@ -151,3 +155,75 @@ TEST_CASE("Bad base64 strings", "[crypto][base64]")
     REQUIRE_FALSE(abcd::base64Decode(result, "AAAA===="));
     REQUIRE_FALSE(abcd::base64Decode(result, "A==="));
 }
+
+/**
+ * Random bytes, with a fixed seed so failures are repeatable.
+ */
+static abcd::DataChunk
+fuzzData(std::mt19937 &rng, size_t size)
+{
+    abcd::DataChunk out(size);
+    for (auto &byte: out)
+        byte = rng();
+    return out;
+}
+
+/**
+ * Damages a string with characters the decoders must treat carefully.
+ */
+static std::string
+fuzzMangle(std::mt19937 &rng, std::string text)
+{
+    static const char nasty[] = "=+/-_ \n\x80\xff" "0aAzZ9fFgG";
+    switch (rng() % 4)
+    {
+    case 0:
+        if (!text.empty())
+            text[rng() % text.size()] = nasty[rng() % (sizeof(nasty) - 1)];
+        break;
+    case 1:
+        text.append(rng() % 4, '=');
+        break;
+    case 2:
+        if (!text.empty())
+            text.resize(rng() % text.size());
+        break;
+    }
+    return text;
+}
+
+TEST_CASE("Fast codecs match the generic ones", "[crypto][base16][base64]")
+{
+    std::mt19937 rng(1);
+    for (int n = 0; n < 5000; ++n)
+    {
+        const auto data = fuzzData(rng, rng() % 200);
+
+        const auto text16 = abcd::base16Encode(data);
+        REQUIRE(text16 == (abcd::chunkEncode<1, 2>(data, abcd::base16Alphabet)));
+        const auto text64 = abcd::base64Encode(data);
+        REQUIRE(text64 == (abcd::chunkEncode<3, 4>(data, abcd::base64Alphabet)));
+
+        // Decoding must agree on both success and output:
+        std::string upper(text16);
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        for (const auto &text: {text16, upper, fuzzMangle(rng, text16)})
+        {
+            abcd::DataChunk fast, slow;
+            const bool ok = !!abcd::base16Decode(fast, text);
+            const bool slowOk = !!abcd::chunkDecode<1, 2, abcd::base16Decode>(slow, text);
+            REQUIRE(ok == slowOk);
+            if (ok)
+                REQUIRE(fast == slow);
+        }
+        for (const auto &text: {text64, fuzzMangle(rng, text64)})
+        {
+            abcd::DataChunk fast, slow;
+            const bool ok = !!abcd::base64Decode(fast, text);
+            const bool slowOk = !!abcd::chunkDecode<3, 4, abcd::base64Decode>(slow, text);
+            REQUIRE(ok == slowOk);
+            if (ok)
+                REQUIRE(fast == slow);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/bitcoin/FeeTable.hpp"
+#include "../abcd/bitcoin/TxSize.hpp"
+#include "../minilibs/catch/catch.hpp"
+
+/**
+ * Holds the storage for a fake general info structure.
+ */
+struct TestFees
+{
+    std::vector<abcd::tABC_GeneralMinerFee> fees;
+    std::vector<abcd::tABC_GeneralMinerFee *> pointers;
+    abcd::tABC_GeneralInfo info;
+
+    TestFees(std::vector<abcd::tABC_GeneralMinerFee> list):
+        fees(list)
+    {
+        for (auto &fee: fees)
+            pointers.push_back(&fee);
+        info = abcd::tABC_GeneralInfo();
+        info.countMinersFees = pointers.size();
+        info.aMinersFees = pointers.data();
+    }
+
+    uint64_t scan(size_t txSize)
+    {
+        for (auto &fee: fees)
+            if (txSize <= fee.sizeTransaction)
+                return fee.amountSatoshi;
+        return 0;
+    }
+};
+
+TEST_CASE("Transaction size model", "[bitcoin][fees]")
+{
+    REQUIRE(abcd::p2pkhOutputSize == 34);
+    REQUIRE(abcd::p2shOutputSize == 32);
+    REQUIRE(abcd::p2pkhInputSize(true) == 149);
+    REQUIRE(abcd::p2pkhInputSize(false) == 181);
+    REQUIRE(abcd::txOverheadSize(1, 2) == 10);
+    REQUIRE(abcd::txOverheadSize(300, 2) == 12);
+
+    // One input to two outputs:
+    REQUIRE(abcd::p2pkhTxSize(1, 2, 2 * abcd::p2pkhOutputSize) == 227);
+}
+
+TEST_CASE("Fee table matches a linear scan", "[bitcoin][fees]")
+{
+    // Each entry is {amountSatoshi, sizeTransaction}:
+    TestFees dense({{10000, 1000}, {20000, 10000}, {50000, 100000}});
+    TestFees unsorted({{30000, 100000}, {10000, 1000}, {20000, 5000}});
+    TestFees sparse({{10000, 1}, {20000, 1000}, {90000, 10000000}});
+
+    for (auto table: {&dense, &unsorted, &sparse})
+    {
+        abcd::FeeTable fees(&table->info);
+        for (size_t size = 0; size < 12000; size += 7)
+            REQUIRE(fees.sizeFee(size) == table->scan(size));
+        for (size_t size: {10000, 10001, 100000, 100001, 20000000})
+            REQUIRE(fees.sizeFee(size) == table->scan(size));
+    }
+}
+
+TEST_CASE("Miner fee scales with the amount", "[bitcoin][fees]")
+{
+    // 10000 satoshis up to 1000 bytes, then 20000 up to 10000 bytes:
+    TestFees table({{10000, 1000}, {20000, 10000}});
+    abcd::FeeTable fees(&table.info);
+
+    REQUIRE(fees.minerFee(500, 0) == 1000);
+    REQUIRE(fees.minerFee(500, 5000000) == 5000);
+    REQUIRE(fees.minerFee(500, 5050000) == 5000);
+    REQUIRE(fees.minerFee(500, 100000000) == 10000);
+    REQUIRE(fees.minerFee(2000, 0) == 2000);
+    REQUIRE(fees.minerFee(2000000, 100000000) == 0);
+}
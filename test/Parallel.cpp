@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/util/Parallel.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <atomic>
+#include <vector>
+
+TEST_CASE("parallelFor visits each index once", "[util][parallel]")
+{
+    for (unsigned threads: {1, 2, 7})
+    {
+        std::vector<std::atomic<int>> visits(1000);
+        for (auto &v: visits)
+            v = 0;
+
+        abcd::parallelFor(visits.size(), [&](size_t i)
+        {
+            ++visits[i];
+        }, threads);
+
+        for (auto &v: visits)
+            REQUIRE(v == 1);
+    }
+}
+
+TEST_CASE("parallelFor handles empty work", "[util][parallel]")
+{
+    bool called = false;
+    abcd::parallelFor(0, [&](size_t i){ called = true; });
+    REQUIRE_FALSE(called);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/crypto/Random.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <set>
+
+TEST_CASE("Random data does not repeat", "[crypto][random]")
+{
+    // Enough small requests to run through several buffer refills:
+    std::set<abcd::DataChunk> seen;
+    for (int i = 0; i < 2000; ++i)
+    {
+        abcd::DataChunk data;
+        REQUIRE(abcd::randomData(data, 16));
+        REQUIRE(data.size() == 16);
+        REQUIRE(seen.insert(data).second);
+    }
+
+    // Requests bigger than the buffer:
+    abcd::DataChunk a, b;
+    REQUIRE(abcd::randomData(a, 5000));
+    REQUIRE(abcd::randomData(b, 5000));
+    REQUIRE(a != b);
+}
+
+TEST_CASE("Forked children get their own random data", "[crypto][random]")
+{
+    // Make sure this thread's generator is primed before forking:
+    abcd::DataChunk primed;
+    REQUIRE(abcd::randomData(primed, 1));
+
+    int fds[2];
+    REQUIRE(0 == pipe(fds));
+    pid_t pid = fork();
+    REQUIRE(0 <= pid);
+    if (!pid)
+    {
+        abcd::DataChunk data;
+        abcd::randomData(data, 32);
+        _exit(32 == write(fds[1], data.data(), data.size()) ? 0 : 1);
+    }
+
+    abcd::DataChunk parent;
+    REQUIRE(abcd::randomData(parent, 32));
+    abcd::DataChunk child(32);
+    REQUIRE(32 == read(fds[0], child.data(), child.size()));
+    int status;
+    waitpid(pid, &status, 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    REQUIRE(parent != child);
+}
@@ -8,6 +8,7 @@
 #include "../abcd/crypto/Scrypt.hpp"
 #include "../abcd/crypto/Encoding.hpp"
 #include "../minilibs/catch/catch.hpp"
+#include "../minilibs/scrypt/crypto_scrypt.h"
 
 TEST_CASE("Scrypt RFC test vectors", "[crypto][scrypt]")
 {
@@ -75,3 +76,81 @@ TEST_CASE("Scrypt RFC test vectors", "[crypto][scrypt]")
         CHECK(abcd::base16Encode(abcd::U08Buf(out)) == test.result);
     }
 }
+
+TEST_CASE("Scrypt implementations agree", "[crypto][scrypt]")
+{
+    const std::string password = "pleaseletmein";
+    const std::string salt = "SodiumChloride";
+    const char *expected =
+        "7023bdcb3afd7348461c06cd81fd38eb"
+        "fda8fbba904f8e3ea9b543f6545da1f2"
+        "d5432955613f0fcf62d49705242a9af9"
+        "e61e85dc0d651e40dfcf017b45575887";
+
+    for (auto impl: {"portable", "sse2"})
+    {
+        if (crypto_scrypt_set_impl(impl))
+            continue;
+
+        abcd::DataChunk out(64);
+        REQUIRE(0 == crypto_scrypt(
+            reinterpret_cast<const uint8_t *>(password.data()), password.size(),
+            reinterpret_cast<const uint8_t *>(salt.data()), salt.size(),
+            16384, 8, 1, out.data(), out.size()));
+        CHECK(abcd::base16Encode(out) == expected);
+    }
+    crypto_scrypt_set_impl(nullptr);
+}
+
+TEST_CASE("Scrypt lanes agree across threads", "[crypto][scrypt]")
+{
+    const std::string password = "password";
+    const std::string salt = "NaCl";
+    const char *expected =
+        "fdbabe1c9d3472007856e7190d01e9fe"
+        "7c6ad7cbc8237830e77376634b373162"
+        "2eaf30d92e22a3886ff109279d9830da"
+        "c727afb94a83ee6d8360cbdfa2cc0640";
+
+    for (uint32_t threads: {1, 3, 8})
+    {
+        REQUIRE(0 == crypto_scrypt_set_threads(threads));
+
+        abcd::DataChunk out(64);
+        REQUIRE(0 == crypto_scrypt(
+            reinterpret_cast<const uint8_t *>(password.data()), password.size(),
+            reinterpret_cast<const uint8_t *>(salt.data()), salt.size(),
+            1024, 8, 16, out.data(), out.size()));
+        CHECK(abcd::base16Encode(out) == expected);
+    }
+    crypto_scrypt_set_threads(0);
+}
+
+TEST_CASE("Background scrypt matches foreground", "[crypto][scrypt]")
+{
+    const std::string password = "air";
+    const std::string salt = "bitz";
+
+    abcd::tABC_CryptoSNRP snrp;
+    snrp.Salt = abcd::toU08Buf(salt);
+    snrp.N = 16;
+    snrp.r = 2;
+    snrp.p = 1;
+
+    abcd::ScryptJob job;
+    job.start(abcd::toU08Buf(password), &snrp);
+    REQUIRE(job.matches(&snrp));
+
+    abcd::AutoU08Buf expected;
+    tABC_Error error;
+    REQUIRE(ABC_CC_Ok == abcd::ABC_CryptoScryptSNRP(
+        abcd::toU08Buf(password), &snrp, &expected, &error));
+
+    abcd::AutoU08Buf out;
+    REQUIRE(job.wait(out));
+    CHECK(abcd::base16Encode(abcd::U08Buf(out)) ==
+        abcd::base16Encode(abcd::U08Buf(expected)));
+
+    snrp.N = 32;
+    CHECK_FALSE(job.matches(&snrp));
+}
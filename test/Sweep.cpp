@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/bitcoin/FeeTable.hpp"
+#include "../abcd/bitcoin/Sweep.hpp"
+#include "../abcd/bitcoin/TxSize.hpp"
+#include "../minilibs/catch/catch.hpp"
+
+TEST_CASE("Sweep size counts each key's input format", "[bitcoin][sweep]")
+{
+    // Two compressed keys and one uncompressed key, one output:
+    size_t size = abcd::txOverheadSize(3, 1) +
+        2 * abcd::p2pkhInputSize(true) + abcd::p2pkhInputSize(false) +
+        abcd::p2pkhOutputSize;
+    REQUIRE(abcd::sweepTxSize({true, false, true}) == size);
+    REQUIRE(size == 523);
+
+    // An uncompressed key costs the extra 32 bytes of its public key:
+    REQUIRE(abcd::sweepTxSize({false}) == abcd::sweepTxSize({true}) + 32);
+
+    // A big batch crosses into the next fee bracket:
+    abcd::tABC_GeneralMinerFee small = {10000, 1000};
+    abcd::tABC_GeneralMinerFee large = {20000, 10000};
+    abcd::tABC_GeneralMinerFee *fees[] = {&small, &large};
+    abcd::tABC_GeneralInfo info = abcd::tABC_GeneralInfo();
+    info.countMinersFees = 2;
+    info.aMinersFees = fees;
+    abcd::FeeTable table(&info);
+
+    std::vector<bool> six(6, true);
+    std::vector<bool> seven(7, true);
+    REQUIRE(abcd::sweepTxSize(six) <= 1000);
+    REQUIRE(abcd::sweepTxSize(seven) > 1000);
+    REQUIRE(table.minerFee(abcd::sweepTxSize(six), 100000000) == 10000);
+    REQUIRE(table.minerFee(abcd::sweepTxSize(seven), 100000000) == 20000);
+}
+
+TEST_CASE("Sweeps skip dust", "[bitcoin][sweep]")
+{
+    REQUIRE(SWEEP_MIN_OUTPUT == 5430);
+    REQUIRE(abcd::sweepOutput(10000 + 5430, 10000) == 5430);
+    REQUIRE(abcd::sweepOutput(10000 + 5429, 10000) == 0);
+    REQUIRE(abcd::sweepOutput(5430, 0) == 5430);
+
+    // Funds below the fee do not wrap around:
+    REQUIRE(abcd::sweepOutput(1000, 10000) == 0);
+}
+
+TEST_CASE("Sweep progress follows transactions", "[bitcoin][sweep]")
+{
+    abcd::SweepProgress progress({"a", "b", "c"});
+    REQUIRE(progress.resolved() == 0);
+    REQUIRE(progress.total() == 3);
+
+    // Outputs to other addresses do not count:
+    REQUIRE(!progress.receive("x", "t0:0", 500));
+    REQUIRE(progress.resolved() == 0);
+
+    REQUIRE(progress.receive("a", "t1:0", 1000));
+    REQUIRE(progress.receive("a", "t1:1", 2000));
+    REQUIRE(progress.resolved() == 1);
+    REQUIRE(progress.funds() == 3000);
+
+    // Seeing the same transaction again changes nothing:
+    progress.receive("a", "t1:0", 1000);
+    REQUIRE(progress.funds() == 3000);
+
+    // A spend can show up before the output it spends:
+    REQUIRE(progress.spend("b", "t2:0"));
+    REQUIRE(progress.receive("b", "t2:0", 4000));
+    REQUIRE(progress.resolved() == 2);
+    REQUIRE(progress.funds() == 3000);
+
+    progress.spend("a", "t1:1");
+    REQUIRE(progress.funds() == 1000);
+
+    // Key "c" has no history, but it still resolves once the watcher is done:
+    progress.resolveAll();
+    REQUIRE(progress.resolved() == 3);
+    REQUIRE(progress.funds() == 1000);
+}
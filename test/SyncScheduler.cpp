@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/util/SyncScheduler.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::chrono::milliseconds;
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Records events from the scheduler's threads, so tests can wait on them.
+ * The waits time out generously, so they only fail if something is stuck.
+ */
+class Events
+{
+public:
+    void
+    record(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        names_.push_back(name);
+        times_.push_back(Clock::now());
+        changed_.notify_all();
+    }
+
+    /**
+     * Waits until `name` has happened at least `n` times.
+     */
+    bool
+    wait(const std::string &name, size_t n)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return changed_.wait_for(lock, std::chrono::seconds(10), [&]
+        {
+            return n <= count(name);
+        });
+    }
+
+    size_t
+    count(const std::string &name)
+    {
+        size_t out = 0;
+        for (const auto &i: names_)
+            if (i == name)
+                ++out;
+        return out;
+    }
+
+    std::vector<std::string> names() { return names_; }
+    std::vector<Clock::time_point> times() { return times_; }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<std::string> names_;
+    std::vector<Clock::time_point> times_;
+};
+
+/**
+ * Holds a sync job until the test lets it go.
+ */
+class Gate
+{
+public:
+    void
+    open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        changed_.notify_all();
+    }
+
+    void
+    wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&]{ return open_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    bool open_ = false;
+};
+
+TEST_CASE("Sync scheduler backs off idle repos", "[util][sync]")
+{
+    Events events;
+    abcd::SyncScheduler scheduler(milliseconds(10), milliseconds(80));
+    scheduler.add("idle", [&](int *pDirty, tABC_Error *pError)
+    {
+        events.record("idle");
+        return ABC_CC_Ok;
+    });
+    scheduler.start([](const std::string &){});
+    REQUIRE(events.wait("idle", 5));
+    scheduler.stop();
+
+    // Each quiet sync doubles the delay, up to the limit:
+    auto times = events.times();
+    milliseconds gaps[] = {milliseconds(20), milliseconds(40),
+        milliseconds(80), milliseconds(80)};
+    for (size_t i = 0; i < 4; ++i)
+        REQUIRE(gaps[i] <= times[i + 1] - times[i]);
+}
+
+TEST_CASE("Sync scheduler coalesces requests", "[util][sync]")
+{
+    Events events;
+    Gate gate;
+    abcd::SyncScheduler scheduler(milliseconds(60000), milliseconds(60000));
+    scheduler.add("repo", [&](int *pDirty, tABC_Error *pError)
+    {
+        events.record("start");
+        gate.wait();
+        events.record("done");
+        return ABC_CC_Ok;
+    });
+    scheduler.start([](const std::string &){});
+    REQUIRE(events.wait("start", 1));
+
+    // A burst of local changes during a sync leads to one more sync, not 100:
+    for (int i = 0; i < 100; ++i)
+        scheduler.request("repo");
+    gate.open();
+    REQUIRE(events.wait("done", 2));
+    scheduler.stop();
+    REQUIRE(events.count("done") == 2);
+
+    // Unknown names are harmless:
+    scheduler.request("missing");
+}
+
+TEST_CASE("Sync scheduler reports changes", "[util][sync]")
+{
+    Events events;
+    abcd::SyncScheduler scheduler(milliseconds(60000), milliseconds(60000));
+    scheduler.add("quiet", [](int *pDirty, tABC_Error *pError)
+    {
+        return ABC_CC_Ok;
+    });
+    scheduler.add("busy", [](int *pDirty, tABC_Error *pError)
+    {
+        *pDirty = 1;
+        return ABC_CC_Ok;
+    });
+    scheduler.start([&](const std::string &name)
+    {
+        events.record(name);
+    });
+
+    REQUIRE(events.wait("busy", 1));
+    scheduler.stop();
+    REQUIRE(events.names() == std::vector<std::string>{"busy"});
+}
+
+TEST_CASE("Sync scheduler keeps slow repos to one thread", "[util][sync]")
+{
+    Events events;
+    Gate gate;
+    abcd::SyncScheduler scheduler(milliseconds(60000), milliseconds(60000), 2);
+    scheduler.add("slow", [&](int *pDirty, tABC_Error *pError)
+    {
+        events.record("slow");
+        gate.wait();
+        return ABC_CC_Ok;
+    });
+    scheduler.add("fast", [&](int *pDirty, tABC_Error *pError)
+    {
+        events.record("fast");
+        return ABC_CC_Ok;
+    });
+    scheduler.start([](const std::string &){});
+    REQUIRE(events.wait("slow", 1));
+    REQUIRE(events.wait("fast", 1));
+
+    // The fast repo still answers requests while the slow one hangs:
+    scheduler.request("fast");
+    bool ok = events.wait("fast", 2);
+    gate.open();
+    scheduler.stop();
+    REQUIRE(ok);
+}
+
+TEST_CASE("Sync scheduler drops repos it no longer needs", "[util][sync]")
+{
+    Events events;
+    abcd::SyncScheduler scheduler(milliseconds(60000), milliseconds(60000), 1);
+    scheduler.add("keep", [&](int *pDirty, tABC_Error *pError)
+    {
+        events.record("keep");
+        return ABC_CC_Ok;
+    });
+    scheduler.add("drop", [&](int *pDirty, tABC_Error *pError)
+    {
+        events.record("drop");
+        return ABC_CC_Ok;
+    });
+    scheduler.start([](const std::string &){});
+    REQUIRE(events.wait("keep", 1));
+    REQUIRE(events.wait("drop", 1));
+    scheduler.retain({"keep"});
+
+    // With one thread, "drop" would go first if it were still scheduled:
+    scheduler.request("drop");
+    scheduler.request("keep");
+    REQUIRE(events.wait("keep", 2));
+    scheduler.stop();
+    REQUIRE(events.count("drop") == 1);
+}
+
+TEST_CASE("Sync scheduler takes requests while stopping", "[util][sync]")
+{
+    Events events;
+    Gate stopping;
+    abcd::SyncScheduler scheduler(milliseconds(60000), milliseconds(60000));
+    scheduler.add("repo", [](int *pDirty, tABC_Error *pError)
+    {
+        *pDirty = 1;
+        return ABC_CC_Ok;
+    });
+    scheduler.start([&](const std::string &name)
+    {
+        // Ask for another sync once `stop` has been called:
+        events.record("callback");
+        stopping.wait();
+        scheduler.request(name);
+    });
+
+    REQUIRE(events.wait("callback", 1));
+    std::thread stopper([&]
+    {
+        stopping.open();
+        scheduler.stop();
+        events.record("stopped");
+    });
+    bool ok = events.wait("stopped", 1);
+    stopper.join();
+    REQUIRE(ok);
+}
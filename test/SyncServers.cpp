@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015, AirBitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/util/SyncServers.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <map>
+
+using std::chrono::milliseconds;
+using std::chrono::minutes;
+typedef abcd::SyncServers::Clock Clock;
+
+/**
+ * Stands in for a set of servers with injected delays.
+ * Each round picks a server, "fetches" from it, and reports back.
+ */
+struct FakeServers
+{
+    abcd::SyncServers servers;
+    std::map<std::string, milliseconds> delay;
+    std::map<std::string, bool> down;
+    std::map<std::string, int> picks;
+    Clock::time_point now = Clock::now();
+
+    FakeServers():
+        servers(minutes(5))
+    {
+        delay["a"] = milliseconds(300);
+        delay["b"] = milliseconds(20);
+        delay["c"] = milliseconds(80);
+        servers.setServers({"a", "b", "c"});
+    }
+
+    void
+    sync(int rounds)
+    {
+        for (int i = 0; i < rounds; ++i)
+        {
+            std::string server = servers.pick(now);
+            ++picks[server];
+            servers.report(server, !down[server], delay[server]);
+            now += milliseconds(1000);
+        }
+    }
+};
+
+TEST_CASE("Sync servers prefer the fastest one", "[util][sync]")
+{
+    FakeServers fake;
+
+    // Everybody gets tried once, then the fast server takes over:
+    fake.sync(3);
+    REQUIRE(fake.picks.size() == 3);
+    fake.sync(50);
+    REQUIRE(fake.picks["b"] == 51);
+}
+
+TEST_CASE("Sync servers avoid failing ones", "[util][sync]")
+{
+    FakeServers fake;
+    fake.sync(3);
+
+    fake.down["b"] = true;
+    fake.sync(10);
+    REQUIRE(fake.picks["b"] == 2);
+    REQUIRE(fake.picks["c"] == 10);
+
+    // A failed server is also skipped for the immediate retry:
+    REQUIRE(fake.servers.pick(fake.now, "c") == "a");
+}
+
+TEST_CASE("Sync servers re-probe the others", "[util][sync]")
+{
+    FakeServers fake;
+    fake.sync(3);
+
+    // The slow server got faster while nobody was looking:
+    fake.delay["a"] = milliseconds(5);
+    fake.sync(200);
+    REQUIRE(fake.picks["a"] == 1);
+    REQUIRE(fake.servers.pick(fake.now) == "b");
+
+    // Five minutes in, it gets another chance, and wins:
+    fake.sync(200);
+    REQUIRE(fake.picks["c"] == 2);
+    REQUIRE(fake.servers.pick(fake.now) == "a");
+}
+
+TEST_CASE("Sync servers keep statistics across list updates", "[util][sync]")
+{
+    FakeServers fake;
+    fake.sync(3);
+
+    fake.servers.setServers({"c", "b"});
+    REQUIRE(fake.servers.pick(fake.now) == "b");
+
+    fake.servers.setServers({});
+    REQUIRE(fake.servers.empty());
+    REQUIRE(fake.servers.pick(fake.now).empty());
+}